@@ -0,0 +1,144 @@
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+#include "AlbumArt.hpp"
+#include "ThemeTexture.hpp"
+
+constexpr const char *coverNames[] =
+{
+	"cover.tex", "cover.bmp", "folder.tex", "folder.bmp", "album_art.tex", "album_art.bmp",
+};
+
+constexpr const char *thumbnailDir =
+#ifndef _WIN32
+	"sdmc:/switch/VGMPlayerNX/thumbs/";
+#else
+	"thumbs/";
+#endif
+
+LoadedArt::~LoadedArt()
+{
+	SDL_FreeSurface(mSurface);
+}
+
+static std::vector<char> ReadFile(const std::filesystem::path &path)
+{
+	std::ifstream file(path, std::fstream::binary);
+
+	if (!file)
+		return {};
+
+	return std::vector<char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Returns an owned copy of a .tex or .bmp image, since .tex surfaces only point into their data.
+static SDL_Surface *LoadImage(const std::vector<char> &data)
+{
+	auto wrapped = ThemeTexture::Load(data);
+
+	if (!wrapped)
+		return nullptr;
+
+	auto surface = SDL_DuplicateSurface(wrapped);
+	SDL_FreeSurface(wrapped);
+
+	return surface;
+}
+
+// Thumbnails are small RGB565 .tex files named after the cover's path, size, modification time and the target size.
+static std::filesystem::path GetThumbnailPath(const std::filesystem::path &cover, const int width, const int height)
+{
+	std::string key = cover.string() + '|' + std::to_string(width) + 'x' + std::to_string(height);
+
+	try
+	{
+		key += '|' + std::to_string(std::filesystem::file_size(cover));
+		key += '|' + std::to_string(std::filesystem::last_write_time(cover).time_since_epoch().count());
+	}
+	catch (...) {};
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.tex", static_cast<unsigned long long>(std::hash<std::string>{}(key)));
+
+	return std::filesystem::path(thumbnailDir) / name;
+}
+
+static void SaveThumbnail(const std::filesystem::path &path, SDL_Surface *thumbnail)
+{
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+
+	ThemeTextureHeader header;
+
+	std::memcpy(header.mMagic, "VTEX", 4);
+	header.mWidth  = static_cast<uint16_t>(thumbnail->w);
+	header.mHeight = static_cast<uint16_t>(thumbnail->h);
+	header.mFormat = SDL_PIXELFORMAT_RGB565;
+	header.mPitch  = thumbnail->pitch;
+
+	std::ofstream file(path, std::fstream::binary);
+
+	file.write(reinterpret_cast<const char *>(&header), sizeof(ThemeTextureHeader));
+	file.write(static_cast<const char *>(thumbnail->pixels), static_cast<size_t>(thumbnail->pitch) * thumbnail->h);
+}
+
+std::unique_ptr<LoadedArt> AlbumArtLoader::Build(const std::filesystem::path &track, const int width, const int height)
+{
+	std::filesystem::path cover;
+
+	for (const auto name : coverNames)
+	{
+		std::error_code error;
+		auto candidate = track.parent_path() / name;
+
+		if (std::filesystem::exists(candidate, error))
+		{
+			cover = candidate;
+			break;
+		}
+	}
+
+	if (cover.empty())
+		return nullptr;
+
+	auto loaded = std::make_unique<LoadedArt>();
+	loaded->mTrack = track;
+
+	const auto thumbnailPath = GetThumbnailPath(cover, width, height);
+
+	loaded->mSurface = LoadImage(ReadFile(thumbnailPath));
+
+	if (loaded->mSurface && loaded->mSurface->w == width && loaded->mSurface->h == height)
+		return loaded;
+
+	SDL_FreeSurface(loaded->mSurface);
+	loaded->mSurface = nullptr;
+
+	auto image = LoadImage(ReadFile(cover));
+
+	if (!image)
+		return nullptr;
+
+	loaded->mSurface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 16, SDL_PIXELFORMAT_RGB565);
+
+	if (loaded->mSurface)
+		SDL_BlitScaled(image, nullptr, loaded->mSurface, nullptr);
+
+	SDL_FreeSurface(image);
+
+	if (!loaded->mSurface)
+		return nullptr;
+
+	SaveThumbnail(thumbnailPath, loaded->mSurface);
+
+	return loaded;
+}
+
+void AlbumArtLoader::Load(const std::filesystem::path &track, const int width, const int height)
+{
+	AsyncLoader::Load([track, width, height]() {
+		return Build(track, width, height);
+	});
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+
+#include "AsyncLoader.hpp"
+#include "Globals.hpp"
+
+// Cover art for one track, decoded and scaled to the album art area off the UI thread.
+struct LoadedArt
+{
+	~LoadedArt();
+
+	std::filesystem::path mTrack;
+	SDL_Surface *mSurface = nullptr;
+};
+
+class AlbumArtLoader
+	: public AsyncLoader<LoadedArt>
+{
+public:
+	// Looks for a cover image in the track's folder, returning it scaled to width x height, or nullptr if there is none.
+	// Scaled covers are kept in an on-disk thumbnail cache so later tracks from the same folder skip decoding.
+	static std::unique_ptr<LoadedArt> Build(const std::filesystem::path &track, const int width, const int height);
+
+	// Starts finding a track's cover in the background.
+	void Load(const std::filesystem::path &track, const int width, const int height);
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Runs one build job at a time on a background thread and hands its result back to the UI thread.
+template <typename T>
+class AsyncLoader
+{
+public:
+	using Job = std::function<std::unique_ptr<T>()>;
+
+	virtual ~AsyncLoader()
+	{
+		if (mThread.joinable())
+			mThread.join();
+	}
+
+	// Starts a job in the background. If one is already running, this replaces any job still queued.
+	void Load(Job job)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (mBusy)
+			mPending = std::move(job); // Picked up by Take() once the current job finishes.
+		else
+			Start(std::move(job));
+	}
+
+	// Returns the most recently finished result, or nullptr if none is ready yet.
+	std::unique_ptr<T> Take()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		if (!mBusy && mPending)
+		{
+			// A newer job was queued while this one ran, so this result is stale.
+			mReady.reset();
+			Start(std::move(mPending));
+			mPending = nullptr;
+		}
+
+		return std::move(mReady);
+	}
+
+private:
+	// Must be called with mMutex held and no job running.
+	void Start(Job job)
+	{
+		if (mThread.joinable())
+			mThread.join(); // Already finished, only reaps the thread.
+
+		mBusy = true;
+
+		mThread = std::thread([this, job]() {
+			auto result = job();
+
+			std::lock_guard<std::mutex> lock(mMutex);
+
+			if (result)
+				mReady = std::move(result);
+
+			mBusy = false;
+		});
+	}
+
+	std::thread mThread;
+	std::mutex mMutex;
+
+	bool mBusy = false;
+	Job mPending;
+
+	std::unique_ptr<T> mReady;
+};
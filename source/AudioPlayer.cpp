@@ -6,6 +6,45 @@ namespace Audio
 	static Uint8 *audioPos;
 
 	static int audioLen;
+	static int audioTotal;
+
+	// Set once the last buffer is queued, or while seeking or stopping, when running dry isn't an underrun.
+	static bool audioEnding;
+
+	constexpr int seekSeconds = 10;
+
+	static AlbumArtLoader artLoader;
+	static std::filesystem::path currentTrack;
+
+	// Draws the track's cover once the art loader has it ready.
+	static void UpdateAlbumArt(const bool paused)
+	{
+		auto art = artLoader.Take();
+
+		if (!art || art->mTrack != currentTrack)
+			return;
+
+		SDL_Rect albumRect = { 80, 80 };
+
+		Graphics::Blit(art->mSurface, gFileBase, nullptr, &albumRect);
+		Graphics::DrawPlaying(paused);
+	}
+
+	// Publishes how long vgmstream took to detect the last file's format, timed only while the HUD is shown.
+	static void UpdateProbeMetrics()
+	{
+		vgmstream_probe_stats stats;
+
+		vgmstream_get_probe_stats(&stats);
+
+		Metrics::Set(Metrics::ProbeTime,  static_cast<float>(stats.time_ms));
+		Metrics::Set(Metrics::ProbeTried, static_cast<float>(stats.tried));
+	}
+
+	static std::string ClipText(const std::string &text)
+	{
+		return text.length() > 40 ? text.substr(0, 40) + "..." : text;
+	}
 
 	static const PlayStatus ButtonPressCallback()
 	{
@@ -42,6 +81,9 @@ namespace Audio
 			return Stopped;
 		}
 
+		if (checkKey(k, KEY_Y))
+			Graphics::ToggleHud();
+
 		if (checkKey(k, KEY_ZL))
 		{
 			Mix_HaltMusic();
@@ -95,12 +137,17 @@ namespace Audio
 
 		if (checkKey(k, KEY_B))
 		{
+			audioEnding = true;
 			SDL_CloseAudio();
 			return Stopped;
 		}
 
+		if (checkKey(k, KEY_Y))
+			Graphics::ToggleHud();
+
 		if (checkKey(k, KEY_ZL))
 		{
+			audioEnding = true;
 			SDL_CloseAudio();
 			gGoPrevious = true;
 			return Stopped;
@@ -108,11 +155,18 @@ namespace Audio
 
 		if (checkKey(k, KEY_ZR))
 		{
+			audioEnding = true;
 			SDL_CloseAudio();
 			gGoNext = true;
 			return Stopped;
 		}
 
+		if (checkKey(k, KEY_LEFT))
+			return SeekBackward;
+
+		if (checkKey(k, KEY_RIGHT))
+			return SeekForward;
+
 #ifdef _WIN32
 		if (k.type == SDL_KEYDOWN)
 			gHasPerformed = true;
@@ -123,28 +177,47 @@ namespace Audio
 
 	void FillCallback(void *udata, Uint8 *stream, int len)
 	{
+		const uint64_t start = Metrics::Now();
+
 		SDL_memset(stream, 0, len);
 
-		if (audioLen == 0)
-			return;
+		if (len > audioLen && !audioEnding)
+			Metrics::Add(Metrics::Underruns, 1);
 
-		len = (len > audioLen ? audioLen : len);
+		if (audioLen != 0)
+		{
+			len = (len > audioLen ? audioLen : len);
+
+			SDL_MixAudio(stream, audioPos, len, SDL_MIX_MAXVOLUME);
 
-		SDL_MixAudio(stream, audioPos, len, SDL_MIX_MAXVOLUME);
+			audioPos += len;
+			audioLen -= len;
+		}
 
-		audioPos += len;
-		audioLen -= len;
+		Metrics::Set(Metrics::BufferFill, audioTotal ? 100.f * audioLen / audioTotal : 0.f);
+		Metrics::AddBusy(Metrics::CallbackThread, Metrics::Now() - start);
 	}
 
 	static const PlayStatus PlaySong(IAudio &audio, const bool loop, const PlayStatus(*cb)())
 	{
-		auto original = SDL_DuplicateSurface(gFileBase);
+		const auto &info = audio.GetTrackInfo();
+
+		std::string byline = info.mArtist;
+
+		if (!info.mAlbum.empty())
+			byline += (byline.empty() ? "" : " - ") + info.mAlbum;
 
 		Graphics::DrawText(audio.GetFormatName() + " | " +
 			std::to_string(audio.GetSampleRate()) + " Hz | " +
 			std::to_string(audio.GetNumChannels()) + " ch",
 			80, 24, { 255, 255, 255 }, true, true);
 
+		if (!info.mTitle.empty())
+			Graphics::DrawText(ClipText(info.mTitle), 80, 486, { 255, 255, 255 }, true, true);
+
+		if (!byline.empty())
+			Graphics::DrawText(ClipText(byline), 80, 518, { 255, 255, 255 }, true, true);
+
 		Graphics::Render();
 
 		int dataCount = 0;
@@ -157,26 +230,49 @@ namespace Audio
 		spec.samples  = static_cast<Uint16>(audio.GetBufferSize());
 		spec.callback = FillCallback;
 
+		audioEnding = false;
+
 		SDL_OpenAudio(&spec, NULL);
 		SDL_PauseAudio(0);
 
 StartPlaying:
 		while (!audio.GetIsBufferDone())
 		{
-			auto &data = audio.GetBuffer();
+			auto &data = [&]() -> const std::vector<short> & {
+				Metrics::ScopedTimer timer(Metrics::DecodeTime, Metrics::DecodeWork);
+				return audio.GetBuffer();
+			}();
+
+			audioEnding = audio.GetIsBufferDone() && (audio.GetIsLooped() || !loop);
+
 			dataCount += data.size() * audio.GetNumChannels();
-			audioLen = data.size() * audio.GetNumChannels();
+			audioTotal = audioLen = data.size() * audio.GetNumChannels();
 			audioPos = audioChunk = (Uint8 *)data.data();
 
 			while (audioLen > 0)
 			{
-				if (cb() == Stopped)
-				{
-					Graphics::Blit(original, gFileBase);
-					SDL_FreeSurface(original);
+				const auto status = cb();
+
+				if (status == Stopped)
 					return Finished;
+
+				// The rest of the current buffer is dropped, the next one is decoded from the new position.
+				if ((status == SeekBackward || status == SeekForward) && audio.GetCanSeek())
+				{
+					const int step = audio.GetSampleRate() * seekSeconds;
+
+					SDL_LockAudio();
+					audioLen = 0;
+					audioEnding = true;
+					SDL_UnlockAudio();
+
+					audio.Seek(audio.GetPosition() + (status == SeekForward ? step : -step));
+					break;
 				}
 
+				UpdateAlbumArt(SDL_GetAudioStatus() != SDL_AUDIO_PLAYING);
+				Graphics::UpdateHud();
+
 				SDL_Delay(1);
 			}
 		}
@@ -189,9 +285,6 @@ StartPlaying:
 
 		SDL_CloseAudio();
 
-		Graphics::Blit(original, gFileBase);
-		SDL_FreeSurface(original);
-
 		return Stopped;
 	}
 
@@ -207,6 +300,9 @@ StartPlaying:
 			if (cb() == Stopped)
 				return Finished;
 
+			UpdateAlbumArt(Mix_PausedMusic());
+			Graphics::UpdateHud();
+
 			SDL_Delay(1);
 		}
 
@@ -224,26 +320,42 @@ StartPlaying:
 
 		gme_type_t type;
 
+		// Track text and cover art are drawn onto the file list base while playing, and undone afterwards.
+		auto original = SDL_DuplicateSurface(gFileBase);
+
+		currentTrack = path;
+		artLoader.Load(path, gAlbumArt ? gAlbumArt->w : 400, gAlbumArt ? gAlbumArt->h : 400);
+
 		Graphics::Blit(gBase, gSurface);
 		Graphics::DrawPlaying(false);
 
+		vgmstream_probe_stats_enable(gShowHud);
+
 		if (gme_identify_file(path.string().c_str(), &type), type)
 		{
+			Metrics::SetBackend("GME");
 			auto gme = new GMEHandler(path.string());
 			playStatus = Audio::PlaySong(*gme, loop, Audio::ButtonPressCallbackBuffer);
 			delete gme;
 		}
-		else if (init_vgmstream(path.string().c_str()))
+		else if (VGMSTREAM *stream = VGMStreamHandler::Open(path.string()))
 		{
-			auto vgm = new VGMStreamHandler(path.string());
+			Metrics::SetBackend("vgmstream");
+			UpdateProbeMetrics();
+			auto vgm = new VGMStreamHandler(path.string(), stream);
 			playStatus = Audio::PlaySong(*vgm, loop, Audio::ButtonPressCallbackBuffer);
 			delete vgm;
 		}
 		else
 		{
+			Metrics::SetBackend("SDL_mixer");
 			playStatus = Audio::PlaySong(path, loop, Audio::ButtonPressCallback);
 		}
 
+		Graphics::Blit(original, gFileBase);
+		SDL_FreeSurface(original);
+
+		Metrics::SetBackend("none");
 		Graphics::DrawSelection();
 
 		return playStatus;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "AlbumArt.hpp"
 #include "IAudio.hpp"
 #include "Globals.hpp"
 #include "Graphics.hpp"
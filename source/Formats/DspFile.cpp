@@ -119,6 +119,11 @@ const std::string &DspFile::GetFormatName() const
 	return mFormatName;
 }
 
+const TrackInfo &DspFile::GetTrackInfo() const
+{
+	return mTrackInfo;
+}
+
 const int DspFile::GetSampleRate() const
 {
 	return mSampleRate;
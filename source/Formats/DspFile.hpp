@@ -58,6 +58,7 @@ public:
 	virtual ~DspFile() {};
 
 	const std::string &GetFormatName() const;
+	const TrackInfo &GetTrackInfo() const;
 
 	const int GetSampleRate() const;
 	const int GetNumChannels() const;
@@ -82,6 +83,7 @@ private:
 	size_t mOffset = 0;
 
 	const std::string mFormatName = "Nintendo DSP ADPCM";
+	TrackInfo mTrackInfo;
 
 	int mSampleRate;
 	int mNumChannels;
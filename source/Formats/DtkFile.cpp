@@ -27,6 +27,11 @@ const std::string &DtkFile::GetFormatName() const
 	return mFormatName;
 }
 
+const TrackInfo &DtkFile::GetTrackInfo() const
+{
+	return mTrackInfo;
+}
+
 const int DtkFile::GetSampleRate() const
 {
 	return mSampleRate;
@@ -19,6 +19,7 @@ public:
 	virtual ~DtkFile() {};
 
 	const std::string &GetFormatName() const;
+	const TrackInfo &GetTrackInfo() const;
 
 	const int GetSampleRate() const;
 	const int GetNumChannels() const;
@@ -41,6 +42,7 @@ private:
 	size_t mOffset = 0;
 
 	const std::string mFormatName = "Nintendo DTK ADPCM";
+	TrackInfo mTrackInfo;
 
 	int mSampleRate;
 	int mNumChannels;
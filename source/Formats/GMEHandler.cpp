@@ -15,6 +15,17 @@ GMEHandler::GMEHandler(const std::string &fileName)
 
 	mFormatName = type->system;
 
+	gme_info_t *info;
+
+	if (!gme_track_info(emu, &info, 0))
+	{
+		mTrackInfo.mTitle  = info->song;
+		mTrackInfo.mArtist = info->author;
+		mTrackInfo.mAlbum  = info->game;
+
+		gme_free_info(info);
+	}
+
 	mSampleRate = 48000;
 	mNumChannels = 2;
 
@@ -31,6 +42,11 @@ const std::string &GMEHandler::GetFormatName() const
 	return mFormatName;
 }
 
+const TrackInfo &GMEHandler::GetTrackInfo() const
+{
+	return mTrackInfo;
+}
+
 const int GMEHandler::GetSampleRate() const
 {
 	return mSampleRate;
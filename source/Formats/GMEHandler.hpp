@@ -21,6 +21,7 @@ public:
 	virtual ~GMEHandler();
 
 	const std::string &GetFormatName() const;
+	const TrackInfo &GetTrackInfo() const;
 
 	const int GetSampleRate() const;
 	const int GetNumChannels() const;
@@ -42,6 +43,7 @@ private:
 	Music_Emu *emu;
 
 	std::string mFormatName;
+	TrackInfo mTrackInfo;
 
 	int mSampleRate;
 	int mNumChannels;
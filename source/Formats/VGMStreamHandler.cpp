@@ -1,19 +1,190 @@
+#include <strings.h>
+
+#include <iterator>
+#include <system_error>
+
 #include "VGMStreamHandler.hpp"
 
+constexpr const char *seekIndexDir =
+#ifndef _WIN32
+	"sdmc:/switch/VGMPlayerNX/seek/";
+#else
+	"seek/";
+#endif
+
+constexpr const char *keyCachePath =
+#ifndef _WIN32
+	"sdmc:/switch/VGMPlayerNX/keys.bin";
+#else
+	"keys.bin";
+#endif
+
+std::mutex VGMStreamHandler::sKeyCacheMutex;
+bool VGMStreamHandler::sKeyCacheLoaded = false;
+uint32_t VGMStreamHandler::sKeyCacheVersion = 0;
+
 VGMStreamHandler::VGMStreamHandler(const std::string &fileName)
+	: VGMStreamHandler(fileName, Open(fileName))
 {
-	vgm = init_vgmstream(fileName.c_str());
+}
 
+VGMStreamHandler::VGMStreamHandler(const std::string &fileName, VGMSTREAM *stream)
+	: vgm(stream)
+{
 	mFormatName = get_vgmstream_coding_description(vgm->coding_type);
 
 	mSampleRate = vgm->sample_rate;
 	mNumChannels = vgm->channels;
 
 	mOutBuffer.resize(mBufferSize * 2);
+
+	ReadTags(fileName);
+	LoadSeekIndex(fileName);
+}
+
+// Opens the file with the key cache loaded; returns NULL when no vgmstream format accepts it.
+VGMSTREAM *VGMStreamHandler::Open(const std::string &fileName)
+{
+	LoadKeyCache();
+
+	VGMSTREAM *stream = init_vgmstream(fileName.c_str());
+
+	SaveKeyCache();
+
+	return stream;
+}
+
+// Reads TITLE/ARTIST/ALBUM for this file from the folder's !tags.m3u, if there is one.
+void VGMStreamHandler::ReadTags(const std::string &fileName)
+{
+	const auto separator = fileName.find_last_of("/\\");
+
+	if (separator == std::string::npos)
+		return;
+
+	STREAMFILE *tagFile = open_stdio_streamfile((fileName.substr(0, separator + 1) + "!tags.m3u").c_str());
+
+	if (!tagFile)
+		return;
+
+	const char *key, *val;
+
+	VGMSTREAM_TAGS *tags = vgmstream_tags_init(&key, &val);
+	vgmstream_tags_reset(tags, fileName.c_str());
+
+	while (vgmstream_tags_next_tag(tags, tagFile))
+	{
+		if (!strcasecmp(key, "TITLE"))
+			mTrackInfo.mTitle = val;
+		else if (!strcasecmp(key, "ARTIST"))
+			mTrackInfo.mArtist = val;
+		else if (!strcasecmp(key, "ALBUM"))
+			mTrackInfo.mAlbum = val;
+	}
+
+	vgmstream_tags_close(tags);
+	close_streamfile(tagFile);
+}
+
+// Seek indexes are named after the file's path, size and modification time, like album art thumbnails.
+void VGMStreamHandler::LoadSeekIndex(const std::string &fileName)
+{
+	std::string key = fileName;
+
+	try
+	{
+		key += '|' + std::to_string(std::filesystem::file_size(fileName));
+		key += '|' + std::to_string(std::filesystem::last_write_time(fileName).time_since_epoch().count());
+	}
+	catch (...) {};
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.vsi", static_cast<unsigned long long>(std::hash<std::string>{}(key)));
+
+	mSeekIndexPath = std::filesystem::path(seekIndexDir) / name;
+
+	std::ifstream file(mSeekIndexPath, std::fstream::binary);
+
+	if (!file)
+		return;
+
+	std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	if (vgmstream_seek_index_import(vgm, reinterpret_cast<const uint8_t *>(data.data()), data.size()))
+		mSeekIndexSize = data.size();
+}
+
+// Only rewrites the cache when playback learned points past the saved ones.
+void VGMStreamHandler::SaveSeekIndex()
+{
+	const size_t size = vgmstream_seek_index_export(vgm, nullptr, 0);
+
+	if (size <= mSeekIndexSize)
+		return;
+
+	std::vector<uint8_t> data(size);
+
+	if (vgmstream_seek_index_export(vgm, data.data(), data.size()) != size)
+		return;
+
+	std::error_code error;
+	std::filesystem::create_directories(mSeekIndexPath.parent_path(), error);
+
+	std::ofstream file(mSeekIndexPath, std::fstream::binary);
+
+	file.write(reinterpret_cast<const char *>(data.data()), data.size());
+}
+
+void VGMStreamHandler::LoadKeyCache()
+{
+	std::lock_guard<std::mutex> lock(sKeyCacheMutex);
+
+	if (sKeyCacheLoaded)
+		return;
+
+	sKeyCacheLoaded = true;
+
+	std::ifstream file(keyCachePath, std::fstream::binary);
+
+	if (file)
+	{
+		std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		vgmstream_key_cache_import(reinterpret_cast<const uint8_t *>(data.data()), data.size());
+	}
+
+	sKeyCacheVersion = vgmstream_key_cache_version();
+}
+
+void VGMStreamHandler::SaveKeyCache()
+{
+	std::lock_guard<std::mutex> lock(sKeyCacheMutex);
+
+	const uint32_t version = vgmstream_key_cache_version();
+
+	if (version == sKeyCacheVersion)
+		return;
+
+	const size_t size = vgmstream_key_cache_export(nullptr, 0);
+
+	std::vector<uint8_t> data(size);
+
+	if (!size || vgmstream_key_cache_export(data.data(), data.size()) != size)
+		return;
+
+	std::error_code error;
+	std::filesystem::create_directories(std::filesystem::path(keyCachePath).parent_path(), error);
+
+	std::ofstream file(keyCachePath, std::fstream::binary);
+
+	file.write(reinterpret_cast<const char *>(data.data()), data.size());
+
+	sKeyCacheVersion = version;
 }
 
 VGMStreamHandler::~VGMStreamHandler()
 {
+	SaveSeekIndex();
 	close_vgmstream(vgm);
 }
 
@@ -22,6 +193,11 @@ const std::string &VGMStreamHandler::GetFormatName() const
 	return mFormatName;
 }
 
+const TrackInfo &VGMStreamHandler::GetTrackInfo() const
+{
+	return mTrackInfo;
+}
+
 const int VGMStreamHandler::GetSampleRate() const
 {
 	return mSampleRate;
@@ -64,7 +240,8 @@ const bool VGMStreamHandler::GetIsBufferDone() const
 
 const std::vector<short> &VGMStreamHandler::GetBuffer()
 {
-	render_vgmstream(mOutBuffer.data(), mBufferSize, vgm);
+	render_vgmstream_s16(mOutBuffer.data(), mBufferSize, vgm);
+	mPosition += mBufferSize;
 
 	if (vgm->current_sample >= vgm->num_samples)
 		mIsBufferDone = true;
@@ -75,4 +252,23 @@ const std::vector<short> &VGMStreamHandler::GetBuffer()
 void VGMStreamHandler::ResetState()
 {
 	reset_vgmstream(vgm);
+	mPosition = 0;
+}
+
+const bool VGMStreamHandler::GetCanSeek() const
+{
+	return true;
+}
+
+const int VGMStreamHandler::GetPosition() const
+{
+	return mPosition;
+}
+
+void VGMStreamHandler::Seek(const int sample)
+{
+	seek_vgmstream(vgm, sample);
+
+	mPosition = sample < 0 ? 0 : sample;
+	mIsBufferDone = vgm->current_sample >= vgm->num_samples;
 }
\ No newline at end of file
@@ -1,12 +1,15 @@
 #pragma once
 
 #include <array>
+#include <filesystem>
 #include <fstream>
+#include <mutex>
 #include <vector>
 
 extern "C"
 {
 #include "../vgmstream/vgmstream.h"
+#include "../vgmstream/plugins.h"
 };
 
 #include "../IAudio.hpp"
@@ -17,10 +20,15 @@ class VGMStreamHandler
 public:
 	VGMStreamHandler() {};
 	VGMStreamHandler(const std::string &fileName);
+	// Takes ownership of a stream already opened with Open.
+	VGMStreamHandler(const std::string &fileName, VGMSTREAM *stream);
+
+	static VGMSTREAM *Open(const std::string &fileName);
 
 	virtual ~VGMStreamHandler();
 
 	const std::string &GetFormatName() const;
+	const TrackInfo &GetTrackInfo() const;
 
 	const int GetSampleRate() const;
 	const int GetNumChannels() const;
@@ -38,10 +46,32 @@ public:
 
 	void ResetState();
 
+	const bool GetCanSeek() const;
+	const int GetPosition() const;
+
+	void Seek(const int sample);
+
 private:
+	void ReadTags(const std::string &fileName);
+
+	// Seek points vgmstream learns while playing are kept in an on-disk cache, so seeking in streams that
+	// can't jump directly only decodes from the closest point after the first playback.
+	void LoadSeekIndex(const std::string &fileName);
+	void SaveSeekIndex();
+
+	// Keys vgmstream finds by testing its lists for encrypted formats are shared by all files, loaded before
+	// the first file opens and saved when a new one is learned, so later files in a game's folder open quickly.
+	static void LoadKeyCache();
+	static void SaveKeyCache();
+
+	static std::mutex sKeyCacheMutex;
+	static bool sKeyCacheLoaded;
+	static uint32_t sKeyCacheVersion;
+
 	VGMSTREAM *vgm;
 
 	std::string mFormatName;
+	TrackInfo mTrackInfo;
 
 	int mSampleRate;
 	int mNumChannels;
@@ -56,5 +86,10 @@ private:
 
 	bool mIsBufferDone = false;
 
+	int mPosition = 0;
+
 	std::vector<short> mOutBuffer;
+
+	std::filesystem::path mSeekIndexPath;
+	size_t mSeekIndexSize = 0;
 };
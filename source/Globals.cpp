@@ -14,6 +14,8 @@ uint32_t gPlayState = PlayOne;
 bool gGoPrevious = false;
 bool gGoNext = false;
 
+bool gShowHud = false;
+
 SDL_Event gEvent;
 
 #ifdef _WIN32
@@ -53,7 +53,9 @@ enum PlayStatus
 	Stopped,
 	Paused,
 	Playing,
-	Finished
+	Finished,
+	SeekBackward,
+	SeekForward
 };
 
 constexpr uint8_t operator ""_pct(const unsigned long long percent)
@@ -75,6 +77,8 @@ extern uint32_t gPlayState;
 extern bool gGoPrevious;
 extern bool gGoNext;
 
+extern bool gShowHud;
+
 extern SDL_Event gEvent;
 
 extern bool checkKey(
@@ -2,27 +2,58 @@
 
 namespace Graphics
 {
+	static ThemeLoader themeLoader;
+
+	// Swaps a built theme into the globals; the previous theme's resources are released with it.
+	static void ApplyTheme(std::unique_ptr<LoadedTheme> loaded)
+	{
+		// FreeType isn't safe to use from two threads at once, so the font is opened here on the UI thread.
+		auto fontRW = SDL_RWFromMem((void *)loaded->mTheme->GetFont().data(), loaded->mTheme->GetFont().size());
+		loaded->mFont = TTF_OpenFontRW(fontRW, SDL_TRUE, 28);
+
+		std::swap(gTheme,    loaded->mTheme);
+		std::swap(gSurface,  loaded->mSurface);
+		std::swap(gAlbumArt, loaded->mAlbumArt);
+		std::swap(gBase,     loaded->mBase);
+		std::swap(gFileBase, loaded->mFileBase);
+		std::swap(gFont,     loaded->mFont);
+	}
+
 	void InitTheme(const std::string &fileName)
 	{
-		SDL_Rect albumRect = { 80, 80 };
+		auto loaded = ThemeLoader::Build(fileName);
 
-		gTheme = std::make_unique<ThemeProvider>(fileName);
+		if (loaded)
+			ApplyTheme(std::move(loaded));
+	}
 
-		auto bgRW  = SDL_RWFromMem((void *)gTheme->GetBackground().data(), gTheme->GetBackground().size());
-		auto artRW = SDL_RWFromMem((void *)gTheme->GetAlbumArt().data(), gTheme->GetAlbumArt().size());
+	void LoadTheme(const std::string &fileName)
+	{
+		themeLoader.Load(fileName);
+	}
 
-		gSurface  = SDL_LoadBMP_RW(bgRW,  SDL_TRUE);
-		gAlbumArt = SDL_LoadBMP_RW(artRW, SDL_TRUE);
+	bool UpdateTheme()
+	{
+		auto loaded = themeLoader.Take();
 
-		gBase     = SDL_CreateRGBSurface(0, 1280, 720, 24, 255, 255, 255, 0);
-		gFileBase = SDL_CreateRGBSurface(0, 1280, 720, 24, 255, 255, 255, 0);
+		if (!loaded)
+			return false;
 
-		Blit(gAlbumArt, gSurface, nullptr, &albumRect);
-		Blit(gSurface, gBase);
-		Blit(gSurface, gFileBase);
+		ApplyTheme(std::move(loaded));
+		return true;
+	}
 
-		auto fontRW  = SDL_RWFromMem((void *)gTheme->GetFont().data(), gTheme->GetFont().size());
-		gFont        = TTF_OpenFontRW(fontRW, SDL_TRUE, 28);
+	void FreeTheme()
+	{
+		// Swapping with an empty theme hands the current resources over to be released.
+		LoadedTheme empty;
+
+		std::swap(gTheme,    empty.mTheme);
+		std::swap(gSurface,  empty.mSurface);
+		std::swap(gAlbumArt, empty.mAlbumArt);
+		std::swap(gBase,     empty.mBase);
+		std::swap(gFileBase, empty.mFileBase);
+		std::swap(gFont,     empty.mFont);
 	}
 
 	void Blit(SDL_Surface *src, SDL_Surface *dest, const SDL_Rect *srcPos, SDL_Rect *destPos)
@@ -34,7 +65,7 @@ namespace Graphics
 	{
 		SDL_Rect fontRect{ x, y };
 
-		auto textSurface = TTF_RenderText_Blended(gFont, string.c_str(), colour);
+		auto textSurface = TTF_RenderUTF8_Blended(gFont, string.c_str(), colour);
 
 		Blit(textSurface, gSurface, nullptr, &fontRect);
 
@@ -200,13 +231,78 @@ namespace Graphics
 		}
 	}
 
+	static uint64_t lastHudUpdate;
+
+	// Draws the metrics overlay over the rendered frame, straight to the renderer so gSurface is left untouched.
+	static void DrawHud()
+	{
+		char lines[8][64];
+
+		Metrics::SampleLoads();
+
+		snprintf(lines[0], sizeof(lines[0]), "Backend: %s",            Metrics::GetBackend());
+		snprintf(lines[1], sizeof(lines[1]), "Frame: %.2f ms",         Metrics::Get(Metrics::FrameTime));
+		snprintf(lines[2], sizeof(lines[2]), "Decode: %.2f ms/buffer", Metrics::Get(Metrics::DecodeTime));
+		snprintf(lines[3], sizeof(lines[3]), "Buffer fill: %.0f%%",    Metrics::Get(Metrics::BufferFill));
+		snprintf(lines[4], sizeof(lines[4]), "Underruns: %.0f",        Metrics::Get(Metrics::Underruns));
+		snprintf(lines[5], sizeof(lines[5]), "Main: %.0f%% (decode %.0f%%)",
+			Metrics::Get(Metrics::MainLoad), Metrics::Get(Metrics::DecodeLoad));
+		snprintf(lines[6], sizeof(lines[6]), "Audio callback: %.0f%%", Metrics::Get(Metrics::CallbackLoad));
+		snprintf(lines[7], sizeof(lines[7]), "Probe: %.2f ms (%.0f tried)",
+			Metrics::Get(Metrics::ProbeTime), Metrics::Get(Metrics::ProbeTried));
+
+		SDL_Rect background = { 860, 16, 404, 16 + 8 * 33 };
+
+		SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 70_pct);
+		SDL_RenderFillRect(gRenderer, &background);
+
+		for (int i = 0; i < 8; i++)
+		{
+			auto textSurface = TTF_RenderUTF8_Blended(gFont, lines[i], { 255, 255, 255 });
+
+			if (!textSurface)
+				continue;
+
+			SDL_Rect textRect = { 872, 24 + i * 33, textSurface->w, textSurface->h };
+			auto textTexture  = SDL_CreateTextureFromSurface(gRenderer, textSurface);
+
+			SDL_RenderCopy(gRenderer, textTexture, nullptr, &textRect);
+
+			SDL_DestroyTexture(textTexture);
+			SDL_FreeSurface(textSurface);
+		}
+
+		lastHudUpdate = Metrics::Now();
+	}
+
 	void Render()
 	{
-		auto texture = SDL_CreateTextureFromSurface(gRenderer, gSurface);
+		{
+			Metrics::ScopedTimer timer(Metrics::FrameTime, Metrics::MainThread);
+
+			auto texture = SDL_CreateTextureFromSurface(gRenderer, gSurface);
+
+			SDL_RenderCopy(gRenderer, texture, nullptr, nullptr);
+
+			SDL_DestroyTexture(texture);
+		}
+
+		if (gShowHud)
+			DrawHud();
 
-		SDL_RenderCopy(gRenderer, texture, nullptr, nullptr);
 		SDL_RenderPresent(gRenderer);
+	}
 
-		SDL_DestroyTexture(texture);
+	void ToggleHud()
+	{
+		gShowHud = !gShowHud;
+		Render();
+	}
+
+	// Redraws a few times a second while the HUD is shown, since nothing else renders during playback.
+	void UpdateHud()
+	{
+		if (gShowHud && Metrics::ToMs(Metrics::Now() - lastHudUpdate) >= 250.f)
+			Render();
 	}
 }
\ No newline at end of file
@@ -3,12 +3,21 @@
 #include <string>
 #include <vector>
 
+// Track metadata, with fields left empty when the format or tag file doesn't provide them.
+struct TrackInfo
+{
+	std::string mTitle;
+	std::string mArtist;
+	std::string mAlbum;
+};
+
 class IAudio
 {
 public:
 	virtual ~IAudio() {};
 
 	virtual const std::string &GetFormatName() const = 0;
+	virtual const TrackInfo   &GetTrackInfo()  const = 0;
 
 	virtual const int GetSampleRate()  const = 0;
 	virtual const int GetNumChannels() const = 0;
@@ -25,4 +34,10 @@ public:
 	virtual const std::vector<short> &GetBuffer() = 0;
 
 	virtual void ResetState() = 0;
+
+	// Formats that can jump to a play position (in samples since the start, loops included) override these.
+	virtual const bool GetCanSeek()  const { return false; }
+	virtual const int  GetPosition() const { return 0; }
+
+	virtual void Seek(const int sample) {};
 };
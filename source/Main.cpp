@@ -145,10 +145,9 @@ int main(int argc, char *argv[])
 			}
 			else if (audioFiles[gSelection].extension() == ".tpk")
 			{
+				// Built in the background and swapped in by Graphics::UpdateTheme below.
 				themeLocation = audioFiles[gSelection].string();
-				Graphics::InitTheme(themeLocation);
-				gSelection = 0;
-				drawDirs();
+				Graphics::LoadTheme(themeLocation);
 			}
 			else
 				stateSwitch();
@@ -165,6 +164,12 @@ int main(int argc, char *argv[])
 			gHasPerformed = false;
 #endif
 
+		if (Graphics::UpdateTheme())
+		{
+			gSelection = 0;
+			drawDirs();
+		}
+
 		if (gGoPrevious)
 		{
 			gGoPrevious = false;
@@ -248,6 +253,11 @@ int main(int argc, char *argv[])
 			Graphics::DrawSelection();
 		}
 
+		if (checkKey(k, KEY_Y))
+			Graphics::ToggleHud();
+
+		Graphics::UpdateHud();
+
 		if (checkKey(k, KEY_PLUS))
 		{
 			if (Graphics::DrawMessageBox("Would you like to exit?", "A: OK", "B: Go back"))
@@ -262,13 +272,9 @@ int main(int argc, char *argv[])
 		SDL_Delay(1);
 	}
 
-	TTF_CloseFont(gFont);
+	Graphics::FreeTheme();
 	TTF_Quit();
 
-	SDL_FreeSurface(gSurface);
-	SDL_FreeSurface(gBase);
-	SDL_FreeSurface(gFileBase);
-
 	SDL_DestroyRenderer(gRenderer);
 	SDL_DestroyWindow(gWindow);
 
@@ -0,0 +1,86 @@
+#include <atomic>
+
+#include "Globals.hpp"
+#include "Metrics.hpp"
+
+namespace Metrics
+{
+	static std::atomic<float> gauges[MetricCount];
+	static std::atomic<uint64_t> busyTicks[ThreadCount];
+	static std::atomic<const char *> currentBackend{ "none" };
+
+	static uint64_t lastSample;
+
+	void Set(const Metric metric, const float value)
+	{
+		gauges[metric].store(value, std::memory_order_relaxed);
+	}
+
+	// Only safe with a single writer per metric, which holds for every caller.
+	void Add(const Metric metric, const float value)
+	{
+		Set(metric, Get(metric) + value);
+	}
+
+	float Get(const Metric metric)
+	{
+		return gauges[metric].load(std::memory_order_relaxed);
+	}
+
+	void SetBackend(const char *backend)
+	{
+		currentBackend.store(backend, std::memory_order_relaxed);
+	}
+
+	const char *GetBackend()
+	{
+		return currentBackend.load(std::memory_order_relaxed);
+	}
+
+	uint64_t Now()
+	{
+		return SDL_GetPerformanceCounter();
+	}
+
+	float ToMs(const uint64_t ticks)
+	{
+		return static_cast<float>(ticks * 1000.0 / SDL_GetPerformanceFrequency());
+	}
+
+	void AddBusy(const Thread thread, const uint64_t ticks)
+	{
+		busyTicks[thread].fetch_add(ticks, std::memory_order_relaxed);
+	}
+
+	void SampleLoads()
+	{
+		const uint64_t now = Now();
+		const uint64_t wall = now - lastSample;
+
+		lastSample = now;
+
+		if (!wall)
+			return;
+
+		auto load = [&](const Thread thread) {
+			return 100.f * busyTicks[thread].exchange(0, std::memory_order_relaxed) / wall;
+		};
+
+		// Decoding runs on the main thread, so it counts towards its load too.
+		const float decodeLoad = load(DecodeWork);
+
+		Set(DecodeLoad,   decodeLoad);
+		Set(MainLoad,     load(MainThread) + decodeLoad);
+		Set(CallbackLoad, load(CallbackThread));
+	}
+
+	ScopedTimer::~ScopedTimer()
+	{
+		const uint64_t elapsed = Now() - mStart;
+
+		Set(mMetric, ToMs(elapsed));
+
+		if (mThread != ThreadCount)
+			AddBusy(mThread, elapsed);
+	}
+}
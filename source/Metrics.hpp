@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+
+// Lock-free gauges written from the UI, decode and audio callback threads and read by the debug HUD.
+namespace Metrics
+{
+	enum Metric
+	{
+		FrameTime,    // ms spent in the last Graphics::Render.
+		DecodeTime,   // ms spent filling the last buffer in IAudio::GetBuffer.
+		BufferFill,   // % of the current buffer not yet consumed by the audio callback.
+		Underruns,    // Times the audio callback asked for more than was buffered.
+		MainLoad,     // % of wall time the main thread spent rendering and decoding.
+		DecodeLoad,   // % of wall time the main thread spent decoding.
+		CallbackLoad, // % of wall time spent in the audio callback.
+		ProbeTime,    // ms vgmstream spent detecting the current file's format.
+		ProbeTried,   // Format parsers vgmstream tried on it.
+		MetricCount
+	};
+
+	// Threads whose busy time is turned into a load percentage.
+	enum Thread
+	{
+		MainThread,     // Rendering on the main thread.
+		DecodeWork,     // Decoding, which also runs on the main thread.
+		CallbackThread, // SDL's audio callback thread.
+		ThreadCount
+	};
+
+	void  Set(const Metric metric, const float value);
+	void  Add(const Metric metric, const float value);
+	float Get(const Metric metric);
+
+	// Name of the playback backend (GME, vgmstream, SDL_mixer), must be a string literal.
+	void SetBackend(const char *backend);
+	const char *GetBackend();
+
+	uint64_t Now();
+	float ToMs(const uint64_t ticks);
+
+	void AddBusy(const Thread thread, const uint64_t ticks);
+
+	// Converts busy time since the previous call into the *Load gauges.
+	void SampleLoads();
+
+	// Stores the time spent in its scope into a gauge, and optionally adds it to a thread's busy time.
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(const Metric metric, const Thread thread = ThreadCount)
+			: mMetric(metric), mThread(thread), mStart(Now()) {};
+
+		~ScopedTimer();
+
+	private:
+		const Metric mMetric;
+		const Thread mThread;
+		const uint64_t mStart;
+	};
+}
@@ -0,0 +1,46 @@
+#include "ThemeLoader.hpp"
+#include "ThemeTexture.hpp"
+
+LoadedTheme::~LoadedTheme()
+{
+	if (mFont)
+		TTF_CloseFont(mFont);
+
+	SDL_FreeSurface(mSurface);
+	SDL_FreeSurface(mAlbumArt);
+	SDL_FreeSurface(mBase);
+	SDL_FreeSurface(mFileBase);
+}
+
+std::unique_ptr<LoadedTheme> ThemeLoader::Build(const std::string &fileName)
+{
+	SDL_Rect albumRect = { 80, 80 };
+
+	auto loaded = std::make_unique<LoadedTheme>();
+	loaded->mTheme = std::make_unique<ThemeProvider>(fileName);
+
+	const auto &theme = *loaded->mTheme;
+
+	loaded->mSurface  = ThemeTexture::Load(theme.GetBackground());
+	loaded->mAlbumArt = ThemeTexture::Load(theme.GetAlbumArt());
+
+	if (!loaded->mSurface || theme.GetFont().empty())
+		return nullptr;
+
+	loaded->mBase     = SDL_CreateRGBSurface(0, 1280, 720, 24, 255, 255, 255, 0);
+	loaded->mFileBase = SDL_CreateRGBSurface(0, 1280, 720, 24, 255, 255, 255, 0);
+
+	// Software surfaces only, so blitting here doesn't touch the renderer.
+	SDL_BlitSurface(loaded->mAlbumArt, nullptr, loaded->mSurface, &albumRect);
+	SDL_BlitSurface(loaded->mSurface, nullptr, loaded->mBase, nullptr);
+	SDL_BlitSurface(loaded->mSurface, nullptr, loaded->mFileBase, nullptr);
+
+	return loaded;
+}
+
+void ThemeLoader::Load(const std::string &fileName)
+{
+	AsyncLoader::Load([fileName]() {
+		return Build(fileName);
+	});
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "AsyncLoader.hpp"
+#include "Globals.hpp"
+#include "ITheme.hpp"
+#include "ThemeProvider.hpp"
+
+// Everything drawn from a theme, built off the UI thread and swapped into the globals in one go.
+struct LoadedTheme
+{
+	~LoadedTheme();
+
+	std::unique_ptr<ITheme> mTheme; // Declared first so the font's backing data outlives the font.
+
+	SDL_Surface *mSurface   = nullptr;
+	SDL_Surface *mAlbumArt  = nullptr;
+	SDL_Surface *mBase      = nullptr;
+	SDL_Surface *mFileBase  = nullptr;
+
+	TTF_Font *mFont = nullptr;
+};
+
+class ThemeLoader
+	: public AsyncLoader<LoadedTheme>
+{
+public:
+	// Builds a theme on the calling thread, returning nullptr if it can't be decoded. The font is left closed.
+	static std::unique_ptr<LoadedTheme> Build(const std::string &fileName);
+
+	// Starts building a theme in the background.
+	void Load(const std::string &fileName);
+};
@@ -14,8 +14,11 @@ ThemePak::ThemePak(const std::string &fileName)
 	mHandle.read(inBuf.data(), hLen.mCompressedLength); // Read string section into vector buffer.
 
 	// Decompress string section into new vector buffer.
-	tinf_uncompress(outBuf.data(), reinterpret_cast<uint32_t *>(&hLen), // (Ab)using HeaderLengths struct.
-		inBuf.data(), hLen.mCompressedLength);
+	unsigned int destLen = outBuf.size();
+
+	if (tinf_uncompress(outBuf.data(), &destLen, inBuf.data(), hLen.mCompressedLength) != TINF_OK
+		|| destLen != outBuf.size())
+		return; // Corrupt string section, leave pak empty.
 
 	// Resize vector fields to accommodate for number of files in pak, calculated by counting string null-terminators.
 	mFiles.resize(std::count(outBuf.begin(), outBuf.end(), 0));
@@ -57,8 +60,12 @@ const std::vector<char> ThemePak::GetFile(const std::string &name)
 		mHandle.seekg(mFiles.at(found).mOffset); // Seek to offset of file within pak.
 		mHandle.read(cmpBuf.data(), mFiles.at(found).mLengths.mCompressedLength); // Read compressed file into vector buffer.
 
-		tinf_uncompress(outBuf.data(), &mFiles.at(found).mLengths.mDecompressedLength, // Decompress file into new vector buffer.
-			cmpBuf.data(), mFiles.at(found).mLengths.mCompressedLength);
+		unsigned int destLen = outBuf.size();
+
+		if (tinf_uncompress(outBuf.data(), &destLen, // Decompress file into new vector buffer.
+			cmpBuf.data(), mFiles.at(found).mLengths.mCompressedLength) != TINF_OK
+			|| destLen != outBuf.size())
+			return {}; // Corrupt file, return empty vector.
 
 		return outBuf; // Return vector containing decompressed data.
 	}
@@ -3,12 +3,23 @@
 ThemeProvider::ThemeProvider(const std::string &fileName) 
 	: ThemePak(fileName)
 {
-	mAlbumArt   = GetFile("album_art.bmp");
-	mBackground = GetFile("background.bmp");
+	mAlbumArt   = GetImage("album_art");
+	mBackground = GetImage("background");
 	mFont       = GetFile("font.ttf");
 	mHandle.close();
 }
 
+// Prefers a pre-converted .tex image, falling back to a .bmp.
+const std::vector<char> ThemeProvider::GetImage(const std::string &name)
+{
+	auto image = GetFile(name + ".tex");
+
+	if (image.empty())
+		image = GetFile(name + ".bmp");
+
+	return image;
+}
+
 const std::string &ThemeProvider::GetThemeName() const
 {
 	return mThemeName;
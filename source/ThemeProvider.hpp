@@ -21,6 +21,8 @@ public:
 	const std::vector<char> &GetFont()       const;
 
 private:
+	const std::vector<char> GetImage(const std::string &name);
+
 	std::string mThemeName = "Default";
 
 	std::vector<char> mAlbumArt;
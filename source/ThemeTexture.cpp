@@ -0,0 +1,41 @@
+#include <cstring>
+
+#include "ThemeTexture.hpp"
+
+namespace ThemeTexture
+{
+	static int GetBytesPerPixel(const uint32_t format)
+	{
+		switch (format)
+		{
+			case SDL_PIXELFORMAT_RGB24:    return 3;
+			case SDL_PIXELFORMAT_ABGR8888: return 4;
+			case SDL_PIXELFORMAT_RGB565:   return 2;
+			default:                       return 0;
+		}
+	}
+
+	SDL_Surface *Load(const std::vector<char> &data)
+	{
+		ThemeTextureHeader header;
+
+		if (data.size() < sizeof(ThemeTextureHeader) || std::memcmp(data.data(), "VTEX", 4))
+		{
+			auto rw = SDL_RWFromMem((void *)data.data(), data.size());
+			return SDL_LoadBMP_RW(rw, SDL_TRUE);
+		}
+
+		std::memcpy(&header, data.data(), sizeof(ThemeTextureHeader));
+
+		const int bpp = GetBytesPerPixel(header.mFormat);
+
+		if (!bpp || header.mPitch < static_cast<uint32_t>(header.mWidth) * bpp ||
+			data.size() - sizeof(ThemeTextureHeader) < static_cast<size_t>(header.mPitch) * header.mHeight)
+			return nullptr;
+
+		// The pak data belongs to the theme and isn't read again once its surfaces exist, so the
+		// surface can use (and be drawn over) it in place rather than keeping a second copy.
+		return SDL_CreateRGBSurfaceWithFormatFrom(const_cast<char *>(data.data()) + sizeof(ThemeTextureHeader),
+			header.mWidth, header.mHeight, bpp * 8, header.mPitch, header.mFormat);
+	}
+}
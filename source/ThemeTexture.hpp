@@ -0,0 +1,23 @@
+#pragma once
+
+#include <vector>
+
+#include "Globals.hpp"
+
+// Header of a .tex theme image. The pixel rows that follow are already in an SDL pixel format,
+// so the image is wrapped by a surface as-is instead of being parsed and converted like a BMP.
+struct ThemeTextureHeader
+{
+	char     mMagic[4]; // "VTEX"
+	uint16_t mWidth;
+	uint16_t mHeight;
+	uint32_t mFormat;   // SDL_PIXELFORMAT_RGB24, SDL_PIXELFORMAT_ABGR8888 or SDL_PIXELFORMAT_RGB565.
+	uint32_t mPitch;    // Bytes per row of pixel data.
+};
+
+namespace ThemeTexture
+{
+	// Returns a surface for .tex or .bmp data, or nullptr if it is neither.
+	// Surfaces of .tex data point straight into data, which must outlive them.
+	SDL_Surface *Load(const std::vector<char> &data);
+}
@@ -79,6 +79,17 @@ extern "C" {
 	int TINFCC tinf_uncompress(void *dest, unsigned int *destLen,
 		const void *source, unsigned int sourceLen);
 
+	/**
+	 * Same as `tinf_uncompress`, using the original bit-at-a-time decoder.
+	 *
+	 * Slower, but simple enough to serve as a reference when verifying the
+	 * table-driven decoder behind `tinf_uncompress`.
+	 *
+	 * @see tinf_uncompress
+	 */
+	int TINFCC tinf_uncompress_ref(void *dest, unsigned int *destLen,
+		const void *source, unsigned int sourceLen);
+
 	/**
 	 * Decompress `sourceLen` bytes of gzip data from `source` to `dest`.
 	 *
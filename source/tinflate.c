@@ -27,6 +27,8 @@
 
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
 #if defined(UINT_MAX) && (UINT_MAX) < 0xFFFFFFFFUL
 #  error "tinf requires unsigned int to be at least 32-bit"
@@ -55,6 +57,57 @@ struct tinf_data {
 	struct tinf_tree dtree; /* Distance tree */
 };
 
+/* Number of bits resolved by a single fast table lookup */
+#define TINF_FAST_BITS 10
+
+struct tinf_fast_tree {
+	unsigned short table[1 << TINF_FAST_BITS]; /* (symbol << 4) | length, 0 for longer codes */
+	struct tinf_tree tree; /* Canonical tree, walked for codes longer than TINF_FAST_BITS */
+};
+
+struct tinf_fast_data {
+	const unsigned char *source;
+	const unsigned char *source_end;
+	uint64_t tag;
+	int bitcount;
+	int padding; /* Number of zero bytes appended past source_end */
+
+	unsigned char *dest_start;
+	unsigned char *dest;
+	unsigned char *dest_end;
+
+	struct tinf_fast_tree ltree; /* Literal/length tree */
+	struct tinf_fast_tree dtree; /* Distance tree */
+};
+
+/* -- Length and distance tables -- */
+
+/* Extra bits and base tables for length codes */
+static const unsigned char length_bits[30] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+	1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+	4, 4, 4, 4, 5, 5, 5, 5, 0, 127
+};
+
+static const unsigned short length_base[30] = {
+	 3,  4,  5,   6,   7,   8,   9,  10,  11,  13,
+	15, 17, 19,  23,  27,  31,  35,  43,  51,  59,
+	67, 83, 99, 115, 131, 163, 195, 227, 258,   0
+};
+
+/* Extra bits and base tables for distance codes */
+static const unsigned char dist_bits[30] = {
+	0, 0,  0,  0,  1,  1,  2,  2,  3,  3,
+	4, 4,  5,  5,  6,  6,  7,  7,  8,  8,
+	9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const unsigned short dist_base[30] = {
+	   1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
+	  33,   49,   65,   97,  129,  193,  257,   385,   513,   769,
+	1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
 /* -- Utility functions -- */
 
 static unsigned int read_le16(const unsigned char *p)
@@ -63,6 +116,18 @@ static unsigned int read_le16(const unsigned char *p)
 		| ((unsigned int)p[1] << 8);
 }
 
+static uint64_t read_le64(const unsigned char *p)
+{
+	return ((uint64_t)p[0])
+		| ((uint64_t)p[1] << 8)
+		| ((uint64_t)p[2] << 16)
+		| ((uint64_t)p[3] << 24)
+		| ((uint64_t)p[4] << 32)
+		| ((uint64_t)p[5] << 40)
+		| ((uint64_t)p[6] << 48)
+		| ((uint64_t)p[7] << 56);
+}
+
 /* Build fixed Huffman trees */
 static void tinf_build_fixed_trees(struct tinf_tree *lt, struct tinf_tree *dt)
 {
@@ -390,32 +455,6 @@ static int tinf_decode_trees(struct tinf_data *d, struct tinf_tree *lt,
 static int tinf_inflate_block_data(struct tinf_data *d, struct tinf_tree *lt,
 	struct tinf_tree *dt)
 {
-	/* Extra bits and base tables for length codes */
-	static const unsigned char length_bits[30] = {
-		0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
-		1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
-		4, 4, 4, 4, 5, 5, 5, 5, 0, 127
-	};
-
-	static const unsigned short length_base[30] = {
-		 3,  4,  5,   6,   7,   8,   9,  10,  11,  13,
-		15, 17, 19,  23,  27,  31,  35,  43,  51,  59,
-		67, 83, 99, 115, 131, 163, 195, 227, 258,   0
-	};
-
-	/* Extra bits and base tables for distance codes */
-	static const unsigned char dist_bits[30] = {
-		0, 0,  0,  0,  1,  1,  2,  2,  3,  3,
-		4, 4,  5,  5,  6,  6,  7,  7,  8,  8,
-		9, 9, 10, 10, 11, 11, 12, 12, 13, 13
-	};
-
-	static const unsigned short dist_base[30] = {
-		   1,    2,    3,    4,    5,    7,    9,    13,    17,    25,
-		  33,   49,   65,   97,  129,  193,  257,   385,   513,   769,
-		1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
-	};
-
 	for (;;) {
 		int sym = tinf_decode_symbol(d, lt);
 
@@ -545,6 +584,434 @@ static int tinf_inflate_dynamic_block(struct tinf_data *d)
 	return tinf_inflate_block_data(d, &d->ltree, &d->dtree);
 }
 
+/* -- Fast decode functions -- */
+
+/*
+ * The fast path resolves Huffman codes of up to TINF_FAST_BITS bits with a
+ * single table lookup, keeps at least 56 bits buffered so a whole
+ * length/distance pair decodes with one refill, and copies matches a word
+ * at a time. It produces the same output and error codes as the reference
+ * decoder above, which is kept as tinf_uncompress_ref for verification.
+ */
+
+/* Reverse the low len bits of code */
+static unsigned int tinf_reverse_bits(unsigned int code, int len)
+{
+	unsigned int rev = 0;
+
+	while (len--) {
+		rev = (rev << 1) | (code & 1);
+		code >>= 1;
+	}
+
+	return rev;
+}
+
+/* Fill the lookup table from the canonical tree */
+static void tinf_build_fast_table(struct tinf_fast_tree *ft)
+{
+	const struct tinf_tree *t = &ft->tree;
+	unsigned int code = 0, index = 0;
+	unsigned int i;
+	int len;
+
+	for (i = 0; i < (1 << TINF_FAST_BITS); ++i) {
+		ft->table[i] = 0;
+	}
+
+	/*
+	 * Codes are read starting from their most significant bit, while the
+	 * table is indexed by the next bits of the LSB-first stream, so every
+	 * code is stored bit-reversed and replicated for all values of the
+	 * bits that follow it.
+	 */
+	for (len = 1; len <= TINF_FAST_BITS; ++len) {
+		for (i = 0; i < t->counts[len]; ++i, ++code, ++index) {
+			unsigned int entry = ((unsigned int)t->symbols[index] << 4) | len;
+			unsigned int j;
+
+			for (j = tinf_reverse_bits(code, len); j < (1 << TINF_FAST_BITS); j += 1 << len) {
+				ft->table[j] = entry;
+			}
+		}
+		code <<= 1;
+	}
+}
+
+static void tinf_build_fast_fixed_trees(struct tinf_fast_tree *lt, struct tinf_fast_tree *dt)
+{
+	tinf_build_fixed_trees(&lt->tree, &dt->tree);
+	tinf_build_fast_table(lt);
+	tinf_build_fast_table(dt);
+}
+
+static int tinf_build_fast_tree(struct tinf_fast_tree *ft, const unsigned char *lengths,
+	unsigned int num)
+{
+	int res = tinf_build_tree(&ft->tree, lengths, num);
+
+	if (res != TINF_OK) {
+		return res;
+	}
+
+	tinf_build_fast_table(ft);
+
+	return TINF_OK;
+}
+
+/* Top up the bit buffer to at least 56 bits */
+static void tinf_fast_refill(struct tinf_fast_data *d)
+{
+	if (d->source_end - d->source >= 8) {
+		/*
+		 * Load a whole word and advance by the number of whole bytes
+		 * that fit. The bits of the next byte that spill past bitcount
+		 * are the same bits the next refill ORs in, so they are harmless.
+		 */
+		int num = (63 - d->bitcount) >> 3;
+
+		d->tag |= read_le64(d->source) << d->bitcount;
+		d->source += num;
+		d->bitcount += num << 3;
+	}
+	else {
+		/* Near the end of input, pad with zero bytes and count them */
+		while (d->bitcount < 56) {
+			if (d->source != d->source_end) {
+				d->tag |= (uint64_t)*d->source++ << d->bitcount;
+			}
+			else {
+				d->padding++;
+			}
+			d->bitcount += 8;
+		}
+	}
+}
+
+/* Check if any padding bits past the end of source have been consumed */
+static int tinf_fast_overflow(const struct tinf_fast_data *d)
+{
+	return d->bitcount < (d->padding << 3);
+}
+
+/* Get num bits, the caller must have refilled enough */
+static unsigned int tinf_fast_getbits(struct tinf_fast_data *d, int num)
+{
+	unsigned int bits;
+
+	assert(num >= 0 && num <= d->bitcount);
+
+	bits = (unsigned int)(d->tag & ((UINT64_C(1) << num) - 1));
+
+	d->tag >>= num;
+	d->bitcount -= num;
+
+	return bits;
+}
+
+/* Given a data stream and a tree, decode a symbol (needs 15 bits buffered) */
+static int tinf_fast_decode_symbol(struct tinf_fast_data *d, const struct tinf_fast_tree *ft)
+{
+	const struct tinf_tree *t = &ft->tree;
+	unsigned int entry = ft->table[d->tag & ((1 << TINF_FAST_BITS) - 1)];
+	int base = 0, offs = 0;
+	int len;
+
+	if (entry != 0) {
+		tinf_fast_getbits(d, entry & 15);
+		return entry >> 4;
+	}
+
+	/* Code is longer than the table, walk the tree as tinf_decode_symbol does */
+	for (len = 1; len <= 15; ++len) {
+		offs = 2 * offs + (int)((d->tag >> (len - 1)) & 1);
+
+		if (offs < t->counts[len]) {
+			tinf_fast_getbits(d, len);
+			return t->symbols[base + offs];
+		}
+
+		base += t->counts[len];
+		offs -= t->counts[len];
+	}
+
+	/* No code matched (empty tree), return a symbol no tree accepts */
+	return 288;
+}
+
+/* Given a data stream, decode dynamic trees from it */
+static int tinf_fast_decode_trees(struct tinf_fast_data *d, struct tinf_fast_tree *lt,
+	struct tinf_fast_tree *dt)
+{
+	unsigned char lengths[288 + 32];
+
+	/* Special ordering of code length codes */
+	static const unsigned char clcidx[19] = {
+		16, 17, 18, 0,  8, 7,  9, 6, 10, 5,
+		11,  4, 12, 3, 13, 2, 14, 1, 15
+	};
+
+	unsigned int hlit, hdist, hclen;
+	unsigned int i, num, length;
+	int res;
+
+	tinf_fast_refill(d);
+
+	/* Get 5 bits HLIT (257-286), 5 bits HDIST (1-32) and 4 bits HCLEN (4-19) */
+	hlit = tinf_fast_getbits(d, 5) + 257;
+	hdist = tinf_fast_getbits(d, 5) + 1;
+	hclen = tinf_fast_getbits(d, 4) + 4;
+
+	/* See tinf_decode_trees */
+	if (hlit > 286 || hdist > 30) {
+		return TINF_DATA_ERROR;
+	}
+
+	for (i = 0; i < 19; ++i) {
+		lengths[i] = 0;
+	}
+
+	/* Read code lengths for code length alphabet */
+	tinf_fast_refill(d);
+
+	for (i = 0; i < hclen; ++i) {
+		/* Get 3 bits code length (0-7), at most 57 bits in total */
+		if (i == 10) {
+			tinf_fast_refill(d);
+		}
+
+		lengths[clcidx[i]] = tinf_fast_getbits(d, 3);
+	}
+
+	/* Build code length tree (in literal/length tree to save space) */
+	res = tinf_build_fast_tree(lt, lengths, 19);
+
+	if (res != TINF_OK) {
+		return res;
+	}
+
+	/* Check code length tree is not empty */
+	if (lt->tree.max_sym == -1) {
+		return TINF_DATA_ERROR;
+	}
+
+	/* Decode code lengths for the dynamic trees */
+	for (num = 0; num < hlit + hdist; ) {
+		int sym;
+
+		tinf_fast_refill(d);
+
+		sym = tinf_fast_decode_symbol(d, lt);
+
+		if (sym > lt->tree.max_sym) {
+			return TINF_DATA_ERROR;
+		}
+
+		switch (sym) {
+		case 16:
+			/* Copy previous code length 3-6 times (read 2 bits) */
+			if (num == 0) {
+				return TINF_DATA_ERROR;
+			}
+			sym = lengths[num - 1];
+			length = tinf_fast_getbits(d, 2) + 3;
+			break;
+		case 17:
+			/* Repeat code length 0 for 3-10 times (read 3 bits) */
+			sym = 0;
+			length = tinf_fast_getbits(d, 3) + 3;
+			break;
+		case 18:
+			/* Repeat code length 0 for 11-138 times (read 7 bits) */
+			sym = 0;
+			length = tinf_fast_getbits(d, 7) + 11;
+			break;
+		default:
+			/* Values 0-15 represent the actual code lengths */
+			length = 1;
+			break;
+		}
+
+		if (length > hlit + hdist - num) {
+			return TINF_DATA_ERROR;
+		}
+
+		while (length--) {
+			lengths[num++] = sym;
+		}
+	}
+
+	if (tinf_fast_overflow(d)) {
+		return TINF_DATA_ERROR;
+	}
+
+	/* Check EOB symbol is present */
+	if (lengths[256] == 0) {
+		return TINF_DATA_ERROR;
+	}
+
+	/* Build dynamic trees */
+	res = tinf_build_fast_tree(lt, lengths, hlit);
+
+	if (res != TINF_OK) {
+		return res;
+	}
+
+	return tinf_build_fast_tree(dt, lengths + hlit, hdist);
+}
+
+/* Copy a match of length bytes from offs bytes back */
+static void tinf_fast_copy_match(unsigned char *dest, int offs, int length)
+{
+	const unsigned char *src = dest - offs;
+
+	if (offs >= 8) {
+		/*
+		 * Chunks never overlap their own source when offs >= 8; the
+		 * tail is copied bytewise so nothing is written past the match.
+		 */
+		while (length >= 8) {
+			memcpy(dest, src, 8);
+			dest += 8;
+			src += 8;
+			length -= 8;
+		}
+		while (length--) {
+			*dest++ = *src++;
+		}
+	}
+	else if (offs == 1) {
+		memset(dest, *src, length);
+	}
+	else {
+		while (length--) {
+			*dest++ = *src++;
+		}
+	}
+}
+
+/* Given a stream and two trees, inflate a block of data */
+static int tinf_fast_inflate_block_data(struct tinf_fast_data *d, struct tinf_fast_tree *lt,
+	struct tinf_fast_tree *dt)
+{
+	for (;;) {
+		int sym, length, dist, offs;
+
+		/* One refill covers the longest length/distance pair (48 bits) */
+		tinf_fast_refill(d);
+
+		sym = tinf_fast_decode_symbol(d, lt);
+
+		/* Check for overflow in bit reader */
+		if (tinf_fast_overflow(d)) {
+			return TINF_DATA_ERROR;
+		}
+
+		if (sym < 256) {
+			if (d->dest == d->dest_end) {
+				return TINF_BUF_ERROR;
+			}
+			*d->dest++ = sym;
+			continue;
+		}
+
+		/* Check for end of block */
+		if (sym == 256) {
+			return TINF_OK;
+		}
+
+		/* Check sym is within range and distance tree is not empty */
+		if (sym > lt->tree.max_sym || sym - 257 > 28 || dt->tree.max_sym == -1) {
+			return TINF_DATA_ERROR;
+		}
+
+		sym -= 257;
+
+		/* Possibly get more bits from length code */
+		length = length_base[sym] + tinf_fast_getbits(d, length_bits[sym]);
+
+		dist = tinf_fast_decode_symbol(d, dt);
+
+		/* Check dist is within range */
+		if (dist > dt->tree.max_sym || dist > 29) {
+			return TINF_DATA_ERROR;
+		}
+
+		/* Possibly get more bits from distance code */
+		offs = dist_base[dist] + tinf_fast_getbits(d, dist_bits[dist]);
+
+		if (tinf_fast_overflow(d)) {
+			return TINF_DATA_ERROR;
+		}
+
+		if (offs > d->dest - d->dest_start) {
+			return TINF_DATA_ERROR;
+		}
+
+		if (d->dest_end - d->dest < length) {
+			return TINF_BUF_ERROR;
+		}
+
+		tinf_fast_copy_match(d->dest, offs, length);
+
+		d->dest += length;
+	}
+}
+
+/* Inflate an uncompressed block of data */
+static int tinf_fast_inflate_uncompressed_block(struct tinf_fast_data *d)
+{
+	unsigned int length, invlength;
+	int unread;
+
+	/* Skip to the byte boundary and return buffered whole bytes to source */
+	tinf_fast_getbits(d, d->bitcount & 7);
+
+	unread = (d->bitcount >> 3) - d->padding;
+
+	if (unread < 0) {
+		return TINF_DATA_ERROR;
+	}
+
+	d->source -= unread;
+	d->tag = 0;
+	d->bitcount = 0;
+	d->padding = 0;
+
+	if (d->source_end - d->source < 4) {
+		return TINF_DATA_ERROR;
+	}
+
+	/* Get length */
+	length = read_le16(d->source);
+
+	/* Get one's complement of length */
+	invlength = read_le16(d->source + 2);
+
+	/* Check length */
+	if (length != (~invlength & 0x0000FFFF)) {
+		return TINF_DATA_ERROR;
+	}
+
+	d->source += 4;
+
+	if (d->source_end - d->source < length) {
+		return TINF_DATA_ERROR;
+	}
+
+	if (d->dest_end - d->dest < length) {
+		return TINF_BUF_ERROR;
+	}
+
+	/* Copy block */
+	memcpy(d->dest, d->source, length);
+
+	d->dest += length;
+	d->source += length;
+
+	return TINF_OK;
+}
+
 /* -- Public functions -- */
 
 /* Initialize global (static) data */
@@ -553,8 +1020,8 @@ void tinf_init(void)
 	return;
 }
 
-/* Inflate stream from source to dest */
-int tinf_uncompress(void *dest, unsigned int *destLen,
+/* Inflate stream from source to dest using the bit-at-a-time decoder */
+int tinf_uncompress_ref(void *dest, unsigned int *destLen,
 	const void *source, unsigned int sourceLen)
 {
 	struct tinf_data d;
@@ -615,6 +1082,75 @@ int tinf_uncompress(void *dest, unsigned int *destLen,
 	return TINF_OK;
 }
 
+/* Inflate stream from source to dest */
+int tinf_uncompress(void *dest, unsigned int *destLen,
+	const void *source, unsigned int sourceLen)
+{
+	struct tinf_fast_data d;
+	int bfinal;
+
+	/* Initialise data */
+	d.source = (const unsigned char *)source;
+	d.source_end = d.source + sourceLen;
+	d.tag = 0;
+	d.bitcount = 0;
+	d.padding = 0;
+
+	d.dest = (unsigned char *)dest;
+	d.dest_start = d.dest;
+	d.dest_end = d.dest + *destLen;
+
+	do {
+		unsigned int btype;
+		int res;
+
+		tinf_fast_refill(&d);
+
+		/* Read final block flag */
+		bfinal = tinf_fast_getbits(&d, 1);
+
+		/* Read block type (2 bits) */
+		btype = tinf_fast_getbits(&d, 2);
+
+		/* Decompress block */
+		switch (btype) {
+		case 0:
+			/* Decompress uncompressed block */
+			res = tinf_fast_inflate_uncompressed_block(&d);
+			break;
+		case 1:
+			/* Decompress block with fixed Huffman trees */
+			tinf_build_fast_fixed_trees(&d.ltree, &d.dtree);
+			res = tinf_fast_inflate_block_data(&d, &d.ltree, &d.dtree);
+			break;
+		case 2:
+			/* Decompress block with dynamic Huffman trees */
+			res = tinf_fast_decode_trees(&d, &d.ltree, &d.dtree);
+
+			if (res == TINF_OK) {
+				res = tinf_fast_inflate_block_data(&d, &d.ltree, &d.dtree);
+			}
+			break;
+		default:
+			res = TINF_DATA_ERROR;
+			break;
+		}
+
+		if (res != TINF_OK) {
+			return res;
+		}
+	} while (!bfinal);
+
+	/* Check for overflow in bit reader */
+	if (tinf_fast_overflow(&d)) {
+		return TINF_DATA_ERROR;
+	}
+
+	*destLen = d.dest - d.dest_start;
+
+	return TINF_OK;
+}
+
 /* clang -g -O1 -fsanitize=fuzzer,address -DTINF_FUZZING tinflate.c */
 #if defined(TINF_FUZZING)
 #include <limits.h>
@@ -624,13 +1160,20 @@ int tinf_uncompress(void *dest, unsigned int *destLen,
 #include <string.h>
 
 unsigned char depacked[64 * 1024];
+unsigned char depacked_ref[64 * 1024];
 
+/* Also verifies the fast decoder against the reference decoder */
 extern int
 LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
 {
 	if (size > UINT_MAX / 2) { return 0; }
 	unsigned int destLen = sizeof(depacked);
-	tinf_uncompress(depacked, &destLen, data, size);
+	unsigned int destLenRef = sizeof(depacked_ref);
+	int res = tinf_uncompress(depacked, &destLen, data, size);
+	int resRef = tinf_uncompress_ref(depacked_ref, &destLenRef, data, size);
+	if (res != resRef) { abort(); }
+	if (res == TINF_OK && (destLen != destLenRef
+	 || memcmp(depacked, depacked_ref, destLen) != 0)) { abort(); }
 	return 0;
 }
 #endif
\ No newline at end of file
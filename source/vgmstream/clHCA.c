@@ -26,6 +26,18 @@
 #include <stdlib.h>
 #include <memory.h>
 
+/* vector versions of the heavier steps (the scalar ones are kept as reference, define CLHCA_NO_SIMD to use them) */
+#if !defined(CLHCA_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define HCA_SIMD_NEON
+#elif !defined(CLHCA_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#include <xmmintrin.h>
+#define HCA_SIMD_SSE
+#endif
+#if defined(HCA_SIMD_NEON) || defined(HCA_SIMD_SSE)
+#define HCA_SIMD
+#endif
+
 #define HCA_MASK  0x7F7F7F7F /* chunk obfuscation when the HCA is encrypted with key */
 #define HCA_SUBFRAMES_PER_FRAME  8
 #define HCA_SAMPLES_PER_SUBFRAME  128
@@ -307,6 +319,18 @@ void clHCA_ReadSamples16(clHCA *hca, signed short *samples) {
     }
 }
 
+void clHCA_ReadSamplesFloat(clHCA *hca, float *samples) {
+    unsigned int i, j, k;
+
+    for (i = 0; i < HCA_SUBFRAMES_PER_FRAME; i++) {
+        for (j = 0; j < HCA_SAMPLES_PER_SUBFRAME; j++) {
+            for (k = 0; k < hca->channels; k++) {
+                *samples++ = hca->channel[k].wave[i][j];
+            }
+        }
+    }
+}
+
 
 //--------------------------------------------------
 // Allocation and creation
@@ -1025,19 +1049,29 @@ void clHCA_DecodeReset(clHCA * hca) {
 static int decode1_unpack_channel(stChannel *ch, clData *br,
         unsigned int hfr_group_count, unsigned int packed_noise_level, const unsigned char *ath_curve);
 
-static void decode2_dequantize_coefficients(stChannel *ch, clData *br);
-
 static void decode3_reconstruct_high_frequency(stChannel *ch,
         unsigned int hfr_group_count, unsigned int bands_per_hfr_group,
         unsigned int stereo_band_count, unsigned int base_band_count, unsigned int total_band_count);
 
+#ifdef HCA_SIMD
+static void decode2_dequantize_coefficients_simd(stChannel *ch, clData *br);
+
+static void decode4_apply_intensity_stereo_simd(stChannel *ch, int subframe,
+        unsigned int usable_band_count, unsigned int base_band_count, unsigned int stereo_band_count);
+
+static void decoder5_run_imdct_simd(stChannel *ch, int subframe);
+#else
+static void decode2_dequantize_coefficients(stChannel *ch, clData *br);
+
 static void decode4_apply_intensity_stereo(stChannel *ch, int subframe,
         unsigned int usable_band_count, unsigned int base_band_count, unsigned int stereo_band_count);
 
 static void decoder5_run_imdct(stChannel *ch, int subframe);
+#endif
 
 
-int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
+/* decodes a block, or only unpacks it (reading all bits, same errors) if unpack_only is set */
+static int decode_block(clHCA *hca, void *data, unsigned int size, int unpack_only) {
     clData br;
     unsigned short sync;
     unsigned int subframe, ch;
@@ -1078,9 +1112,16 @@ int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
 
         /* unpack channel data and get dequantized spectra */
         for (ch = 0; ch < hca->channels; ch++){
+#ifdef HCA_SIMD
+            decode2_dequantize_coefficients_simd(&hca->channel[ch], &br);
+#else
             decode2_dequantize_coefficients(&hca->channel[ch], &br);
+#endif
         }
 
+        if (unpack_only)
+            continue;
+
         /* restore missing bands from spectra 1 */
         for (ch = 0; ch < hca->channels; ch++) {
             decode3_reconstruct_high_frequency(&hca->channel[ch],
@@ -1090,13 +1131,22 @@ int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
 
         /* restore missing bands from spectra 2 */
         for (ch = 0; ch < hca->channels - 1; ch++) {
+#ifdef HCA_SIMD
+            decode4_apply_intensity_stereo_simd(&hca->channel[ch], subframe,
+                    hca->total_band_count, hca->base_band_count, hca->stereo_band_count);
+#else
             decode4_apply_intensity_stereo(&hca->channel[ch], subframe,
                     hca->total_band_count, hca->base_band_count, hca->stereo_band_count);
+#endif
         }
 
         /* apply imdct */
         for (ch = 0; ch < hca->channels; ch++) {
+#ifdef HCA_SIMD
+            decoder5_run_imdct_simd(&hca->channel[ch], subframe);
+#else
             decoder5_run_imdct(&hca->channel[ch], subframe);
+#endif
         }
     }
 
@@ -1111,6 +1161,14 @@ int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
     return 0;
 }
 
+int clHCA_DecodeBlock(clHCA *hca, void *data, unsigned int size) {
+    return decode_block(hca, data, size, 0);
+}
+
+int clHCA_CheckBlock(clHCA *hca, void *data, unsigned int size) {
+    return decode_block(hca, data, size, 1);
+}
+
 //--------------------------------------------------
 // Decode 1st step
 //--------------------------------------------------
@@ -1279,6 +1337,7 @@ static const float decode2_quantized_spectrum_value[128] = {
     +0,+0,+1,-1,+2,-2,+3,-3,+4,-4,+5,-5,+6,-6,+7,-7,
 };
 
+#ifndef HCA_SIMD
 static void decode2_dequantize_coefficients(stChannel *ch, clData *br) {
     unsigned int i;
     const unsigned int csf_count = ch->coded_scalefactor_count;
@@ -1312,6 +1371,7 @@ static void decode2_dequantize_coefficients(stChannel *ch, clData *br) {
     /* clean rest of spectra */
     memset(&ch->spectra[csf_count], 0, sizeof(ch->spectra[0]) * (HCA_SAMPLES_PER_SUBFRAME - csf_count));
 }
+#endif
 
 //--------------------------------------------------
 // Decode 3rd step
@@ -1382,6 +1442,7 @@ static const unsigned int decode4_intensity_ratio_table_int[80] = {
 };
 static const float *decode4_intensity_ratio_table = (const float *)decode4_intensity_ratio_table_int;
 
+#ifndef HCA_SIMD
 static void decode4_apply_intensity_stereo(stChannel *ch_pair, int subframe,
         unsigned int total_band_count, unsigned int base_band_count, unsigned int stereo_band_count) {
     if (ch_pair[0].type != STEREO_PRIMARY)
@@ -1402,6 +1463,7 @@ static void decode4_apply_intensity_stereo(stChannel *ch_pair, int subframe,
         }
     }
 }
+#endif
 
 //--------------------------------------------------
 // Decode 5th step
@@ -1562,6 +1624,7 @@ static const unsigned int decode5_imdct_window_int[128] = {
 };
 static const float *decode5_imdct_window = (const float *)decode5_imdct_window_int;
 
+#ifndef HCA_SIMD
 static void decoder5_run_imdct(stChannel *ch, int subframe) {
     static const unsigned int size = HCA_SAMPLES_PER_SUBFRAME;
     static const unsigned int half = HCA_SAMPLES_PER_SUBFRAME / 2;
@@ -1683,3 +1746,228 @@ static void decoder5_run_imdct(stChannel *ch, int subframe) {
 #endif
     }
 }
+#endif
+
+//--------------------------------------------------
+// Vector versions
+//--------------------------------------------------
+/* Same operations and order as the scalar steps, 4 floats at a time (results only differ when the
+ * compiler fuses multiply-adds differently in either). Tables are the same precomputed twiddles. */
+#ifdef HCA_SIMD
+
+#if defined(HCA_SIMD_NEON)
+typedef float32x4_t hca_vec;
+#define HV_LOAD(p)          vld1q_f32(p)
+#define HV_STORE(p, v)      vst1q_f32(p, v)
+#define HV_SET1(f)          vdupq_n_f32(f)
+#define HV_ADD(a, b)        vaddq_f32(a, b)
+#define HV_SUB(a, b)        vsubq_f32(a, b)
+#define HV_MUL(a, b)        vmulq_f32(a, b)
+#define HV_REVERSE(v)       vcombine_f32(vrev64_f32(vget_high_f32(v)), vrev64_f32(vget_low_f32(v)))
+#define HV_LOAD_PAIRS(p, a, b) do { float32x4x2_t pair = vld2q_f32(p); a = pair.val[0]; b = pair.val[1]; } while (0)
+#else
+typedef __m128 hca_vec;
+#define HV_LOAD(p)          _mm_loadu_ps(p)
+#define HV_STORE(p, v)      _mm_storeu_ps(p, v)
+#define HV_SET1(f)          _mm_set1_ps(f)
+#define HV_ADD(a, b)        _mm_add_ps(a, b)
+#define HV_SUB(a, b)        _mm_sub_ps(a, b)
+#define HV_MUL(a, b)        _mm_mul_ps(a, b)
+#define HV_REVERSE(v)       _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,1,2,3))
+#define HV_LOAD_PAIRS(p, a, b) do { __m128 lo = _mm_loadu_ps(p), hi = _mm_loadu_ps((p) + 4); \
+        a = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2,0,2,0)); b = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3,1,3,1)); } while (0)
+#endif
+
+static void decode2_dequantize_coefficients_simd(stChannel *ch, clData *br) {
+    unsigned int i;
+    const unsigned int csf_count = ch->coded_scalefactor_count;
+
+
+    /* bitstream must be read serially, so read all quantized values first */
+    for (i = 0; i < csf_count; i++) {
+        unsigned char resolution = ch->resolution[i];
+        unsigned char bits = decode2_quantized_spectrum_max_bits[resolution];
+        unsigned int code = bitreader_read(br, bits);
+
+        if (resolution < 8) {
+            code += resolution << 4;
+            bitreader_skip(br, decode2_quantized_spectrum_bits[code] - bits);
+            ch->spectra[i] = decode2_quantized_spectrum_value[code];
+        }
+        else {
+            int signed_code = (1 - ((code & 1) << 1)) * (code >> 1);
+            if (signed_code == 0)
+                bitreader_skip(br, -1);
+            ch->spectra[i] = (float)signed_code;
+        }
+    }
+
+    /* dequantize coefs with gain (may go over csf_count, cleaned below) */
+    for (i = 0; i < csf_count; i += 4) {
+        HV_STORE(&ch->spectra[i], HV_MUL(HV_LOAD(&ch->gain[i]), HV_LOAD(&ch->spectra[i])));
+    }
+
+    /* clean rest of spectra */
+    memset(&ch->spectra[csf_count], 0, sizeof(ch->spectra[0]) * (HCA_SAMPLES_PER_SUBFRAME - csf_count));
+}
+
+static void decode4_apply_intensity_stereo_simd(stChannel *ch_pair, int subframe,
+        unsigned int total_band_count, unsigned int base_band_count, unsigned int stereo_band_count) {
+    if (ch_pair[0].type != STEREO_PRIMARY)
+        return;
+    if (stereo_band_count == 0)
+        return;
+
+    {
+        float ratio_l = decode4_intensity_ratio_table[ ch_pair[1].intensity[subframe] ];
+        float ratio_r = ratio_l - 2.0f;
+        float *sp_l = ch_pair[0].spectra;
+        float *sp_r = ch_pair[1].spectra;
+        hca_vec vratio_l = HV_SET1(ratio_l);
+        hca_vec vratio_r = HV_SET1(ratio_r);
+        unsigned int band = base_band_count;
+
+        for (; band + 4 <= total_band_count; band += 4) {
+            hca_vec l = HV_LOAD(&sp_l[band]);
+            HV_STORE(&sp_r[band], HV_MUL(l, vratio_r));
+            HV_STORE(&sp_l[band], HV_MUL(l, vratio_l));
+        }
+        for (; band < total_band_count; band++) {
+            sp_r[band] = sp_l[band] * ratio_r;
+            sp_l[band] = sp_l[band] * ratio_l;
+        }
+    }
+}
+
+static void decoder5_run_imdct_simd(stChannel *ch, int subframe) {
+    static const unsigned int size = HCA_SAMPLES_PER_SUBFRAME;
+    static const unsigned int half = HCA_SAMPLES_PER_SUBFRAME / 2;
+    static const unsigned int mdct_bits = HCA_MDCT_BITS;
+
+
+    /* apply DCT-IV to dequantized spectra (see scalar version), last passes have runs under 4 */
+    {
+        unsigned int i, j, k;
+        unsigned int count1a, count2a, count1b, count2b;
+        const float *temp1a, *temp1b;
+        float *temp2a, *temp2b;
+
+        temp1a = ch->spectra;
+        temp2a = ch->temp;
+        count1a = 1;
+        count2a = half;
+        for (i = 0; i < mdct_bits; i++) {
+            float *swap;
+            float *d1 = &temp2a[0];
+            float *d2 = &temp2a[count2a];
+
+            for (j = 0; j < count1a; j++) {
+                if (count2a >= 4) {
+                    for (k = 0; k < count2a; k += 4) {
+                        hca_vec a, b;
+                        HV_LOAD_PAIRS(temp1a, a, b);
+                        temp1a += 8;
+                        HV_STORE(d1, HV_ADD(b, a));
+                        HV_STORE(d2, HV_SUB(a, b));
+                        d1 += 4;
+                        d2 += 4;
+                    }
+                }
+                else {
+                    for (k = 0; k < count2a; k++) {
+                        float a = *(temp1a++);
+                        float b = *(temp1a++);
+                        *(d1++) = b + a;
+                        *(d2++) = a - b;
+                    }
+                }
+                d1 += count2a;
+                d2 += count2a;
+            }
+            swap = (float*) temp1a - HCA_SAMPLES_PER_SUBFRAME;
+            temp1a = temp2a;
+            temp2a = swap;
+
+            count1a = count1a << 1;
+            count2a = count2a >> 1;
+        }
+
+        temp1b = ch->temp;
+        temp2b = ch->spectra;
+        count1b = half;
+        count2b = 1;
+        for (i = 0; i < mdct_bits; i++) {
+            const float *sin_table = (const float *) decode5_sin_tables_int[i];
+            const float *cos_table = (const float *) decode5_cos_tables_int[i];
+            float *swap;
+            float *d1 = temp2b;
+            float *d2 = &temp2b[count2b * 2 - 1];
+            const float *s1 = &temp1b[0];
+            const float *s2 = &temp1b[count2b];
+
+            for (j = 0; j < count1b; j++) {
+                if (count2b >= 4) {
+                    for (k = 0; k < count2b; k += 4) {
+                        hca_vec a = HV_LOAD(s1);
+                        hca_vec b = HV_LOAD(s2);
+                        hca_vec sin = HV_LOAD(sin_table);
+                        hca_vec cos = HV_LOAD(cos_table);
+                        HV_STORE(d1, HV_SUB(HV_MUL(a, sin), HV_MUL(b, cos)));
+                        HV_STORE(d2 - 3, HV_REVERSE(HV_ADD(HV_MUL(a, cos), HV_MUL(b, sin))));
+                        s1 += 4;
+                        s2 += 4;
+                        sin_table += 4;
+                        cos_table += 4;
+                        d1 += 4;
+                        d2 -= 4;
+                    }
+                }
+                else {
+                    for (k = 0; k < count2b; k++) {
+                        float a = *(s1++);
+                        float b = *(s2++);
+                        float sin = *(sin_table++);
+                        float cos = *(cos_table++);
+                        *(d1++) = a * sin - b * cos;
+                        *(d2--) = a * cos + b * sin;
+                    }
+                }
+                s1 += count2b;
+                s2 += count2b;
+                d1 += count2b;
+                d2 += count2b * 3;
+            }
+            swap = (float*) temp1b;
+            temp1b = temp2b;
+            temp2b = swap;
+
+            count1b = count1b >> 1;
+            count2b = count2b << 1;
+        }
+
+        memcpy(ch->dct, ch->spectra, size * sizeof(float));
+    }
+
+    /* update output/imdct (window and overlap-add, mirrored halves read/written reversed) */
+    {
+        unsigned int i;
+        const float *window = decode5_imdct_window;
+        const float *dct = ch->dct;
+        float *previous = ch->imdct_previous;
+        float *wave = ch->wave[subframe];
+
+        for (i = 0; i < half; i += 4) {
+            hca_vec dct_lo_rev = HV_REVERSE(HV_LOAD(&dct[half - 4 - i]));
+            hca_vec dct_hi_rev = HV_REVERSE(HV_LOAD(&dct[size - 4 - i]));
+            hca_vec window_lo_rev = HV_REVERSE(HV_LOAD(&window[half - 4 - i]));
+            hca_vec window_hi_rev = HV_REVERSE(HV_LOAD(&window[size - 4 - i]));
+
+            HV_STORE(&wave[i], HV_ADD(HV_MUL(HV_LOAD(&window[i]), HV_LOAD(&dct[i + half])), HV_LOAD(&previous[i])));
+            HV_STORE(&wave[i + half], HV_SUB(HV_MUL(HV_LOAD(&window[i + half]), dct_hi_rev), HV_LOAD(&previous[i + half])));
+            HV_STORE(&previous[i], HV_MUL(window_hi_rev, dct_lo_rev));
+            HV_STORE(&previous[i + half], HV_MUL(window_lo_rev, HV_LOAD(&dct[i])));
+        }
+    }
+}
+
+#endif
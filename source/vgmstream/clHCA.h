@@ -70,6 +70,9 @@ int clHCA_DecodeBlock(clHCA *, void *data, unsigned int size);
  * next decode. Buffer must be at least (samplesPerBlock*channels) long. */
 void clHCA_ReadSamples16(clHCA *, signed short * outSamples);
 
+/* Same as above, but as unclamped floats (full scale is -1.0..1.0). */
+void clHCA_ReadSamplesFloat(clHCA *, float * outSamples);
+
 /* Sets a 64 bit encryption key, to properly decode blocks. This may be called
  * multiple times to change the key, before or after clHCA_DecodeHeader.
  * Key is ignored if the file is not encrypted. */
@@ -82,6 +85,11 @@ void clHCA_SetKey(clHCA *, unsigned long long keycode);
  * and select the key with scores closer to 1. */
 int clHCA_TestBlock(clHCA *hca, void *data, unsigned int size);
 
+/* Checks a single frame's bitstream (decrypting and unpacking all values, without decoding
+ * samples), as a cheaper way to reject wrong keys. Data is modified like clHCA_DecodeBlock.
+ * Returns 0 if the frame would decode, <0 on failure (same as clHCA_DecodeBlock). */
+int clHCA_CheckBlock(clHCA *hca, void *data, unsigned int size);
+
 /* Resets the internal decode state, used when restarting to decode the file from the beginning.
  * Without it there are minor differences, mainly useful when testing a new key. */
 void clHCA_DecodeReset(clHCA * hca);
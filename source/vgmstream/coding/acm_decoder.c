@@ -65,14 +65,28 @@ void decode_acm(acm_codec_data *data, sample * outbuf, int32_t samples_to_do, in
     int32_t samples_read = 0;
 
     while (samples_read < samples_to_do) {
+#ifdef VGM_SAMPLE_INT16
         int32_t bytes_read_just_now = acm_read(
                 acm,
                 (char*)(outbuf+samples_read*channelspacing),
-                (samples_to_do-samples_read)*sizeof(sample)*channelspacing,
+                (samples_to_do-samples_read)*sizeof(int16_t)*channelspacing,
                 0,2,1);
+#else
+        /* libacm outputs 16-bit PCM, widen through a small buffer */
+        int16_t pcm[0x800];
+        int32_t bytes_read_just_now, s;
+        int32_t samples_now = sizeof(pcm)/sizeof(int16_t)/channelspacing;
+        if (samples_now > samples_to_do - samples_read)
+            samples_now = samples_to_do - samples_read;
+
+        bytes_read_just_now = acm_read(acm, (char*)pcm, samples_now*sizeof(int16_t)*channelspacing, 0,2,1);
+        for (s = 0; s < bytes_read_just_now/(int32_t)sizeof(int16_t); s++) {
+            outbuf[samples_read*channelspacing + s] = pcm[s];
+        }
+#endif
 
         if (bytes_read_just_now > 0) {
-            samples_read += bytes_read_just_now/sizeof(sample)/channelspacing;
+            samples_read += bytes_read_just_now/sizeof(int16_t)/channelspacing;
         } else {
             return;
         }
@@ -66,77 +66,51 @@ static int load_buf(ACMStream *acm)
 	return 0;
 }
 
-static int load_bits(ACMStream *acm)
-{
-	int err;
-	unsigned data, got;
-	unsigned char *p = acm->buf + acm->buf_pos;
-	switch (acm->buf_size - acm->buf_pos) {
-	default:
-		data = 0;
-		got = 0;
-		break;
-	case 1:
-		data = p[0];
-		got = 8;
-		break;
-	case 2:
-		data = p[0] + (p[1] << 8);
-		got = 16;
-		break;
-	case 3:
-		data = p[0] + (p[1] << 8) + (p[2] << 16);
-		got = 24;
-		break;
-	}
-	
-	if ((err = load_buf(acm)) < 0)
-		return err;
-	
-	while (got < 32) {
-		if (acm->buf_size - acm->buf_pos == 0)
-			break;
-		data |= acm->buf[acm->buf_pos] << got;
-		got += 8;
-		acm->buf_pos++;
-	}
-	acm->bit_data = data;
-	acm->bit_avail = got;
-	return 0;
-}
-
+/* vgmstream mod: tops up a 64-bit bit buffer (originally 32-bit, refilled on every word) */
 static int get_bits_reload(ACMStream *acm, unsigned bits)
 {
-	int got, err;
-	unsigned data, b_data, b_avail;
-
-	data = acm->bit_data;
-	got = acm->bit_avail;
-	bits -= got;
+	int err, data;
 
-	if (acm->buf_size - acm->buf_pos >= 4) {
+	/* 8 bytes at once when possible; bits past the consumed bytes are ORed again on the next
+	 * refill at the same position, so they don't need masking */
+	if (acm->buf_size - acm->buf_pos >= 8) {
 		unsigned char *p = acm->buf + acm->buf_pos;
-		acm->buf_pos += 4;
-		b_data = p[0] + (p[1] << 8) + (p[2] << 16) + (p[3] << 24);
-		b_avail = 32;
-	} else	{
-		if ((err = load_bits(acm)) < 0)
-			return err;
-		if (acm->bit_avail < bits)
-			return ACM_ERR_UNEXPECTED_EOF;
-		b_data = acm->bit_data;
-		b_avail = acm->bit_avail;
+		unsigned long long word =
+				(unsigned long long)p[0]       | (unsigned long long)p[1] << 8  |
+				(unsigned long long)p[2] << 16 | (unsigned long long)p[3] << 24 |
+				(unsigned long long)p[4] << 32 | (unsigned long long)p[5] << 40 |
+				(unsigned long long)p[6] << 48 | (unsigned long long)p[7] << 56;
+		unsigned bytes = (63 - acm->bit_avail) >> 3;
+
+		acm->bit_data |= word << acm->bit_avail;
+		acm->bit_avail += bytes * 8;
+		acm->buf_pos += bytes;
 	}
-	
-	data |= (b_data & ((1 << bits) - 1)) << got;
-	acm->bit_data = b_data >> bits;
-	acm->bit_avail = b_avail - bits;
+
+	while (acm->bit_avail <= 56) {
+		if (acm->buf_pos == acm->buf_size) {
+			if (acm->bit_avail >= bits)
+				break;
+			if ((err = load_buf(acm)) < 0)
+				return err;
+			if (acm->buf_pos == acm->buf_size)
+				return ACM_ERR_UNEXPECTED_EOF;
+		}
+
+		acm->bit_data |= (unsigned long long)acm->buf[acm->buf_pos] << acm->bit_avail;
+		acm->bit_avail += 8;
+		acm->buf_pos++;
+	}
+
+	data = acm->bit_data & ((1 << bits) - 1);
+	acm->bit_data >>= bits;
+	acm->bit_avail -= bits;
 	return data;
 }
 
 #define GET_BITS_NOERR(tmpval, acm, bits) do { \
 		if (acm->bit_avail >= bits) { \
-			tmpval = acm->bit_data & ((1 << bits) - 1); \
+			tmpval = (int)acm->bit_data & ((1 << bits) - 1); \
 			acm->bit_data >>= bits; \
 			acm->bit_avail -= bits; \
 		} else \
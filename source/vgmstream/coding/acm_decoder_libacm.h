@@ -68,7 +68,7 @@ struct ACMStream {
 	/* acm stream buffer */
 	unsigned char *buf;
 	unsigned buf_max, buf_size, buf_pos, bit_avail;
-	unsigned bit_data;
+	unsigned long long bit_data;	/* vgmstream mod: 64-bit so refills are rare */
 	unsigned buf_start_ofs;
 
 	/* block lengths (in samples) */
@@ -47,6 +47,7 @@ size_t apple_ima4_bytes_to_samples(size_t bytes, int channels);
 
 /* ngc_dsp_decoder */
 void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do);
+void decode_ngc_dsp_mch(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t first_sample, int32_t samples_to_do);
 void decode_ngc_dsp_subint(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int interleave);
 size_t dsp_bytes_to_samples(size_t bytes, int channels);
 int32_t dsp_nibbles_to_samples(int32_t nibbles);
@@ -201,8 +202,10 @@ hca_codec_data *init_hca(STREAMFILE *streamFile);
 void decode_hca(hca_codec_data * data, sample * outbuf, int32_t samples_to_do);
 void reset_hca(hca_codec_data * data);
 void loop_hca(hca_codec_data * data, int32_t num_sample);
+void seek_hca(hca_codec_data * data, int32_t num_sample);
 void free_hca(hca_codec_data * data);
 int test_hca_key(hca_codec_data * data, unsigned long long keycode);
+int test_hca_keys(hca_codec_data * data, const unsigned long long * keycodes, int count, int * scores);
 
 #ifdef VGM_USE_VORBIS
 /* ogg_vorbis_decoder */
@@ -1,4 +1,8 @@
 #include "coding.h"
+#include "../util.h"
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
 
 
 /* init a HCA stream; STREAMFILE will be duplicated for internal use. */
@@ -35,7 +39,7 @@ hca_codec_data * init_hca(STREAMFILE *streamFile) {
     data->data_buffer = malloc(data->info.blockSize);
     if (!data->data_buffer) goto fail;
 
-    data->sample_buffer = malloc(sizeof(signed short) * data->info.channelCount * data->info.samplesPerBlock);
+    data->sample_buffer = malloc(sizeof(sample_t) * data->info.channelCount * data->info.samplesPerBlock);
     if (!data->sample_buffer) goto fail;
 
     /* load streamfile for reads */
@@ -53,6 +57,23 @@ fail:
     return NULL;
 }
 
+/* gets the last decoded frame, wider formats skip clHCA's 16-bit conversion */
+static void read_hca_samples(hca_codec_data * data) {
+#ifdef VGM_SAMPLE_INT16
+    clHCA_ReadSamples16(data->handle, data->sample_buffer);
+#else
+    int i, count = data->info.channelCount * data->info.samplesPerBlock;
+
+    /* sample_t is as big as a float, so convert in place */
+    clHCA_ReadSamplesFloat(data->handle, (float*)data->sample_buffer);
+    for (i = 0; i < count; i++) {
+        float f;
+        memcpy(&f, &data->sample_buffer[i], sizeof(float));
+        data->sample_buffer[i] = float_to_sample(f * 32768.0f);
+    }
+#endif
+}
+
 void decode_hca(hca_codec_data * data, sample * outbuf, int32_t samples_to_do) {
 	int samples_done = 0;
     const unsigned int channels = data->info.channelCount;
@@ -111,7 +132,7 @@ void decode_hca(hca_codec_data * data, sample * outbuf, int32_t samples_to_do) {
             }
 
             /* extract samples */
-            clHCA_ReadSamples16(data->handle, data->sample_buffer);
+            read_hca_samples(data);
 
             data->current_block++;
             data->samples_consumed = 0;
@@ -149,6 +170,26 @@ void loop_hca(hca_codec_data * data, int32_t num_sample) {
     data->samples_to_discard = data->info.loopStartDelay;
 }
 
+/* Frames are fixed size and only the IMDCT overlap carries over between them, so decoding the frame
+ * before the target (then discarded) makes output exact without decoding from the start. */
+void seek_hca(hca_codec_data * data, int32_t num_sample) {
+    int32_t target_sample;
+
+    if (!data) return;
+
+    target_sample = num_sample + data->info.encoderDelay;
+
+    clHCA_DecodeReset(data->handle);
+    data->current_block = target_sample / data->info.samplesPerBlock;
+    data->samples_filled = 0;
+    data->samples_consumed = 0;
+    data->samples_to_discard = target_sample - (data->current_block * data->info.samplesPerBlock);
+    if (data->current_block > 0) {
+        data->current_block--;
+        data->samples_to_discard += data->info.samplesPerBlock;
+    }
+}
+
 void free_hca(hca_codec_data * data) {
     if (!data) return;
 
@@ -173,35 +214,97 @@ void free_hca(hca_codec_data * data) {
 #define HCA_KEY_MAX_FRAME_SCORE  150
 #define HCA_KEY_MAX_TOTAL_SCORE  (HCA_KEY_MAX_TEST_FRAMES * 50*HCA_KEY_SCORE_SCALE)
 
+#define HCA_KEY_MAX_FRAMES       (HCA_KEY_MAX_SKIP_BLANKS + HCA_KEY_MAX_TEST_FRAMES)
+/* key lists are long (thousands of subkeys), but threads only pay off over a few keys */
+#define HCA_KEY_WORKERS          2
+#define HCA_KEY_MIN_PARALLEL     16
+
+/* Keys are tested in parallel over frames read once (tests must decrypt a copy as decoding is in
+ * place). Each worker has its own clHCA handle, and picks the next key in list order until all are
+ * tested or a perfect score is found: then only keys before it still need testing (the first
+ * perfect key in the list wins, as when testing one by one). */
+typedef struct {
+    hca_codec_data *data;
+    uint8_t *header;
+    uint8_t *frames[HCA_KEY_MAX_FRAMES];    /* read on demand */
+    int frames_count;                       /* readable frames (lowered on read errors) */
+    int first_frame;                        /* first frame with data, -1 if none */
+
+    const unsigned long long *keycodes;
+    int *scores;
+    int next_key;
+    int last_key;                           /* keys after this one aren't needed */
+#ifdef VGM_USE_THREADS
+    pthread_mutex_t lock;                   /* frame reads and key picking */
+#endif
+} hca_keysearch;
+
+#ifdef VGM_USE_THREADS
+#define KEYSEARCH_LOCK(ks)      pthread_mutex_lock(&(ks)->lock)
+#define KEYSEARCH_UNLOCK(ks)    pthread_mutex_unlock(&(ks)->lock)
+#else
+#define KEYSEARCH_LOCK(ks)
+#define KEYSEARCH_UNLOCK(ks)
+#endif
+
+static const uint8_t * get_key_frame(hca_keysearch *ks, int index) {
+    const unsigned int blockSize = ks->data->info.blockSize;
+    const uint8_t *frame = NULL;
+
+    KEYSEARCH_LOCK(ks);
+    if (index < ks->frames_count) {
+        if (!ks->frames[index]) {
+            off_t offset = ks->data->info.headerSize + index * blockSize;
+            uint8_t *buf = malloc(blockSize);
+
+            if (buf && read_streamfile(buf, offset, blockSize, ks->data->streamfile) == blockSize) {
+                ks->frames[index] = buf;
+            }
+            else {
+                free(buf);
+                ks->frames_count = index;
+            }
+        }
+        frame = ks->frames[index];
+    }
+    KEYSEARCH_UNLOCK(ks);
+
+    return frame;
+}
+
 /* Test a number of frames if key decrypts correctly.
  * Returns score: <0: error/wrong, 0: unknown/silent file, >0: good (the closest to 1 the better). */
-int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
+static int score_hca_key(hca_keysearch *ks, void *handle, uint8_t *buf, unsigned long long keycode) {
     size_t test_frames = 0, current_frame = 0, blank_frames = 0;
     int total_score = 0, found_regular_frame = 0;
-    const unsigned int blockSize = data->info.blockSize;
+    const unsigned int blockSize = ks->data->info.blockSize;
 
-    /* Due to the potentially large number of keys this must be tuned for speed.
-     * Buffered IO seems fast enough (not very different reading a large block once vs frame by frame).
-     * clHCA_TestBlock could be optimized a bit more. */
+    clHCA_SetKey(handle, keycode);
 
-    clHCA_SetKey(data->handle, keycode);
+    /* wrong keys usually break the bitstream, check that before fully decoding frames
+     * (the first frame with data is always tested, so this doesn't change results) */
+    if (ks->first_frame >= 0) {
+        memcpy(buf, ks->frames[ks->first_frame], blockSize);
+        if (clHCA_CheckBlock(handle, buf, blockSize) < 0)
+            return -1;
+    }
 
     /* Test up to N non-blank frames or until total frames. */
     /* A final score of 0 (=silent) is only possible for short files with all blank frames */
 
-    while (test_frames < HCA_KEY_MAX_TEST_FRAMES && current_frame < data->info.blockCount) {
-        off_t offset = data->info.headerSize + current_frame * blockSize;
+    while (test_frames < HCA_KEY_MAX_TEST_FRAMES && current_frame < ks->data->info.blockCount) {
+        const uint8_t *frame;
         int score;
-        size_t bytes;
 
         /* read and test frame */
-        bytes = read_streamfile(data->data_buffer, offset, blockSize, data->streamfile);
-        if (bytes != blockSize) {
+        frame = get_key_frame(ks, current_frame);
+        if (!frame) {
             total_score = -1;
             break;
         }
+        memcpy(buf, frame, blockSize);
 
-        score = clHCA_TestBlock(data->handle, (void*)(data->data_buffer), blockSize);
+        score = clHCA_TestBlock(handle, (void*)buf, blockSize);
         if (score < 0 || score > HCA_KEY_MAX_FRAME_SCORE) {
             total_score = -1;
             break;
@@ -239,6 +342,162 @@ int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
         total_score = 1;
     }
 
-    clHCA_DecodeReset(data->handle);
+    clHCA_DecodeReset(handle);
     return total_score;
 }
+
+/* tests keys until none are left, with a handle of its own */
+static void run_keysearch(hca_keysearch *ks) {
+    const unsigned int blockSize = ks->data->info.blockSize;
+    void *handle = NULL;
+    uint8_t *buf = NULL;
+
+    handle = malloc(clHCA_sizeof());
+    buf = malloc(blockSize);
+    if (!handle || !buf) goto end;
+
+    clHCA_clear(handle);
+    if (clHCA_DecodeHeader(handle, ks->header, ks->data->info.headerSize) < 0)
+        goto end;
+
+    while (1) {
+        int key, score;
+
+        KEYSEARCH_LOCK(ks);
+        key = ks->next_key;
+        if (key <= ks->last_key)
+            ks->next_key++;
+        KEYSEARCH_UNLOCK(ks);
+        if (key > ks->last_key)
+            break;
+
+        score = score_hca_key(ks, handle, buf, ks->keycodes[key]);
+        ks->scores[key] = score;
+
+        /* best possible score */
+        if (score == 1) {
+            KEYSEARCH_LOCK(ks);
+            if (key < ks->last_key)
+                ks->last_key = key;
+            KEYSEARCH_UNLOCK(ks);
+        }
+    }
+
+end:
+    if (handle) clHCA_done(handle);
+    free(handle);
+    free(buf);
+}
+
+#ifdef VGM_USE_THREADS
+typedef struct {
+    hca_keysearch *ks;
+    int index;
+} keysearch_worker;
+
+static void * keysearch_thread(void * arg) {
+    keysearch_worker *worker = arg;
+
+    set_worker_thread_core(worker->index);
+    run_keysearch(worker->ks);
+    return NULL;
+}
+#endif
+
+/* Tests a list of keys, setting their scores (see test_hca_key) up to the first key with the best
+ * possible score. Returns the number of keys tested (keys after that are left unset), or <0 on error. */
+int test_hca_keys(hca_codec_data * data, const unsigned long long * keycodes, int count, int * scores) {
+    hca_keysearch *ks = NULL;
+    int i, tested = -1;
+
+    if (count <= 0)
+        return 0;
+
+    ks = calloc(1, sizeof(hca_keysearch));
+    if (!ks) goto end;
+
+    for (i = 0; i < count; i++) {
+        scores[i] = -1; /* in case some test can't run */
+    }
+
+    ks->data = data;
+    ks->keycodes = keycodes;
+    ks->scores = scores;
+    ks->next_key = 0;
+    ks->last_key = count - 1;
+    ks->frames_count = data->info.blockCount < HCA_KEY_MAX_FRAMES ? data->info.blockCount : HCA_KEY_MAX_FRAMES;
+#ifdef VGM_USE_THREADS
+    pthread_mutex_init(&ks->lock, NULL);
+#endif
+
+    ks->header = malloc(data->info.headerSize);
+    if (!ks->header) goto end;
+    if (read_streamfile(ks->header, 0x00, data->info.headerSize, data->streamfile) != data->info.headerSize)
+        goto end;
+
+    /* find the first frame with data (blank frames are all 0 even when encrypted) */
+    ks->first_frame = -1;
+    for (i = 0; i < ks->frames_count; i++) {
+        const uint8_t *frame = get_key_frame(ks, i);
+        unsigned int pos;
+
+        if (!frame)
+            break;
+        for (pos = 0x02; pos < data->info.blockSize - 0x02; pos++) {
+            if (frame[pos] != 0)
+                break;
+        }
+        if (pos < data->info.blockSize - 0x02) {
+            ks->first_frame = i;
+            break;
+        }
+    }
+
+    {
+        int workers = count >= HCA_KEY_MIN_PARALLEL ? get_worker_thread_count(HCA_KEY_WORKERS) : 0;
+#ifdef VGM_USE_THREADS
+        pthread_t threads[HCA_KEY_WORKERS];
+        keysearch_worker worker_args[HCA_KEY_WORKERS];
+        int started = 0;
+
+        for (i = 0; i < workers; i++) {
+            worker_args[started].ks = ks;
+            worker_args[started].index = i;
+            if (pthread_create(&threads[started], NULL, keysearch_thread, &worker_args[started]) == 0)
+                started++;
+        }
+#endif
+
+        run_keysearch(ks);
+
+#ifdef VGM_USE_THREADS
+        for (i = 0; i < started; i++) {
+            pthread_join(threads[i], NULL);
+        }
+#endif
+    }
+
+    tested = ks->last_key + 1;
+end:
+    if (ks) {
+        for (i = 0; i < HCA_KEY_MAX_FRAMES; i++) {
+            free(ks->frames[i]);
+        }
+        free(ks->header);
+#ifdef VGM_USE_THREADS
+        pthread_mutex_destroy(&ks->lock);
+#endif
+        free(ks);
+    }
+    return tested;
+}
+
+/* Test a number of frames if key decrypts correctly.
+ * Returns score: <0: error/wrong, 0: unknown/silent file, >0: good (the closest to 1 the better). */
+int test_hca_key(hca_codec_data * data, unsigned long long keycode) {
+    int score = -1;
+
+    if (test_hca_keys(data, &keycode, 1, &score) != 1)
+        return -1;
+    return score;
+}
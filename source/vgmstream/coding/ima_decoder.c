@@ -1,6 +1,10 @@
 #include "../util.h"
 #include "coding.h"
 
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
+
 /**
  * IMA ADPCM algorithms (expand one nibble to one sample, based on prev sample/history and step table).
  * Nibbles are usually grouped in blocks/chunks, with a header, containing 1 or N channels
@@ -9,6 +13,10 @@
  * - interleave: blocks and channels are handled externally (layouts) or internally (mixed channels)
  * - block header: none (external), normal (4 bytes of history 16b + step 8b + reserved 8b) or others; per channel/global
  * - expand type: IMA style or variations; low or high nibble first
+ *
+ * Since the delta and next step index only depend on the current step index and the nibble, each expand
+ * type is precomputed into a table (from the original formulas below), so all variants share one decode
+ * loop over nibbles fetched in whole frames or windows, and only differ in how history is clamped.
  */
 
 static const int ADPCMTable[89] = {
@@ -28,13 +36,13 @@ static const int ADPCMTable[89] = {
 
 static const int IMA_IndexTable[16] = {
     -1, -1, -1, -1, 2, 4, 6, 8,
-    -1, -1, -1, -1, 2, 4, 6, 8 
+    -1, -1, -1, -1, 2, 4, 6, 8
 };
 
 
 /* Original IMA expansion, using shift+ADDs to avoid MULs (slow back then) */
-static void std_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
+static int std_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     /* simplified through math from:
      *  - diff = (code + 1/2) * (step / 4)
@@ -42,48 +50,18 @@ static void std_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset,
      *    > diff = (step * nibble / 4) + (step / 8)
      * final diff = [signed] (step / 8) + (step / 4) + (step / 2) + (step) [when code = 4+2+1] */
 
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf; /* ADPCM code */
-    sample_decoded = *hist1; /* predictor value */
-    step = ADPCMTable[*step_index]; /* current step */
-
-    delta = step >> 3;
-    if (sample_nibble & 1) delta += step >> 2;
-    if (sample_nibble & 2) delta += step >> 1;
-    if (sample_nibble & 4) delta += step;
-    if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
-}
-
-/* Apple's IMA variation. Exactly the same except it uses 16b history (probably more sensitive to overflow/sign extend?) */
-static void std_ima_expand_nibble_16(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int16_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-    step = ADPCMTable[*step_index];
-
     delta = step >> 3;
     if (sample_nibble & 1) delta += step >> 2;
     if (sample_nibble & 2) delta += step >> 1;
     if (sample_nibble & 4) delta += step;
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded); /* no need for this, actually */
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
 }
 
 /* Original IMA expansion, but using MULs rather than shift+ADDs (faster for newer processors).
  * There is minor rounding difference between ADD and MUL expansions, noticeable/propagated in non-headered IMAs. */
-static void std_ima_expand_nibble_mul(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
+static int mul_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     /* simplified through math from:
      *  - diff = (code + 1/2) * (step / 4)
@@ -91,69 +69,35 @@ static void std_ima_expand_nibble_mul(VGMSTREAMCHANNEL * stream, off_t byte_offs
      *    > diff = (code + 1/2) * 2 * step / 8
      * final diff = [signed] ((code * 2 + 1) * step) / 8 */
 
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-    step = ADPCMTable[*step_index];
-
     delta = (sample_nibble & 0x7);
     delta = ((delta * 2 + 1) * step) >> 3;
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
 }
 
-/* 3DS IMA (Mario Golf, Mario Tennis; maybe other Camelot games) */
-static void n3ds_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-    step = ADPCMTable[*step_index];
+/* 3DS IMA (Mario Golf, Mario Tennis; maybe other Camelot games).
+ * Expands as ((hist << 3) + delta) >> 3, same as adding the (floored) delta >> 3. */
+static int n3ds_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
-    sample_decoded = sample_decoded << 3;
     delta = (sample_nibble & 0x07);
     delta = step * delta * 2 + step; /* custom */
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-    sample_decoded = sample_decoded >> 3;
-
-    *hist1 = clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta >> 3;
 }
 
-/* The Incredibles PC, updates step_index before doing current sample */
-static void snds_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
-
-    step = ADPCMTable[*step_index];
+/* The Incredibles PC, updates step_index before doing current sample (step comes from the next index) */
+static int snds_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     delta = (sample_nibble & 7) * step / 4 + step / 8; /* standard IMA */
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded);
+    return delta;
 }
 
 /* Omikron: The Nomad Soul, algorithm from the .exe */
-static void otns_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-    step = ADPCMTable[*step_index];
+static int otns_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     delta = 0;
     if(sample_nibble & 4) delta = step * 4;
@@ -161,88 +105,46 @@ static void otns_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset,
     if(sample_nibble & 1) delta += step;
     delta >>= 2;
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
 }
 
 /* Fairly OddParents (PC) .WV6: minor variation, reverse engineered from the .exe */
-static void wv6_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-    step = ADPCMTable[*step_index];
+static int wv6_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     delta = (sample_nibble & 0x7);
     delta = ((delta * step) >> 3) + ((delta * step) >> 2);
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
 }
 
 /* Lego Racers (PC) .TUN variation, reverse engineered from the .exe */
-static void alp_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf;
-    sample_decoded = *hist1;
-    step = ADPCMTable[*step_index];
+static int alp_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     delta = (sample_nibble & 0x7);
     delta = (delta * step) >> 2;
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    *hist1 = clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
 }
 
 /* FFTA2 IMA, different hist and sample rounding, reverse engineered from the ROM */
-static void ffta2_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index, int16_t *out_sample) {
-    int sample_nibble, sample_decoded, step, delta;
+static int ffta2_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf; /* ADPCM code */
-    sample_decoded = *hist1; /* predictor value */
-    step = ADPCMTable[*step_index] * 0x100; /* current step (table in ROM is pre-multiplied though) */
+    step = step * 0x100; /* current step (table in ROM is pre-multiplied though) */
 
     delta = step >> 3;
     if (sample_nibble & 1) delta += step >> 2;
     if (sample_nibble & 2) delta += step >> 1;
     if (sample_nibble & 4) delta += step;
     if (sample_nibble & 8) delta = -delta;
-    sample_decoded += delta;
-
-    /* custom clamp16 */
-    if (sample_decoded > 0x7FFF00)
-        sample_decoded = 0x7FFF00;
-    else if (sample_decoded < -0x800000)
-        sample_decoded = -0x800000;
-
-    *hist1 = sample_decoded;
-    *out_sample = (short)((sample_decoded + 128) / 256); /* int16 sample rounding, hist is kept as int32 */
-
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
 }
 
 /* Yet another IMA expansion, from the exe */
-static void blitz_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset, int nibble_shift, int32_t * hist1, int32_t * step_index) {
-    int sample_nibble, sample_decoded, step, delta;
-
-    sample_nibble = (read_8bit(byte_offset,stream->streamfile) >> nibble_shift)&0xf; /* ADPCM code */
-    sample_decoded = *hist1; /* predictor value */
-    step = ADPCMTable[*step_index]; /* current step */
+static int blitz_ima_get_delta(int step, int sample_nibble) {
+    int delta;
 
     /* table has 2 different values, not enough to bother adding the full table */
     if (step == 22385)
@@ -253,14 +155,179 @@ static void blitz_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset
     delta = (sample_nibble & 0x07);
     if (sample_nibble & 8) delta = -delta;
     delta = (step >> 1) + delta * step; /* custom */
-    sample_decoded += delta;
-
-    /* in Zapper somehow the exe tries to clamp hist but actually doesn't (bug? not in Lilo & Stitch),
-     * seems the pcm buffer must be clamped outside though to fix some scratchiness */
-    *hist1 = sample_decoded;//clamp16(sample_decoded);
-    *step_index += IMA_IndexTable[sample_nibble];
-    if (*step_index < 0) *step_index=0;
-    if (*step_index > 88) *step_index=88;
+    return delta;
+}
+
+
+/* Tables of [step_index][nibble] = delta * 128 + next step_index (deltas fit in 24 bits) */
+static int32_t ima_table_std[89*16];
+static int32_t ima_table_mul[89*16];
+static int32_t ima_table_n3ds[89*16];
+static int32_t ima_table_snds[89*16];
+static int32_t ima_table_otns[89*16];
+static int32_t ima_table_wv6[89*16];
+static int32_t ima_table_alp[89*16];
+static int32_t ima_table_ffta2[89*16];
+static int32_t ima_table_blitz[89*16];
+
+static void build_ima_table(int32_t * table, int (*get_delta)(int step, int sample_nibble), int is_index_first) {
+    int step_index, sample_nibble;
+
+    for (step_index = 0; step_index <= 88; step_index++) {
+        for (sample_nibble = 0; sample_nibble < 16; sample_nibble++) {
+            int next_index = step_index + IMA_IndexTable[sample_nibble];
+            if (next_index < 0) next_index = 0;
+            if (next_index > 88) next_index = 88;
+
+            table[step_index*16 + sample_nibble] =
+                    get_delta(ADPCMTable[is_index_first ? next_index : step_index], sample_nibble) * 128 + next_index;
+        }
+    }
+}
+
+static void build_ima_tables(void) {
+    build_ima_table(ima_table_std,   std_ima_get_delta, 0);
+    build_ima_table(ima_table_mul,   mul_ima_get_delta, 0);
+    build_ima_table(ima_table_n3ds,  n3ds_ima_get_delta, 0);
+    build_ima_table(ima_table_snds,  snds_ima_get_delta, 1);
+    build_ima_table(ima_table_otns,  otns_ima_get_delta, 0);
+    build_ima_table(ima_table_wv6,   wv6_ima_get_delta, 0);
+    build_ima_table(ima_table_alp,   alp_ima_get_delta, 0);
+    build_ima_table(ima_table_ffta2, ffta2_ima_get_delta, 0);
+    build_ima_table(ima_table_blitz, blitz_ima_get_delta, 0);
+}
+
+#ifdef VGM_USE_THREADS
+static pthread_once_t ima_tables_once = PTHREAD_ONCE_INIT;
+#define IMA_TABLES_INIT()   pthread_once(&ima_tables_once, build_ima_tables)
+#else
+static int ima_tables_ready = 0;
+#define IMA_TABLES_INIT()   do { if (!ima_tables_ready) { build_ima_tables(); ima_tables_ready = 1; } } while (0)
+#endif
+
+
+/* Decodes count nibbles from first_nibble of data, with 2 nibbles per byte (packed) or 1 per byte
+ * (interleaved stereo), low or high nibble first. Each variant gets its own copy of the loop with
+ * its table and history handling, writing the output sample from hist1. */
+typedef void (*ima_decode_t)(const uint8_t * data, int first_nibble, int count, int packed, int high_first,
+        sample_t * outbuf, int channelspacing, int32_t * hist1, int * step_index);
+
+#define IMA_DECODE_FUNCTION(name, table, update) \
+    static void name(const uint8_t * data, int first_nibble, int count, int packed, int high_first, \
+            sample_t * outbuf, int channelspacing, int32_t * hist1_ptr, int * step_index_ptr) { \
+        int32_t hist1 = *hist1_ptr; \
+        int step_index = *step_index_ptr; \
+        int i, sample_count = 0; \
+        for (i = first_nibble; i < first_nibble + count; i++) { \
+            int sample_nibble = (data[i >> packed] >> ((((i & packed) ^ high_first) & 1) << 2)) & 0x0f; \
+            int32_t entry = table[step_index*16 + sample_nibble]; \
+            int32_t sample; \
+            step_index = entry & 0x7f; \
+            hist1 += entry >> 7; \
+            update; \
+            outbuf[sample_count] = sample; \
+            sample_count += channelspacing; \
+        } \
+        *hist1_ptr = hist1; \
+        *step_index_ptr = step_index; \
+    }
+
+IMA_DECODE_FUNCTION(std_ima_decode,   ima_table_std,   hist1 = clamp16(hist1); sample = hist1)
+IMA_DECODE_FUNCTION(mul_ima_decode,   ima_table_mul,   hist1 = clamp16(hist1); sample = hist1)
+IMA_DECODE_FUNCTION(n3ds_ima_decode,  ima_table_n3ds,  hist1 = clamp16(hist1); sample = hist1)
+IMA_DECODE_FUNCTION(snds_ima_decode,  ima_table_snds,  hist1 = clamp16(hist1); sample = hist1)
+IMA_DECODE_FUNCTION(otns_ima_decode,  ima_table_otns,  hist1 = clamp16(hist1); sample = hist1)
+IMA_DECODE_FUNCTION(wv6_ima_decode,   ima_table_wv6,   hist1 = clamp16(hist1); sample = hist1)
+IMA_DECODE_FUNCTION(alp_ima_decode,   ima_table_alp,   hist1 = clamp16(hist1); sample = hist1)
+/* custom clamp16, hist is kept as int32 and the int16 sample is rounded */
+IMA_DECODE_FUNCTION(ffta2_ima_decode, ima_table_ffta2,
+        if (hist1 > 0x7FFF00) hist1 = 0x7FFF00; else if (hist1 < -0x800000) hist1 = -0x800000;
+        sample = (short)((hist1 + 128) / 256))
+/* in Zapper somehow the exe tries to clamp hist but actually doesn't (bug? not in Lilo & Stitch),
+ * seems the pcm buffer must be clamped outside though to fix some scratchiness */
+IMA_DECODE_FUNCTION(blitz_ima_decode, ima_table_blitz, sample = clamp16(hist1))
+
+
+#define IMA_WINDOW_SIZE 0x200
+
+/* Decodes count nibbles from first_nibble of a run of bytes at offset (see above), fetched in windows.
+ * Samples are decoded but not written if outbuf is NULL (for decoders that must start from the frame start). */
+static void decode_ima_run(STREAMFILE * sf, off_t offset, ima_decode_t decode, int first_nibble, int count, int packed, int high_first,
+        sample_t * outbuf, int channelspacing, int32_t * hist1, int * step_index) {
+    uint8_t buf[IMA_WINDOW_SIZE];
+    sample_t discard[IMA_WINDOW_SIZE*2];
+    const uint8_t * data;
+
+    while (count > 0) {
+        int byte_start = first_nibble >> packed;
+        int nibble = first_nibble - (byte_start << packed);
+        int todo = (IMA_WINDOW_SIZE << packed) - nibble;
+        if (todo > count)
+            todo = count;
+
+        data = peek_streamfile(buf, offset + byte_start, ((nibble + todo - 1) >> packed) + 1, sf);
+        if (outbuf) {
+            decode(data, nibble, todo, packed, high_first, outbuf, channelspacing, hist1, step_index);
+            outbuf += todo * channelspacing;
+        }
+        else {
+            decode(data, nibble, todo, packed, high_first, discard, 1, hist1, step_index);
+        }
+
+        first_nibble += todo;
+        count -= todo;
+    }
+}
+
+/* Decodes count packed nibbles (low first) from first_nibble of data stored in groups of group_size bytes
+ * every group_stride bytes (channels interleaved in small chunks), data being the first group. */
+static void decode_ima_groups_data(const uint8_t * data, ima_decode_t decode, int group_size, int group_stride, int first_nibble, int count,
+        sample_t * outbuf, int channelspacing, int32_t * hist1, int * step_index) {
+    int group_nibbles = group_size * 2;
+
+    while (count > 0) {
+        int group = first_nibble / group_nibbles;
+        int nibble = first_nibble % group_nibbles;
+        int todo = group_nibbles - nibble;
+        if (todo > count)
+            todo = count;
+
+        decode(data + group*group_stride, nibble, todo, 1, 0, outbuf, channelspacing, hist1, step_index);
+        outbuf += todo * channelspacing;
+
+        first_nibble += todo;
+        count -= todo;
+    }
+}
+
+/* same, with groups at offset, fetched in windows (see decode_ima_run) */
+static void decode_ima_groups(STREAMFILE * sf, off_t offset, ima_decode_t decode, int group_size, int group_stride, int first_nibble, int count,
+        sample_t * outbuf, int channelspacing, int32_t * hist1, int * step_index) {
+    uint8_t buf[IMA_WINDOW_SIZE];
+    sample_t discard[IMA_WINDOW_SIZE*2];
+    int group_nibbles = group_size * 2;
+    int window_groups = group_stride > IMA_WINDOW_SIZE - group_size ? 1 : (IMA_WINDOW_SIZE - group_size) / group_stride + 1;
+    const uint8_t * data;
+
+    while (count > 0) {
+        int group = first_nibble / group_nibbles;
+        int nibble = first_nibble % group_nibbles;
+        int todo = window_groups * group_nibbles - nibble;
+        if (todo > count)
+            todo = count;
+
+        data = peek_streamfile(buf, offset + group*group_stride, ((nibble + todo - 1) / group_nibbles) * group_stride + group_size, sf);
+        if (outbuf) {
+            decode_ima_groups_data(data, decode, group_size, group_stride, nibble, todo, outbuf, channelspacing, hist1, step_index);
+            outbuf += todo * channelspacing;
+        }
+        else {
+            decode_ima_groups_data(data, decode, group_size, group_stride, nibble, todo, discard, 1, hist1, step_index);
+        }
+
+        first_nibble += todo;
+        count -= todo;
+    }
 }
 
 /* ************************************ */
@@ -271,9 +338,13 @@ static void blitz_ima_expand_nibble(VGMSTREAMCHANNEL * stream, off_t byte_offset
  * Configurable: stereo or mono/interleave nibbles, and high or low nibble first.
  * For vgmstream, low nibble is called "IMA ADPCM" and high nibble is "DVI IMA ADPCM" (same thing though). */
 void decode_standard_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo, int is_high_first) {
-    int i, sample_count = 0;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
+    int high_first = is_stereo ?
+            (is_high_first ? !(channel&1) : (channel&1)) : /* stereo: one nibble per channel (even = high or low) */
+            is_high_first; /* mono: consecutive nibbles */
+
+    IMA_TABLES_INIT();
 
     /* external interleave */
 
@@ -281,83 +352,64 @@ void decode_standard_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
     if (step_index < 0) step_index=0;
     if (step_index > 88) step_index=88;
 
-    /* decode nibbles (layout: varies) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++, sample_count += channelspacing) {
-        off_t byte_offset = is_stereo ?
-                stream->offset + i :    /* stereo: one nibble per channel */
-                stream->offset + i/2;   /* mono: consecutive nibbles */
-        int nibble_shift = is_high_first ?
-                is_stereo ? (!(channel&1) ? 4:0) : (!(i&1) ? 4:0) : /* even = high, odd = low */
-                is_stereo ? (!(channel&1) ? 0:4) : (!(i&1) ? 0:4);  /* even = low, odd = high */
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    /* decode nibbles (layout: varies), fetching data in windows as there is no frame size */
+    decode_ima_run(stream->streamfile, stream->offset, std_ima_decode, first_sample, samples_to_do, !is_stereo, high_first,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
 void decode_3ds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //external interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + i/2;
-        int nibble_shift = (i&1?4:0); //low nibble order
-
-        n3ds_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //low nibble order
+    decode_ima_run(stream->streamfile, stream->offset, n3ds_ima_decode, first_sample, samples_to_do, 1, 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
 void decode_snds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //external interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + i;//one nibble per channel
-        int nibble_shift = (channel==0?0:4); //high nibble first, based on channel
-
-        snds_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //one nibble per channel, high nibble first based on channel
+    decode_ima_run(stream->streamfile, stream->offset, snds_ima_decode, first_sample, samples_to_do, 0, channel != 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
 void decode_otns_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //internal/byte interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + (vgmstream->channels==1 ? i/2 : i); //one nibble per channel if stereo
-        int nibble_shift = (vgmstream->channels==1) ? //todo simplify
-                    (i&1?0:4) : //high nibble first(?)
-                    (channel==0?4:0); //low=ch0, high=ch1 (this is correct compared to vids)
-
-        otns_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //mono: high nibble first(?), stereo: one nibble per channel, low=ch0, high=ch1 (this is correct compared to vids)
+    decode_ima_run(stream->streamfile, stream->offset, otns_ima_decode, first_sample, samples_to_do,
+            vgmstream->channels == 1, vgmstream->channels == 1 ? 1 : channel == 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -365,21 +417,18 @@ void decode_otns_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t
 
 /* WV6 IMA, DVI IMA with custom nibble expand */
 void decode_wv6_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //external interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + i/2;
-        int nibble_shift = (i&1?0:4); //high nibble first
-
-        wv6_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //high nibble first
+    decode_ima_run(stream->streamfile, stream->offset, wv6_ima_decode, first_sample, samples_to_do, 1, 1,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -387,21 +436,18 @@ void decode_wv6_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
 
 /* ALT IMA, DVI IMA with custom nibble expand */
 void decode_alp_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //external interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + i/2;
-        int nibble_shift = (i&1?0:4); //high nibble first
-
-        alp_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //high nibble first
+    decode_ima_run(stream->streamfile, stream->offset, alp_ima_decode, first_sample, samples_to_do, 1, 1,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -409,22 +455,18 @@ void decode_alp_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
 
 /* FFTA2 IMA, DVI IMA with custom nibble expand/rounding */
 void decode_ffta2_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
-    int16_t out_sample;
+
+    IMA_TABLES_INIT();
 
     //external interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + i/2;
-        int nibble_shift = (i&1?0:4); //high nibble first
-
-        ffta2_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index, &out_sample);
-        outbuf[sample_count] = out_sample;
-    }
+    //high nibble first
+    decode_ima_run(stream->streamfile, stream->offset, ffta2_ima_decode, first_sample, samples_to_do, 1, 1,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -432,21 +474,18 @@ void decode_ffta2_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels
 
 /* Blitz IMA, IMA with custom nibble expand */
 void decode_blitz_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //external interleave
 
     //no header
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + i/2;
-        int nibble_shift = (i&1?4:0); //low nibble first
-
-        blitz_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)clamp16(hist1);
-    }
+    //low nibble first
+    decode_ima_run(stream->streamfile, stream->offset, blitz_ima_decode, first_sample, samples_to_do, 1, 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -460,20 +499,24 @@ void decode_blitz_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channels
  * so to simplify calcs this decodes full frames, thus hist doesn't need to be mantained.
  * Officially defined in "Microsoft Multimedia Standards Update" doc (RIFFNEW.pdf). */
 void decode_ms_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, samples_read = 0, samples_done = 0, max_samples;
+    int samples_read = 0, samples_done = 0, max_samples, skip_samples;
     int32_t hist1;// = stream->adpcm_history1_32;
     int step_index;// = stream->adpcm_step_index;
+    uint8_t header_buf[0x04];
+    const uint8_t * header;
 
     /* internal interleave (configurable size), mixed channels */
     int block_samples = ((vgmstream->interleave_block_size - 0x04*vgmstream->channels) * 2 / vgmstream->channels) + 1;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     /* normal header (hist+step+reserved), per channel */
     { //if (first_sample == 0) {
-        off_t header_offset = stream->offset + 0x04*channel;
+        header = peek_streamfile(header_buf, stream->offset + 0x04*channel, 0x04, stream->streamfile);
 
-        hist1 =   read_16bitLE(header_offset+0x00,stream->streamfile);
-        step_index = read_8bit(header_offset+0x02,stream->streamfile); /* 0x03: reserved */
+        hist1 = get_16bitLE(header+0x00);
+        step_index = (int8_t)header[0x02]; /* 0x03: reserved */
         if (step_index < 0) step_index = 0;
         if (step_index > 88) step_index = 88;
 
@@ -489,18 +532,22 @@ void decode_ms_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
     if (max_samples > samples_to_do + first_sample - samples_done)
         max_samples = samples_to_do + first_sample - samples_done; /* for smaller last block */
 
-    /* decode nibbles (layout: alternates 4 bytes/4*2 nibbles per channel) */
-    for (i = 0; i < max_samples; i++) {
-        off_t byte_offset = stream->offset + 0x04*vgmstream->channels + 0x04*channel + 0x04*vgmstream->channels*(i/8) + (i%8)/2;
-        int nibble_shift = (i&1?4:0); /* low nibble first */
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index); /* original expand */
-
-        if (samples_read >= first_sample && samples_done < samples_to_do) {
-            outbuf[samples_done * channelspacing] = (short)(hist1);
-            samples_done++;
-        }
-        samples_read++;
+    /* decode nibbles (layout: alternates 4 bytes/4*2 nibbles per channel), from the start to get hist */
+    skip_samples = first_sample > samples_read ? first_sample - samples_read : 0;
+    if (skip_samples > max_samples)
+        skip_samples = max_samples;
+    if (max_samples > skip_samples + samples_to_do - samples_done)
+        max_samples = skip_samples + samples_to_do - samples_done;
+
+    {
+        off_t data_offset = stream->offset + 0x04*vgmstream->channels + 0x04*channel;
+        size_t group_stride = 0x04*vgmstream->channels;
+
+        decode_ima_groups(stream->streamfile, data_offset, std_ima_decode, 0x04, group_stride, 0, skip_samples,
+                NULL, 1, &hist1, &step_index); /* original expand */
+        decode_ima_groups(stream->streamfile, data_offset, std_ima_decode, 0x04, group_stride, skip_samples, max_samples - skip_samples,
+                outbuf + samples_done * channelspacing, channelspacing, &hist1, &step_index);
+        samples_done += max_samples - skip_samples;
     }
 
     /* internal interleave: increment offset on complete frame */
@@ -514,21 +561,25 @@ void decode_ms_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
 
 /* Reflection's MS-IMA with custom nibble layout (some info from XA2WAV by Deniz Oezmen) */
 void decode_ref_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, samples_read = 0, samples_done = 0, max_samples;
+    int samples_read = 0, samples_done = 0, max_samples, skip_samples;
     int32_t hist1;// = stream->adpcm_history1_32;
     int step_index;// = stream->adpcm_step_index;
+    uint8_t header_buf[0x04];
+    const uint8_t * header;
 
     /* internal interleave (configurable size), mixed channels */
     int block_channel_size = (vgmstream->interleave_block_size - 0x04*vgmstream->channels) / vgmstream->channels;
     int block_samples = ((vgmstream->interleave_block_size - 0x04*vgmstream->channels) * 2 / vgmstream->channels) + 1;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     /* normal header (hist+step+reserved), per channel */
     { //if (first_sample == 0) {
-        off_t header_offset = stream->offset + 0x04*channel;
+        header = peek_streamfile(header_buf, stream->offset + 0x04*channel, 0x04, stream->streamfile);
 
-        hist1 =   read_16bitLE(header_offset+0x00,stream->streamfile);
-        step_index = read_8bit(header_offset+0x02,stream->streamfile);
+        hist1 = get_16bitLE(header+0x00);
+        step_index = (int8_t)header[0x02];
         if (step_index < 0) step_index = 0;
         if (step_index > 88) step_index = 88;
 
@@ -544,18 +595,21 @@ void decode_ref_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
     if (max_samples > samples_to_do + first_sample - samples_done)
         max_samples = samples_to_do + first_sample - samples_done; /* for smaller last block */
 
-    /* decode nibbles (layout: all nibbles from one channel, then other channels) */
-    for (i = 0; i < max_samples; i++) {
-        off_t byte_offset = stream->offset + 0x04*vgmstream->channels + block_channel_size*channel + i/2;
-        int nibble_shift = (i&1?4:0); /* low nibble first */
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-
-        if (samples_read >= first_sample && samples_done < samples_to_do) {
-            outbuf[samples_done * channelspacing] = (short)(hist1);
-            samples_done++;
-        }
-        samples_read++;
+    /* decode nibbles (layout: all nibbles from one channel, then other channels), from the start to get hist */
+    skip_samples = first_sample > samples_read ? first_sample - samples_read : 0;
+    if (skip_samples > max_samples)
+        skip_samples = max_samples;
+    if (max_samples > skip_samples + samples_to_do - samples_done)
+        max_samples = skip_samples + samples_to_do - samples_done;
+
+    {
+        off_t data_offset = stream->offset + 0x04*vgmstream->channels + block_channel_size*channel;
+
+        decode_ima_run(stream->streamfile, data_offset, std_ima_decode, 0, skip_samples, 1, 0,
+                NULL, 1, &hist1, &step_index);
+        decode_ima_run(stream->streamfile, data_offset, std_ima_decode, skip_samples, max_samples - skip_samples, 1, 0,
+                outbuf + samples_done * channelspacing, channelspacing, &hist1, &step_index);
+        samples_done += max_samples - skip_samples;
     }
 
     /* internal interleave: increment offset on complete frame */
@@ -574,10 +628,14 @@ void decode_ref_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
 /* MS-IMA with fixed frame size, and outputs an even number of samples per frame (skips last nibble).
  * Defined in Xbox's SDK. Usable in mono or stereo modes (both suitable for interleaved multichannel). */
 void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, int is_stereo) {
-    int i, frames_in, sample_pos = 0, block_samples, frame_size;
+    int frames_in, sample_pos = 0, block_samples, frame_size, nibbles;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
     off_t frame_offset;
+    uint8_t frame_buf[0x24*2];
+    const uint8_t * frame;
+
+    IMA_TABLES_INIT();
 
     /* external interleave (fixed size), stereo/mono */
     block_samples = (0x24 - 0x4) * 2;
@@ -586,15 +644,16 @@ void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
     frame_size = is_stereo ? 0x24*2 : 0x24;
 
     frame_offset = stream->offset + frame_size*frames_in;
+    frame = peek_streamfile(frame_buf, frame_offset, frame_size, stream->streamfile); /* ignore EOF errors */
 
     /* normal header (hist+step+reserved), stereo/mono */
     if (first_sample == 0) {
-        off_t header_offset = is_stereo ?
-                frame_offset + 0x04*(channel % 2) :
-                frame_offset + 0x00;
+        int header_pos = is_stereo ?
+                0x04*(channel % 2) :
+                0x00;
 
-        hist1   = read_16bitLE(header_offset+0x00,stream->streamfile);
-        step_index = read_8bit(header_offset+0x02,stream->streamfile);
+        hist1   = get_16bitLE(frame + header_pos+0x00);
+        step_index = (int8_t)frame[header_pos+0x02];
         if (step_index < 0) step_index=0;
         if (step_index > 88) step_index=88;
 
@@ -605,19 +664,19 @@ void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
         samples_to_do -= 1;
     }
 
-    /* decode nibbles (layout: straight in mono or 4 bytes per channel in stereo) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = is_stereo ?
-                frame_offset + 0x04*2 + 0x04*(channel % 2) + 0x04*2*((i-1)/8) + ((i-1)%8)/2 :
-                frame_offset + 0x04   + (i-1)/2;
-        int nibble_shift = (!((i-1)&1)   ? 0:4);   /* low first */
-
-        /* must skip last nibble per spec, rarely needed though (ex. Gauntlet Dark Legacy) */
-        if (i < block_samples) {
-            std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-            outbuf[sample_pos] = (short)(hist1);
-            sample_pos += channelspacing;
-        }
+    /* must skip last nibble per spec, rarely needed though (ex. Gauntlet Dark Legacy) */
+    nibbles = samples_to_do;
+    if (first_sample + nibbles > block_samples)
+        nibbles = block_samples - first_sample;
+
+    /* decode nibbles (layout: straight in mono or 4 bytes per channel in stereo, low first) */
+    if (is_stereo) {
+        decode_ima_groups_data(frame + 0x04*2 + 0x04*(channel % 2), std_ima_decode, 0x04, 0x04*2, first_sample - 1, nibbles,
+                outbuf + sample_pos, channelspacing, &hist1, &step_index);
+    }
+    else if (nibbles > 0) {
+        std_ima_decode(frame + 0x04, first_sample - 1, nibbles, 1, 0,
+                outbuf + sample_pos, channelspacing, &hist1, &step_index);
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -626,21 +685,26 @@ void decode_xbox_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
 
 /* Multichannel XBOX-IMA ADPCM, with all channels mixed in the same block (equivalent to multichannel MS-IMA; seen in .rsd XADP). */
 void decode_xbox_ima_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, sample_count = 0, num_frame;
+    int sample_count = 0, num_frame, nibbles;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
+    off_t frame_offset;
 
     /* external interleave (fixed size), multichannel */
     int block_samples = (0x24 - 0x4) * 2;
     num_frame = first_sample / block_samples;
     first_sample = first_sample % block_samples;
+    frame_offset = stream->offset + 0x24*channelspacing*num_frame;
+
+    IMA_TABLES_INIT();
 
     /* normal header (hist+step+reserved), multichannel */
     if (first_sample == 0) {
-        off_t header_offset = stream->offset + 0x24*channelspacing*num_frame + 0x04*channel;
+        uint8_t header_buf[0x04];
+        const uint8_t * header = peek_streamfile(header_buf, frame_offset + 0x04*channel, 0x04, stream->streamfile);
 
-        hist1   = read_16bitLE(header_offset+0x00,stream->streamfile);
-        step_index = read_8bit(header_offset+0x02,stream->streamfile);
+        hist1   = get_16bitLE(header+0x00);
+        step_index = (int8_t)header[0x02];
         if (step_index < 0) step_index=0;
         if (step_index > 88) step_index=88;
 
@@ -651,18 +715,14 @@ void decode_xbox_ima_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
         samples_to_do -= 1;
     }
 
-    /* decode nibbles (layout: alternates 4 bytes/4*2 nibbles per channel) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = (stream->offset + 0x24*channelspacing*num_frame + 0x04*channelspacing) + 0x04*channel + 0x04*channelspacing*((i-1)/8) + ((i-1)%8)/2;
-        int nibble_shift = ((i-1)&1?4:0); /* low nibble first */
+    /* must skip last nibble per spec, rarely needed though */
+    nibbles = samples_to_do;
+    if (first_sample + nibbles > block_samples)
+        nibbles = block_samples - first_sample;
 
-        /* must skip last nibble per spec, rarely needed though */
-        if (i < block_samples) {
-            std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-            outbuf[sample_count] = (short)(hist1);
-            sample_count += channelspacing;
-        }
-    }
+    /* decode nibbles (layout: alternates 4 bytes/4*2 nibbles per channel, low nibble first) */
+    decode_ima_groups(stream->streamfile, frame_offset + 0x04*channelspacing + 0x04*channel, std_ima_decode, 0x04, 0x04*channelspacing,
+            first_sample - 1, nibbles, outbuf + sample_count, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -672,10 +732,11 @@ void decode_xbox_ima_mch(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
  * Apparently clamps to -32767 unlike standard's -32768 (probably not noticeable).
  * Info here: http://problemkaputt.de/gbatek.htm#dssoundnotes */
 void decode_nds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     /* external interleave (configurable size), mono */
 
     /* normal header (hist+step+reserved), single channel */
@@ -688,25 +749,21 @@ void decode_nds_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
         if (step_index > 88) step_index=88;
     }
 
-    /* decode nibbles (layout: all nibbles from the channel) */
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + 0x04 + i/2;
-        int nibble_shift = (i&1?4:0); /* low nibble first */
-
-        //todo waveform has minor deviations using known expands
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    /* decode nibbles (layout: all nibbles from the channel, low nibble first) */
+    //todo waveform has minor deviations using known expands
+    decode_ima_run(stream->streamfile, stream->offset + 0x04, std_ima_decode, first_sample, samples_to_do, 1, 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
 void decode_dat4_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_16;//todo unneeded 16?
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //external interleave
 
     //normal header
@@ -715,24 +772,19 @@ void decode_dat4_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelsp
 
         hist1 = read_16bitLE(header_offset,stream->streamfile);
         step_index = read_8bit(header_offset+2,stream->streamfile);
-
-        //todo clip step_index?
     }
+    if (step_index < 0) step_index=0; /* table lookups need a valid index */
+    if (step_index > 88) step_index=88;
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + 4 + i/2;
-        int nibble_shift = (i&1?0:4); //high nibble first
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //high nibble first
+    decode_ima_run(stream->streamfile, stream->offset + 4, std_ima_decode, first_sample, samples_to_do, 1, 1,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_16 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
 void decode_rad_ima(VGMSTREAM * vgmstream,VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do,int channel) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
@@ -740,6 +792,8 @@ void decode_rad_ima(VGMSTREAM * vgmstream,VGMSTREAMCHANNEL * stream, sample_t *
     int block_samples = (vgmstream->interleave_block_size - 4*vgmstream->channels) * 2 / vgmstream->channels;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     //inverted header (per channel)
     if (first_sample == 0) {
         off_t header_offset = stream->offset + 4*channel;
@@ -750,23 +804,18 @@ void decode_rad_ima(VGMSTREAM * vgmstream,VGMSTREAMCHANNEL * stream, sample_t *
         if (step_index > 88) step_index=88;
     }
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + 4*vgmstream->channels + channel + i/2*vgmstream->channels;
-        int nibble_shift = (i&1?4:0); //low nibble first
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //one byte per channel, low nibble first
+    decode_ima_groups(stream->streamfile, stream->offset + 4*vgmstream->channels + channel, std_ima_decode, 0x01, vgmstream->channels,
+            first_sample, samples_to_do, outbuf, channelspacing, &hist1, &step_index);
 
     //internal interleave: increment offset on complete frame
-    if (i == block_samples) stream->offset += vgmstream->interleave_block_size;
+    if (first_sample + samples_to_do == block_samples) stream->offset += vgmstream->interleave_block_size;
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
 void decode_rad_ima_mono(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
@@ -774,6 +823,8 @@ void decode_rad_ima_mono(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
     int block_samples = 0x14 * 2;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     //inverted header
     if (first_sample == 0) {
         off_t header_offset = stream->offset;
@@ -784,46 +835,43 @@ void decode_rad_ima_mono(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int chann
         if (step_index > 88) step_index=88;
     }
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + 4 + i/2;
-        int nibble_shift = (i&1?4:0); //low nibble first
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //low nibble first
+    decode_ima_run(stream->streamfile, stream->offset + 4, std_ima_decode, first_sample, samples_to_do, 1, 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
-/* Apple's IMA4, a.k.a QuickTime IMA. 2 byte header and header sample is not written (setup only). */
+/* Apple's IMA4, a.k.a QuickTime IMA. 2 byte header and header sample is not written (setup only).
+ * Uses 16b history, same as standard IMA's clamped one. */
 void decode_apple_ima4(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count, num_frame;
-    int16_t hist1 = stream->adpcm_history1_16;//todo unneeded 16?
+    int num_frame;
+    int32_t hist1 = stream->adpcm_history1_16;//todo unneeded 16?
     int step_index = stream->adpcm_step_index;
+    uint8_t frame_buf[0x22];
+    const uint8_t * frame;
+
+    IMA_TABLES_INIT();
 
     //external interleave
     int block_samples = (0x22 - 0x2) * 2;
     num_frame = first_sample / block_samples;
     first_sample = first_sample % block_samples;
 
+    frame = peek_streamfile(frame_buf, stream->offset + 0x22*num_frame, 0x22, stream->streamfile); //ignore EOF errors
+
     //2-byte header
     if (first_sample == 0) {
-        off_t header_offset = stream->offset + 0x22*num_frame;
-
-        hist1 = (int16_t)((uint16_t)read_16bitBE(header_offset,stream->streamfile) & 0xff80);
-        step_index = read_8bit(header_offset+1,stream->streamfile) & 0x7f;
+        hist1 = (int16_t)((uint16_t)get_16bitBE(frame) & 0xff80);
+        step_index = frame[0x01] & 0x7f;
         if (step_index < 0) step_index=0;
         if (step_index > 88) step_index=88;
     }
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = (stream->offset + 0x22*num_frame + 0x2) + i/2;
-        int nibble_shift = (i&1?4:0); //low nibble first
-
-        std_ima_expand_nibble_16(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //low nibble first
+    std_ima_decode(frame + 0x02, first_sample, samples_to_do, 1, 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_16 = hist1;
     stream->adpcm_step_index = step_index;
@@ -831,7 +879,7 @@ void decode_apple_ima4(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channel
 
 /* XBOX-IMA with modified data layout */
 void decode_fsb_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do,int channel) {
-    int i, sample_count = 0;
+    int sample_count = 0, nibbles;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
@@ -839,6 +887,8 @@ void decode_fsb_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
     int block_samples = (0x24 - 0x4) * 2;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     /* interleaved header (all hist per channel + all step_index+reserved per channel) */
     if (first_sample == 0) {
         off_t hist_offset = stream->offset + 0x02*channel + 0x00;
@@ -856,21 +906,17 @@ void decode_fsb_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
         samples_to_do -= 1;
     }
 
-    /* decode nibbles (layout: 2 bytes/2*2 nibbles per channel) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = stream->offset + 0x04*vgmstream->channels + 0x02*channel + (i-1)/4*2*vgmstream->channels + ((i-1)%4)/2;
-        int nibble_shift = ((i-1)&1?4:0); /* low nibble first */
+    /* must skip last nibble per official decoder, probably not needed though */
+    nibbles = samples_to_do;
+    if (first_sample + nibbles > block_samples)
+        nibbles = block_samples - first_sample;
 
-        /* must skip last nibble per official decoder, probably not needed though */
-        if (i < block_samples) {
-            std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-            outbuf[sample_count] = (short)(hist1);
-            sample_count += channelspacing;
-        }
-    }
+    /* decode nibbles (layout: 2 bytes/2*2 nibbles per channel, low nibble first) */
+    decode_ima_groups(stream->streamfile, stream->offset + 0x04*vgmstream->channels + 0x02*channel, std_ima_decode, 0x02, 0x02*vgmstream->channels,
+            first_sample - 1, nibbles, outbuf + sample_count, channelspacing, &hist1, &step_index);
 
     /* internal interleave: increment offset on complete frame */
-    if (i == block_samples) {
+    if (first_sample + samples_to_do == block_samples) {
         stream->offset += 0x24*vgmstream->channels;
     }
 
@@ -880,7 +926,7 @@ void decode_fsb_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t *
 
 /* mono XBOX-IMA with header endianness and alt nibble expand (per hcs's decompilation) */
 void decode_wwise_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) {
-    int i, sample_count = 0, num_frame;
+    int sample_count = 0, num_frame, nibbles;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
@@ -889,6 +935,8 @@ void decode_wwise_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t
     num_frame = first_sample / block_samples;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     /* normal header (hist+step+reserved), single channel */
     if (first_sample == 0) {
         int16_t (*read_16bit)(off_t,STREAMFILE*) = vgmstream->codec_endian ? read_16bitBE : read_16bitLE;
@@ -906,18 +954,14 @@ void decode_wwise_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t
         samples_to_do -= 1;
     }
 
-    /* decode nibbles (layout: all nibbles from one channel) */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = (stream->offset + 0x24*num_frame + 0x4) + (i-1)/2;
-        int nibble_shift = ((i-1)&1?4:0); /* low nibble first */
+    /* must skip last nibble like other XBOX-IMAs, often needed (ex. Bayonetta 2 sfx) */
+    nibbles = samples_to_do;
+    if (first_sample + nibbles > block_samples)
+        nibbles = block_samples - first_sample;
 
-        /* must skip last nibble like other XBOX-IMAs, often needed (ex. Bayonetta 2 sfx) */
-        if (i < block_samples) {
-            std_ima_expand_nibble_mul(stream, byte_offset,nibble_shift, &hist1, &step_index);
-            outbuf[sample_count] = (short)(hist1);
-            sample_count += channelspacing;
-        }
-    }
+    /* decode nibbles (layout: all nibbles from one channel, low nibble first) */
+    decode_ima_run(stream->streamfile, stream->offset + 0x24*num_frame + 0x4, mul_ima_decode, first_sample - 1, nibbles, 1, 0,
+            outbuf + sample_count, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -936,8 +980,6 @@ void decode_wwise_ima(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t
 
 /* MS-IMA with possibly the XBOX-IMA model of even number of samples per block (more tests are needed) */
 void decode_awc_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
-    int i, sample_count;
-
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
@@ -945,6 +987,8 @@ void decode_awc_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
     int block_samples = (0x800 - 4) * 2;
     first_sample = first_sample % block_samples;
 
+    IMA_TABLES_INIT();
+
     //inverted header
     if (first_sample == 0) {
         off_t header_offset = stream->offset;
@@ -955,16 +999,12 @@ void decode_awc_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
         if (step_index > 88) step_index=88;
     }
 
-    for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        off_t byte_offset = stream->offset + 4 + i/2;
-        int nibble_shift = (i&1?4:0); //low nibble first
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1);
-    }
+    //low nibble first
+    decode_ima_run(stream->streamfile, stream->offset + 4, std_ima_decode, first_sample, samples_to_do, 1, 0,
+            outbuf, channelspacing, &hist1, &step_index);
 
     //internal interleave: increment offset on complete frame
-    if (i == block_samples) stream->offset += 0x800;
+    if (first_sample + samples_to_do == block_samples) stream->offset += 0x800;
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
@@ -978,6 +1018,8 @@ void decode_ubi_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
 
+    IMA_TABLES_INIT();
+
     //internal interleave
 
     //header in the beginning of the stream
@@ -1003,32 +1045,37 @@ void decode_ubi_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
         /* write PCM samples, must be written to match header's num_samples (hist mustn't) */
         max_samples_to_do = ((samples_to_do > header_samples) ? header_samples : samples_to_do);
         for (i = first_sample; i < max_samples_to_do; i++, sample_count += channelspacing) {
-            outbuf[sample_count] = read_16bit(offset + channel*sizeof(sample) + i*channelspacing*sizeof(sample),stream->streamfile);
+            outbuf[sample_count] = read_16bit(offset + channel*0x02 + i*channelspacing*0x02,stream->streamfile);
             first_sample++;
             samples_to_do--;
         }
 
         /* header done */
         if (i == header_samples) {
-            stream->offset = offset + header_samples*channelspacing*sizeof(sample);
+            stream->offset = offset + header_samples*channelspacing*0x02;
         }
     }
+    /* header's step is read as-is, so clamp bad values (would index past the expand table) */
+    if (step_index < 0) step_index=0;
+    if (step_index > 88) step_index=88;
 
 
     first_sample -= 10; //todo fix hack (needed to adjust nibble offset below)
 
-    for (i = first_sample; i < first_sample + samples_to_do; i++, sample_count += channelspacing) {
-        off_t byte_offset = channelspacing == 1 ?
-                stream->offset + i/2 :  /* mono mode */
-                stream->offset + i;     /* stereo mode */
-        int nibble_shift = channelspacing == 1 ?
-                (!(i%2) ? 4:0) :        /* mono mode (high first) */
-                (channel==0 ? 4:0);     /* stereo mode (high=L,low=R) */
+    /* partial header reads may leave a negative position, where nibbles went through C's rounding towards 0 */
+    for (; first_sample < 0 && samples_to_do > 0; first_sample++, samples_to_do--, sample_count += channelspacing) {
+        int byte_pos = channelspacing == 1 ? first_sample/2 : first_sample;
+        int high_first = channelspacing == 1 ? !(first_sample%2) : channel==0;
+        uint8_t byte = (uint8_t)read_8bit(stream->offset + byte_pos, stream->streamfile);
 
-        std_ima_expand_nibble_mul(stream, byte_offset,nibble_shift, &hist1, &step_index);
-        outbuf[sample_count] = (short)(hist1); /* all samples are written */
+        mul_ima_decode(&byte, 0, 1, 0, high_first, outbuf + sample_count, channelspacing, &hist1, &step_index);
     }
 
+    /* mono mode (high first) or stereo mode (one nibble per channel, high=L,low=R), all samples are written */
+    decode_ima_run(stream->streamfile, stream->offset, mul_ima_decode, first_sample, samples_to_do,
+            channelspacing == 1, channelspacing == 1 ? 1 : channel==0,
+            outbuf + sample_count, channelspacing, &hist1, &step_index);
+
     //external interleave
 
     stream->adpcm_history1_32 = hist1;
@@ -1039,12 +1086,14 @@ void decode_ubi_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
  * tables mapping all standard IMA combinations (to optimize calculations), but decodes the same.
  * Based on HCS's and Nisto's reverse engineering in h4m_audio_decode. */
 void decode_h4m_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel, uint16_t frame_format) {
-    int i, samples_done = 0;
+    int samples_done = 0;
     int32_t hist1 = stream->adpcm_history1_32;
     int step_index = stream->adpcm_step_index;
     size_t header_size;
     int is_stereo = (channelspacing > 1);
 
+    IMA_TABLES_INIT();
+
     /* external interleave (blocked, should call 1 frame) */
 
     /* custom header, per channel */
@@ -1089,25 +1138,16 @@ void decode_h4m_ima(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
         default: header_size = 0; break;
     }
 
-    /* decode block nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        off_t byte_offset = is_stereo ?
-                stream->offset + header_size + i :      /* stereo: one nibble per channel */
-                stream->offset + header_size + i/2;     /* mono: consecutive nibbles */
-        int nibble_shift = is_stereo ?
-                (!(channel&1) ? 0:4) :                  /* stereo: L=low, R=high */
-                (!(i&1) ? 0:4);                         /* mono: low first */
-
-        std_ima_expand_nibble(stream, byte_offset,nibble_shift, &hist1, &step_index);
-
-        outbuf[samples_done * channelspacing] = (short)(hist1);
-        samples_done++;
-    }
+    /* decode block nibbles (stereo: one nibble per channel, L=low, R=high; mono: consecutive nibbles, low first) */
+    decode_ima_run(stream->streamfile, stream->offset + header_size, std_ima_decode, first_sample, samples_to_do,
+            !is_stereo, is_stereo ? (channel&1) : 0,
+            outbuf + samples_done * channelspacing, channelspacing, &hist1, &step_index);
 
     stream->adpcm_history1_32 = hist1;
     stream->adpcm_step_index = step_index;
 }
 
+
 /* ************************************************************* */
 
 size_t ima_bytes_to_samples(size_t bytes, int channels) {
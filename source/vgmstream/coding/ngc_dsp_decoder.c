@@ -4,10 +4,12 @@
 void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
     int i=first_sample;
     int32_t sample_count;
+    uint8_t frame_buf[0x08];
 
     int framesin = first_sample/14;
 
-    int8_t header = read_8bit(framesin*8+stream->offset,stream->streamfile);
+    const uint8_t * frame = peek_streamfile(frame_buf, framesin*8+stream->offset, 0x08, stream->streamfile);
+    int8_t header = frame[0];
     int32_t scale = 1 << (header & 0xf);
     int coef_index = (header >> 4) & 0xf;
     int32_t hist1 = stream->adpcm_history1_16;
@@ -18,7 +20,7 @@ void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
     first_sample = first_sample%14;
 
     for (i=first_sample,sample_count=0; i<first_sample+samples_to_do; i++,sample_count+=channelspacing) {
-        int sample_byte = read_8bit(framesin*8+stream->offset+1+i/2,stream->streamfile);
+        int sample_byte = frame[1 + i/2];
 
         outbuf[sample_count] = clamp16((
                  (((i&1?
@@ -36,6 +38,99 @@ void decode_ngc_dsp(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspa
     stream->adpcm_history2_16 = hist2;
 }
 
+#define DSP_MCH_MAX_CHANNELS 8
+#define DSP_MCH_WINDOW_FRAMES 16
+
+/* decodes a group of channels, each from its own offset (interleaved layouts), sample by sample
+ * across channels so the output is written in order */
+static void decode_ngc_dsp_mch_group(VGMSTREAMCHANNEL * stream, int channels, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do) {
+    uint8_t frames[DSP_MCH_MAX_CHANNELS][DSP_MCH_WINDOW_FRAMES*0x08];
+    int32_t hist1[DSP_MCH_MAX_CHANNELS], hist2[DSP_MCH_MAX_CHANNELS];
+    int32_t scale[DSP_MCH_MAX_CHANNELS], coef1[DSP_MCH_MAX_CHANNELS], coef2[DSP_MCH_MAX_CHANNELS];
+    int ch, f, i;
+
+    for (ch = 0; ch < channels; ch++) {
+        hist1[ch] = stream[ch].adpcm_history1_16;
+        hist2[ch] = stream[ch].adpcm_history2_16;
+    }
+
+    while (samples_to_do > 0) {
+        int framesin = first_sample / 14;
+        int first = first_sample % 14;
+        int frame_count = (first + samples_to_do + 13) / 14;
+        int samples_done = 0;
+
+        if (frame_count > DSP_MCH_WINDOW_FRAMES)
+            frame_count = DSP_MCH_WINDOW_FRAMES;
+
+        /* copy frames as peeked data is only valid until the next peek (channels often share a streamfile) */
+        for (ch = 0; ch < channels; ch++) {
+            const uint8_t * data = peek_streamfile(frames[ch], stream[ch].offset + framesin*0x08, frame_count*0x08, stream[ch].streamfile);
+            if (data != frames[ch])
+                memcpy(frames[ch], data, frame_count*0x08);
+        }
+
+        for (f = 0; f < frame_count && samples_done < samples_to_do; f++) {
+            int last = 14;
+            if (last - first > samples_to_do - samples_done)
+                last = first + samples_to_do - samples_done;
+
+            for (ch = 0; ch < channels; ch++) {
+                int8_t header = frames[ch][f*0x08];
+                int coef_index = (header >> 4) & 0xf;
+                scale[ch] = 1 << (header & 0xf);
+                coef1[ch] = stream[ch].adpcm_coef[coef_index*2];
+                coef2[ch] = stream[ch].adpcm_coef[coef_index*2+1];
+            }
+
+            for (i = first; i < last; i++) {
+                sample_t * out = outbuf + samples_done*channelspacing;
+
+                for (ch = 0; ch < channels; ch++) {
+                    int sample_byte = frames[ch][f*0x08 + 1 + i/2];
+                    int32_t sample = clamp16((
+                             (((i&1?
+                                get_low_nibble_signed(sample_byte):
+                                get_high_nibble_signed(sample_byte)
+                               ) * scale[ch])<<11) + 1024 +
+                             (coef1[ch] * hist1[ch] + coef2[ch] * hist2[ch]))>>11
+                            );
+
+                    out[ch] = sample;
+                    hist2[ch] = hist1[ch];
+                    hist1[ch] = sample;
+                }
+                samples_done++;
+            }
+
+            first = 0;
+        }
+
+        outbuf += samples_done*channelspacing;
+        first_sample += samples_done;
+        samples_to_do -= samples_done;
+    }
+
+    for (ch = 0; ch < channels; ch++) {
+        stream[ch].adpcm_history1_16 = hist1[ch];
+        stream[ch].adpcm_history2_16 = hist2[ch];
+    }
+}
+
+/* decode DSP for all channels in one pass, rather than a pass per channel writing every Nth sample
+ * (any number of frames, each channel reading from its own offset as in interleaved layouts) */
+void decode_ngc_dsp_mch(VGMSTREAM * vgmstream, sample_t * outbuf, int32_t first_sample, int32_t samples_to_do) {
+    int ch;
+
+    for (ch = 0; ch < vgmstream->channels; ch += DSP_MCH_MAX_CHANNELS) {
+        int channels = vgmstream->channels - ch;
+        if (channels > DSP_MCH_MAX_CHANNELS)
+            channels = DSP_MCH_MAX_CHANNELS;
+
+        decode_ngc_dsp_mch_group(&vgmstream->ch[ch], channels, outbuf + ch, vgmstream->channels, first_sample, samples_to_do);
+    }
+}
+
 /* read from memory rather than a file */
 static void decode_ngc_dsp_subint_internal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, uint8_t * mem) {
     int i=first_sample;
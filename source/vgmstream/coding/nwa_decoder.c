@@ -32,20 +32,35 @@
 
 #include <stdlib.h>
 #include "nwa_decoder.h"
-
-/* can serve up 8 bits at a time */
-static int
-getbits (STREAMFILE *file, off_t *offset, int *shift, int bits)
+#include "../util.h"
+
+/* Reads bits LSB first from a compressed block in memory, keeping up to 64 bits buffered
+ * (originally getbits did a 16-bit file read per call). Reads past the loaded data return 1s,
+ * like failed reads did. */
+typedef struct {
+    const uint8_t *data;
+    const uint8_t *end;
+    uint64_t bits;
+    int count;
+} nwa_bitreader;
+
+static inline int
+getbits (nwa_bitreader *br, int bits)
 {
-	int ret;
-    if (*shift > 8)
+    int ret;
+    if (br->count < bits)
     {
-        ++*offset;
-        *shift -= 8;
+        while (br->count <= 56)
+        {
+            uint64_t byte = (br->data < br->end) ? *br->data++ : 0xFF;
+            br->bits |= byte << br->count;
+            br->count += 8;
+        }
     }
-    ret = read_16bitLE(*offset,file) >> *shift;
-    *shift += bits;
-    return ret & ((1 << bits) - 1);	/* mask */
+    ret = (int)br->bits & ((1 << bits) - 1);	/* mask */
+    br->bits >>= bits;
+    br->count -= bits;
+    return ret;
 }
 
 NWAData *
@@ -66,6 +81,7 @@ open_nwa (STREAMFILE * streamFile, const char *filename)
     nwa->blocksize = read_32bitLE(0x20,streamFile);
     nwa->restsize = read_32bitLE(0x24,streamFile);
     nwa->offsets = NULL;
+    nwa->block_data = NULL;
     nwa->buffer = NULL;
     nwa->buffer_readpos = NULL;
     nwa->file = NULL;
@@ -99,6 +115,27 @@ open_nwa (STREAMFILE * streamFile, const char *filename)
 
     if (nwa->offsets[nwa->blocks-1] >= nwa->compdatasize) goto fail;
 
+    /* compressed blocks are loaded whole, sized from the offsets (bounded by the worst case of
+     * 14 bits per sample, for bad offsets) plus some bytes the bit reader may look ahead */
+    {
+        int max_samples = nwa->restsize > nwa->blocksize ? nwa->restsize : nwa->blocksize;
+        size_t max_size = 0x04 + ((size_t)max_samples * 14 + 7) / 8;
+
+        nwa->block_data_size = 0;
+        for (i = 0; i < nwa->blocks; i++)
+        {
+            off_t next = (i < nwa->blocks - 1) ? nwa->offsets[i+1] : nwa->compdatasize;
+            size_t size = (next > nwa->offsets[i] && next - nwa->offsets[i] < max_size) ?
+                    next - nwa->offsets[i] : max_size;
+            if (size > nwa->block_data_size)
+                nwa->block_data_size = size;
+        }
+        nwa->block_data_size += 0x08;
+
+        nwa->block_data = malloc(nwa->block_data_size);
+        if (!nwa->block_data) goto fail;
+    }
+
     if (nwa->restsize > nwa->blocksize) nwa->buffer =
         malloc(sizeof(sample)*nwa->restsize);
     else nwa->buffer =
@@ -133,6 +170,9 @@ close_nwa(NWAData * nwa)
     if (nwa->offsets)
         free (nwa->offsets);
     nwa->offsets = NULL;
+    if (nwa->block_data)
+        free (nwa->block_data);
+    nwa->block_data = NULL;
     if (nwa->buffer)
         free (nwa->buffer);
     nwa->buffer = NULL;
@@ -185,36 +225,45 @@ nwa_decode_block(NWAData *nwa)
     nwa->buffer_readpos = nwa->buffer;
 
     {
-        sample d[2];
+        int16_t d[2];
         int i;
-        int shift = 0;
-        off_t offset = nwa->offsets[nwa->curblock];
+        nwa_bitreader br;
+        const uint8_t *data;
         int dsize = curblocksize / (nwa->bps / 8);
         int flip_flag = 0;			/* stereo 用 */
         int runlength = 0;
+        int is_runlength = use_runlength(nwa);
+
+        /* load the whole compressed block */
+        data = peek_streamfile(nwa->block_data, nwa->offsets[nwa->curblock], nwa->block_data_size, nwa->file);
+        br.end = data + nwa->block_data_size;
 
         /* read initial sample value */
         for (i=0;i<nwa->channels;i++)
         {
-            if (nwa->bps == 8) { d[i] = read_8bit(offset,nwa->file); }
+            if (nwa->bps == 8) { d[i] = (int8_t)data[0]; }
             else							/* bps == 16 */
             {
-                d[i] = read_16bitLE(offset,nwa->file);
-                offset += 2;
+                d[i] = get_16bitLE(data);
+                data += 2;
             }
         }
 
+        br.data = data;
+        br.bits = 0;
+        br.count = 0;
+
         for (i = 0; i < dsize; i++)
         {
             if (runlength == 0)
             {						/* コピーループ中でないならデータ読み込み */
-                int type = getbits(nwa->file, &offset, &shift, 3);
+                int type = getbits(&br, 3);
                 /* type により分岐：0, 1-6, 7 */
                 if (type == 7)
                 {
                     /* 7 : 大きな差分 */
                     /* RunLength() 有効時（CompLevel==5, 音声ファイル) では無効 */
-                    if (getbits(nwa->file, &offset, &shift, 1) == 1)
+                    if (getbits(&br, 1) == 1)
                     {
                         d[flip_flag] = 0;	/* 未使用 */
                     }
@@ -234,7 +283,7 @@ nwa_decode_block(NWAData *nwa)
 						{
 							const int MASK1 = (1 << (BITS - 1));
 							const int MASK2 = (1 << (BITS - 1)) - 1;
-							int b = getbits(nwa->file, &offset, &shift, BITS);
+							int b = getbits(&br, BITS);
 							if (b & MASK1)
 								d[flip_flag] -= (b & MASK2) << SHIFT;
 							else
@@ -259,7 +308,7 @@ nwa_decode_block(NWAData *nwa)
 					{
 						const int MASK1 = (1 << (BITS - 1));
 						const int MASK2 = (1 << (BITS - 1)) - 1;
-						int b = getbits(nwa->file, &offset, &shift, BITS);
+						int b = getbits(&br, BITS);
 						if (b & MASK1)
 							d[flip_flag] -= (b & MASK2) << SHIFT;
 						else
@@ -269,16 +318,16 @@ nwa_decode_block(NWAData *nwa)
                 else
                 {					/* type == 0 */
                     /* ランレングス圧縮なしの場合はなにもしない */
-                    if (use_runlength(nwa))
+                    if (is_runlength)
                     {
                         /* ランレングス圧縮ありの場合 */
-                        runlength = getbits(nwa->file, &offset, &shift, 1);
+                        runlength = getbits(&br, 1);
                         if (runlength == 1)
                         {
-                            runlength = getbits(nwa->file, &offset, &shift, 2);
+                            runlength = getbits(&br, 2);
                             if (runlength == 3)
                             {
-                                runlength = getbits(nwa->file, &offset, &shift, 8);
+                                runlength = getbits(&br, 8);
                             }
                         }
                     }
@@ -306,18 +355,34 @@ nwa_decode_block(NWAData *nwa)
     return;
 }
 
-void
+/* returns 0 (and doesn't move) if seekpos isn't in the data */
+int
 seek_nwa(NWAData *nwa, int32_t seekpos)
 {
-    int dest_block = seekpos/(nwa->blocksize/nwa->channels);
-    int32_t remainder = seekpos%(nwa->blocksize/nwa->channels);
+    int32_t block_samples = nwa->blocksize/nwa->channels;
+    int32_t last_samples = nwa->restsize/nwa->channels;
+    int32_t remainder;
+    int dest_block;
+
+    if (seekpos < 0 || block_samples <= 0)
+        return 0;
+
+    /* the last block may be longer than the others (restsize > blocksize) */
+    dest_block = seekpos/block_samples;
+    if (dest_block > nwa->blocks - 1)
+        dest_block = nwa->blocks - 1;
+    remainder = seekpos - dest_block*block_samples;
+    if (remainder >= (dest_block == nwa->blocks - 1 ? last_samples : block_samples))
+        return 0;
 
+    /* blocks start from absolute samples, so any block can be decoded directly */
     nwa->curblock = dest_block;
 
     nwa_decode_block(nwa);
 
     nwa->buffer_readpos = nwa->buffer + remainder*nwa->channels;
     nwa->samples_in_buffer -= remainder*nwa->channels;
+    return 1;
 }
 
 /* interface to vgmstream */
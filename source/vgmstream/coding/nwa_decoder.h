@@ -51,6 +51,10 @@ typedef struct NWAData_s
     int curblock;
     off_t *offsets;
 
+    /* current compressed block */
+    uint8_t *block_data;
+    size_t block_data_size;
+
     STREAMFILE *file;
 
     /* temporarily store samples */
@@ -62,6 +66,6 @@ typedef struct NWAData_s
 NWAData *open_nwa(STREAMFILE *streamFile, const char *filename);
 void close_nwa(NWAData *nwa);
 void reset_nwa(NWAData *nwa);
-void seek_nwa(NWAData *nwa, int32_t seekpos);
+int seek_nwa(NWAData *nwa, int32_t seekpos);
 
 #endif
@@ -1,5 +1,13 @@
 #include "coding.h"
 
+/* vector nibble expansion (the scalar one is kept as reference, define PSX_NO_SIMD to use it) */
+#if !defined(PSX_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define PSX_SIMD_NEON
+#elif !defined(PSX_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define PSX_SIMD_SSE2
+#endif
 
 /* PS-ADPCM table, defined as rational numbers (as in the spec) */
 static const double ps_adpcm_coefs_f[5][2] = {
@@ -42,8 +50,56 @@ static const int ps_adpcm_coefs_i[5][2] = {
  * may use int math in software, etc). There are inaudible rounding diffs between implementations.
  */
 
-/* standard PS-ADPCM (float math version) */
+/* Expands the 28 nibbles (low nibble first) of a 0x10 frame to 16b samples scaled by the shift.
+ * Writes 32 values, as if the 2 header bytes were nibbles too, so samples start at out[4]. */
+static void expand_psx_nibbles(const uint8_t * frame, int shift_factor, int16_t * out) {
+#if defined(PSX_SIMD_NEON)
+    uint8x16_t bytes = vld1q_u8(frame);
+    uint8x16x2_t nibbles = vzipq_u8(vandq_u8(bytes, vdupq_n_u8(0x0f)), vshrq_n_u8(bytes, 4));
+    int16x8_t shift = vdupq_n_s16(-shift_factor);
+
+    /* nibble to the top of a 16b lane (sign extend), then arithmetic shift */
+    #define PSX_EXPAND(n) vshlq_s16(vreinterpretq_s16_u16(vshlq_n_u16(vshll_n_u8(n, 8), 4)), shift)
+    vst1q_s16(out + 0x00, PSX_EXPAND(vget_low_u8(nibbles.val[0])));
+    vst1q_s16(out + 0x08, PSX_EXPAND(vget_high_u8(nibbles.val[0])));
+    vst1q_s16(out + 0x10, PSX_EXPAND(vget_low_u8(nibbles.val[1])));
+    vst1q_s16(out + 0x18, PSX_EXPAND(vget_high_u8(nibbles.val[1])));
+    #undef PSX_EXPAND
+#elif defined(PSX_SIMD_SSE2)
+    __m128i bytes = _mm_loadu_si128((const __m128i*)frame);
+    __m128i mask = _mm_set1_epi8(0x0f);
+    __m128i lo = _mm_and_si128(bytes, mask);
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), mask);
+    __m128i nibbles0 = _mm_unpacklo_epi8(lo, hi);
+    __m128i nibbles1 = _mm_unpackhi_epi8(lo, hi);
+    __m128i zero = _mm_setzero_si128();
+    __m128i shift = _mm_cvtsi32_si128(shift_factor);
+
+    /* nibble to the top of a 16b lane (sign extend), then arithmetic shift */
+    #define PSX_EXPAND(n) _mm_sra_epi16(_mm_slli_epi16(n, 4), shift)
+    _mm_storeu_si128((__m128i*)(out + 0x00), PSX_EXPAND(_mm_unpacklo_epi8(zero, nibbles0)));
+    _mm_storeu_si128((__m128i*)(out + 0x08), PSX_EXPAND(_mm_unpackhi_epi8(zero, nibbles0)));
+    _mm_storeu_si128((__m128i*)(out + 0x10), PSX_EXPAND(_mm_unpacklo_epi8(zero, nibbles1)));
+    _mm_storeu_si128((__m128i*)(out + 0x18), PSX_EXPAND(_mm_unpackhi_epi8(zero, nibbles1)));
+    #undef PSX_EXPAND
+#else
+    int i;
+
+    for (i = 0; i < 28; i++) {
+        uint8_t nibbles = frame[0x02 + i/2];
+        int32_t sample = i&1 ? /* low nibble first */
+                (nibbles >> 4) & 0x0f :
+                (nibbles >> 0) & 0x0f;
+        out[4 + i] = (int16_t)((sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
+    }
+#endif
+}
+
+/* standard PS-ADPCM (float math version), decodes any number of frames from first_sample */
 void decode_psx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int is_badflags) {
+    uint8_t frame_buf[0x10];
+    int16_t samples[32];
+    const uint8_t * frame;
     off_t frame_offset;
     int i, frames_in, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
@@ -56,43 +112,61 @@ void decode_psx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing
     samples_per_frame = (bytes_per_frame - 0x02) * 2; /* always 28 */
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
-
-    /* parse frame header */
     frame_offset = stream->offset + bytes_per_frame*frames_in;
-    coef_index   = ((uint8_t)read_8bit(frame_offset+0x00,stream->streamfile) >> 4) & 0xf;
-    shift_factor = ((uint8_t)read_8bit(frame_offset+0x00,stream->streamfile) >> 0) & 0xf;
-    flag = (uint8_t)read_8bit(frame_offset+0x01,stream->streamfile); /* only lower nibble needed */
 
-    VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
-    if (coef_index > 5) /* needed by inFamous (PS3) (maybe it's supposed to use more filters?) */
-        coef_index = 0; /* upper filters aren't used in PS1/PS2, maybe in PSP/PS3? */
-    if (shift_factor > 12)
-        shift_factor = 9; /* supposedly, from Nocash PSX docs */
-
-    if (is_badflags) /* some games store garbage or extra internal logic in the flags, must be ignored */
-        flag = 0;
-    VGM_ASSERT_ONCE(flag > 7,"PS-ADPCM: unknown flag at %x\n", (uint32_t)frame_offset); /* meta should use PSX-badflags */
-
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int32_t sample = 0;
-
-        if (flag < 0x07) { /* with flag 0x07 decoded sample must be 0 */
-            uint8_t nibbles = (uint8_t)read_8bit(frame_offset+0x02+i/2,stream->streamfile);
-
-            sample = i&1 ? /* low nibble first */
-                    (nibbles >> 4) & 0x0f :
-                    (nibbles >> 0) & 0x0f;
-            sample = (int16_t)((sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
-            sample = (int)(sample + ps_adpcm_coefs_f[coef_index][0]*hist1 + ps_adpcm_coefs_f[coef_index][1]*hist2);
-            sample = clamp16(sample);
+    while (samples_to_do > 0) {
+        int samples_this_frame = samples_per_frame - first_sample;
+        int coef1, coef2;
+        if (samples_this_frame > samples_to_do)
+            samples_this_frame = samples_to_do;
+
+        /* parse frame header */
+        frame = peek_streamfile(frame_buf, frame_offset, bytes_per_frame, stream->streamfile); /* ignore EOF errors */
+        coef_index   = (frame[0x00] >> 4) & 0xf;
+        shift_factor = (frame[0x00] >> 0) & 0xf;
+        flag = frame[0x01]; /* only lower nibble needed */
+
+        VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
+        if (coef_index > 4) /* needed by inFamous (PS3) (maybe it's supposed to use more filters?) */
+            coef_index = 0; /* upper filters aren't used in PS1/PS2, maybe in PSP/PS3? (5 was past the float table, reading ~0) */
+        if (shift_factor > 12)
+            shift_factor = 9; /* supposedly, from Nocash PSX docs */
+
+        if (is_badflags) /* some games store garbage or extra internal logic in the flags, must be ignored */
+            flag = 0;
+        VGM_ASSERT_ONCE(flag > 7,"PS-ADPCM: unknown flag at %x\n", (uint32_t)frame_offset); /* meta should use PSX-badflags */
+
+        if (flag < 0x07) {
+            /* nibbles are independent, only the filter needs to go one by one */
+            expand_psx_nibbles(frame, shift_factor, samples);
+            coef1 = ps_adpcm_coefs_i[coef_index][0];
+            coef2 = ps_adpcm_coefs_i[coef_index][1];
+
+            /* Same as the float formula: coefs are n/64 so with 16b samples all float terms are exact,
+             * and truncating the sum*64 / 64 rounds the same way as the (int) cast. */
+            for (i = first_sample; i < first_sample + samples_this_frame; i++) {
+                int32_t sample = (samples[4 + i]*64 + coef1*hist1 + coef2*hist2) / 64;
+                sample = clamp16(sample);
+
+                outbuf[sample_count] = sample;
+                sample_count += channelspacing;
+
+                hist2 = hist1;
+                hist1 = sample;
+            }
+        }
+        else { /* with flag 0x07 decoded sample must be 0 */
+            for (i = first_sample; i < first_sample + samples_this_frame; i++) {
+                outbuf[sample_count] = 0;
+                sample_count += channelspacing;
+            }
+            hist2 = samples_this_frame > 1 ? 0 : hist1;
+            hist1 = 0;
         }
 
-        outbuf[sample_count] = sample;
-        sample_count += channelspacing;
-
-        hist2 = hist1;
-        hist1 = sample;
+        samples_to_do -= samples_this_frame;
+        first_sample = 0;
+        frame_offset += bytes_per_frame;
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -103,8 +177,11 @@ void decode_psx(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing
 /* PS-ADPCM with configurable frame size and no flag (int math version).
  * Found in some PC/PS3 games (FF XI in sizes 0x3/0x5/0x9/0x41, Afrika in size 0x4, Blur/James Bond in size 0x33, etc).
  *
- * Uses int math to decode, which seems more likely (based on FF XI PC's code in Moogle Toolbox). */
+ * Uses int math to decode, which seems more likely (based on FF XI PC's code in Moogle Toolbox).
+ * Decodes any number of frames from first_sample. */
 void decode_psx_configurable(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int frame_size) {
+    uint8_t frame_buf[0x100];
+    const uint8_t * frame;
     off_t frame_offset;
     int i, frames_in, sample_count = 0;
     size_t bytes_per_frame, samples_per_frame;
@@ -117,35 +194,68 @@ void decode_psx_configurable(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int c
     samples_per_frame = (bytes_per_frame - 0x01) * 2;
     frames_in = first_sample / samples_per_frame;
     first_sample = first_sample % samples_per_frame;
-
-    /* parse frame header */
     frame_offset = stream->offset + bytes_per_frame*frames_in;
-    coef_index   = ((uint8_t)read_8bit(frame_offset+0x00,stream->streamfile) >> 4) & 0xf;
-    shift_factor = ((uint8_t)read_8bit(frame_offset+0x00,stream->streamfile) >> 0) & 0xf;
 
-    VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
-    if (coef_index > 5) /* needed by Afrika (PS3) (maybe it's supposed to use more filters?) */
-        coef_index = 0; /* upper filters aren't used in PS1/PS2, maybe in PSP/PS3? */
-    if (shift_factor > 12)
-        shift_factor = 9; /* supposedly, from Nocash PSX docs */
+    while (samples_to_do > 0) {
+        int samples_this_frame = samples_per_frame - first_sample;
+        int coef1, coef2, window_start, window_end;
+        if (samples_this_frame > samples_to_do)
+            samples_this_frame = samples_to_do;
+
+        /* parse frame header, with the whole frame if it fits (all known sizes) */
+        if (bytes_per_frame <= sizeof(frame_buf)) {
+            frame = peek_streamfile(frame_buf, frame_offset, bytes_per_frame, stream->streamfile);
+            window_start = 0;
+            window_end = bytes_per_frame - 0x01;
+        }
+        else {
+            frame = peek_streamfile(frame_buf, frame_offset, 0x01, stream->streamfile);
+            window_start = window_end = 0;
+        }
+        coef_index   = (frame[0x00] >> 4) & 0xf;
+        shift_factor = (frame[0x00] >> 0) & 0xf;
+
+        VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
+        if (coef_index > 4) /* needed by Afrika (PS3) (maybe it's supposed to use more filters?) */
+            coef_index = 0; /* upper filters aren't used in PS1/PS2, maybe in PSP/PS3? */
+        if (shift_factor > 12)
+            shift_factor = 9; /* supposedly, from Nocash PSX docs */
+        coef1 = ps_adpcm_coefs_i[coef_index][0];
+        coef2 = ps_adpcm_coefs_i[coef_index][1];
+        frame += 0x01;
+
+        /* decode nibbles, fetched in windows when the frame didn't fit */
+        for (i = first_sample; i < first_sample + samples_this_frame; ) {
+            if (i/2 >= window_end) {
+                window_start = i/2;
+                window_end = (first_sample + samples_this_frame - 1)/2 + 1;
+                if (window_end - window_start > (int)sizeof(frame_buf))
+                    window_end = window_start + (int)sizeof(frame_buf);
+                frame = peek_streamfile(frame_buf, frame_offset + 0x01 + window_start, window_end - window_start, stream->streamfile);
+            }
 
-    /* decode nibbles */
-    for (i = first_sample; i < first_sample + samples_to_do; i++) {
-        int32_t sample = 0;
-        uint8_t nibbles = (uint8_t)read_8bit(frame_offset+0x01+i/2,stream->streamfile);
+            for (; i < first_sample + samples_this_frame && i/2 < window_end; i++) {
+                int32_t sample = 0;
+                uint8_t nibbles = frame[i/2 - window_start];
 
-        sample = i&1 ? /* low nibble first */
-                (nibbles >> 4) & 0x0f :
-                (nibbles >> 0) & 0x0f;
-        sample = (int16_t)((sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
-        sample = sample + ((ps_adpcm_coefs_i[coef_index][0]*hist1 + ps_adpcm_coefs_i[coef_index][1]*hist2) >> 6);
-        sample = clamp16(sample);
+                sample = i&1 ? /* low nibble first */
+                        (nibbles >> 4) & 0x0f :
+                        (nibbles >> 0) & 0x0f;
+                sample = (int16_t)((sample << 12) & 0xf000) >> shift_factor; /* 16b sign extend + scale */
+                sample = sample + ((coef1*hist1 + coef2*hist2) >> 6);
+                sample = clamp16(sample);
 
-        outbuf[sample_count] = sample;
-        sample_count += channelspacing;
+                outbuf[sample_count] = sample;
+                sample_count += channelspacing;
 
-        hist2 = hist1;
-        hist1 = sample;
+                hist2 = hist1;
+                hist1 = sample;
+            }
+        }
+
+        samples_to_do -= samples_this_frame;
+        first_sample = 0;
+        frame_offset += bytes_per_frame;
     }
 
     stream->adpcm_history1_32 = hist1;
@@ -174,8 +284,8 @@ void decode_psx_pivotal(VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channe
     shift_factor = ((uint8_t)read_8bit(frame_offset+0x00,stream->streamfile) >> 0) & 0xf;
 
     VGM_ASSERT_ONCE(coef_index > 5 || shift_factor > 12, "PS-ADPCM: incorrect coefs/shift at %x\n", (uint32_t)frame_offset);
-    if (coef_index > 5) /* just in case */
-        coef_index = 5;
+    if (coef_index > 4) /* just in case */
+        coef_index = 4;
     if (shift_factor > 12) /* same */
         shift_factor = 12;
     scale = (float)(1.0 / (double)(1 << shift_factor));
@@ -0,0 +1,249 @@
+#include "vgmstream.h"
+#include "key_cache.h"
+#include "util.h"
+
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
+
+
+/**
+ * Key cache: encrypted formats without a key file test every known key, which for big lists
+ * (HCA with subkeys, FSB) takes a while per file. Games use the same key for all their files, so
+ * the key found for one file is remembered per folder and tried first for the next ones.
+ *
+ * Entries live for the session and can be exported to be persisted by the player and imported
+ * on startup. Folders are identified by a hash of their path, so no names are stored.
+ */
+
+#define KEY_CACHE_ENTRIES 256
+#define KEY_CACHE_VERSION 1
+#define KEY_CACHE_HEADER_SIZE 0x10
+#define KEY_CACHE_ENTRY_SIZE 0x14 /* + key */
+
+typedef struct {
+    uint64_t scope;         /* hash of the folder */
+    uint32_t stamp;         /* last use, oldest entries are replaced when full */
+    key_cache_format_t format;
+    uint32_t flags;
+    size_t key_size;
+    uint8_t key[KEY_CACHE_KEY_MAX];
+} key_cache_entry;
+
+/* entries are guarded by lock, as files may be opened from several threads */
+static struct {
+#ifdef VGM_USE_THREADS
+    pthread_mutex_t lock;
+#endif
+    key_cache_entry entries[KEY_CACHE_ENTRIES];
+    int count;
+    uint32_t stamp;
+    uint32_t version;       /* changes on every update, so players know when to save */
+} keycache
+#ifdef VGM_USE_THREADS
+    = { PTHREAD_MUTEX_INITIALIZER }
+#endif
+;
+
+#ifdef VGM_USE_THREADS
+#define KEYCACHE_LOCK()     pthread_mutex_lock(&keycache.lock)
+#define KEYCACHE_UNLOCK()   pthread_mutex_unlock(&keycache.lock)
+#else
+#define KEYCACHE_LOCK()
+#define KEYCACHE_UNLOCK()
+#endif
+
+
+/* FNV-1a of the folder, separators normalized so "a/b" and "a\b" match */
+static uint64_t get_scope(STREAMFILE* sf) {
+    char path[PATH_LIMIT];
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    int i;
+
+    get_streamfile_path(sf, path, sizeof(path));
+    for (i = 0; path[i] != '\0'; i++) {
+        uint8_t c = path[i] == '\\' ? '/' : path[i];
+        hash = (hash ^ c) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static key_cache_entry* find_entry(uint64_t scope, key_cache_format_t format) {
+    int i;
+
+    for (i = 0; i < keycache.count; i++) {
+        key_cache_entry* entry = &keycache.entries[i];
+        if (entry->scope == scope && entry->format == format)
+            return entry;
+    }
+    return NULL;
+}
+
+static key_cache_entry* add_entry(uint64_t scope, key_cache_format_t format) {
+    key_cache_entry* entry;
+    int i;
+
+    if (keycache.count < KEY_CACHE_ENTRIES) {
+        entry = &keycache.entries[keycache.count++];
+    }
+    else {
+        entry = &keycache.entries[0];
+        for (i = 1; i < keycache.count; i++) {
+            if (keycache.entries[i].stamp < entry->stamp)
+                entry = &keycache.entries[i];
+        }
+    }
+
+    memset(entry, 0, sizeof(key_cache_entry));
+    entry->scope = scope;
+    entry->format = format;
+    return entry;
+}
+
+
+size_t key_cache_get(STREAMFILE* sf, key_cache_format_t format, uint8_t* key, size_t key_max, uint32_t* flags) {
+    uint64_t scope = get_scope(sf);
+    key_cache_entry* entry;
+    size_t key_size = 0;
+
+    KEYCACHE_LOCK();
+    entry = find_entry(scope, format);
+    if (entry && entry->key_size <= key_max) {
+        memcpy(key, entry->key, entry->key_size);
+        key_size = entry->key_size;
+        if (flags)
+            *flags = entry->flags;
+        entry->stamp = ++keycache.stamp;
+    }
+    KEYCACHE_UNLOCK();
+
+    return key_size;
+}
+
+void key_cache_set(STREAMFILE* sf, key_cache_format_t format, const uint8_t* key, size_t key_size, uint32_t flags) {
+    uint64_t scope = get_scope(sf);
+    key_cache_entry* entry;
+
+    if (key_size == 0 || key_size > KEY_CACHE_KEY_MAX)
+        return;
+
+    KEYCACHE_LOCK();
+    entry = find_entry(scope, format);
+    if (!entry || entry->flags != flags || entry->key_size != key_size || memcmp(entry->key, key, key_size) != 0) {
+        if (!entry)
+            entry = add_entry(scope, format);
+        memcpy(entry->key, key, key_size);
+        entry->key_size = key_size;
+        entry->flags = flags;
+        keycache.version++;
+    }
+    entry->stamp = ++keycache.stamp;
+    KEYCACHE_UNLOCK();
+}
+
+
+uint32_t vgmstream_key_cache_version(void) {
+    uint32_t version;
+
+    KEYCACHE_LOCK();
+    version = keycache.version;
+    KEYCACHE_UNLOCK();
+
+    return version;
+}
+
+size_t vgmstream_key_cache_export(uint8_t* buf, size_t buf_size) {
+    size_t size;
+    int i;
+
+    KEYCACHE_LOCK();
+
+    size = KEY_CACHE_HEADER_SIZE;
+    for (i = 0; i < keycache.count; i++) {
+        size += KEY_CACHE_ENTRY_SIZE + keycache.entries[i].key_size;
+    }
+    if (keycache.count == 0) {
+        size = 0;
+        goto done;
+    }
+    if (!buf)
+        goto done;
+    if (buf_size < size) {
+        size = 0;
+        goto done;
+    }
+
+    memset(buf, 0, KEY_CACHE_HEADER_SIZE);
+    memcpy(buf + 0x00, "VKEY", 4);
+    put_32bitLE(buf + 0x04, KEY_CACHE_VERSION);
+    put_32bitLE(buf + 0x08, keycache.count);
+
+    {
+        uint8_t* p = buf + KEY_CACHE_HEADER_SIZE;
+        for (i = 0; i < keycache.count; i++) {
+            key_cache_entry* entry = &keycache.entries[i];
+
+            put_32bitLE(p + 0x00, (uint32_t)(entry->scope >> 0));
+            put_32bitLE(p + 0x04, (uint32_t)(entry->scope >> 32));
+            put_32bitLE(p + 0x08, entry->format);
+            put_32bitLE(p + 0x0c, entry->flags);
+            put_32bitLE(p + 0x10, entry->key_size);
+            memcpy(p + KEY_CACHE_ENTRY_SIZE, entry->key, entry->key_size);
+            p += KEY_CACHE_ENTRY_SIZE + entry->key_size;
+        }
+    }
+
+done:
+    KEYCACHE_UNLOCK();
+    return size;
+}
+
+int vgmstream_key_cache_import(const uint8_t* buf, size_t buf_size) {
+    const uint8_t* p;
+    const uint8_t* end = buf + buf_size;
+    int i, count, ok = 0;
+
+    if (buf_size < KEY_CACHE_HEADER_SIZE || memcmp(buf + 0x00, "VKEY", 4) != 0)
+        return 0;
+    if (get_32bitLE(buf + 0x04) != KEY_CACHE_VERSION)
+        return 0;
+    count = get_32bitLE(buf + 0x08);
+    if (count <= 0 || count > KEY_CACHE_ENTRIES)
+        return 0;
+
+    KEYCACHE_LOCK();
+
+    /* validate everything first, so a broken file doesn't leave half the entries */
+    p = buf + KEY_CACHE_HEADER_SIZE;
+    for (i = 0; i < count; i++) {
+        size_t key_size;
+
+        if (end - p < KEY_CACHE_ENTRY_SIZE)
+            goto done;
+        key_size = (uint32_t)get_32bitLE(p + 0x10);
+        if (key_size == 0 || key_size > KEY_CACHE_KEY_MAX || end - p < KEY_CACHE_ENTRY_SIZE + key_size)
+            goto done;
+        p += KEY_CACHE_ENTRY_SIZE + key_size;
+    }
+
+    /* entries found this session are kept over imported ones */
+    p = buf + KEY_CACHE_HEADER_SIZE;
+    for (i = 0; i < count; i++) {
+        uint64_t scope = (uint32_t)get_32bitLE(p + 0x00) | ((uint64_t)(uint32_t)get_32bitLE(p + 0x04) << 32);
+        key_cache_format_t format = get_32bitLE(p + 0x08);
+        size_t key_size = (uint32_t)get_32bitLE(p + 0x10);
+
+        if (!find_entry(scope, format) && keycache.count < KEY_CACHE_ENTRIES) {
+            key_cache_entry* entry = add_entry(scope, format);
+            entry->flags = get_32bitLE(p + 0x0c);
+            entry->key_size = key_size;
+            memcpy(entry->key, p + KEY_CACHE_ENTRY_SIZE, key_size);
+        }
+        p += KEY_CACHE_ENTRY_SIZE + key_size;
+    }
+
+    ok = 1;
+done:
+    KEYCACHE_UNLOCK();
+    return ok;
+}
@@ -0,0 +1,21 @@
+#ifndef _KEY_CACHE_H_
+#define _KEY_CACHE_H_
+
+#include "streamfile.h"
+
+/* formats that brute-force keys from a list */
+typedef enum {
+    KEY_CACHE_HCA = 1,
+    KEY_CACHE_FSB = 2,
+} key_cache_format_t;
+
+#define KEY_CACHE_KEY_MAX 128
+
+/* Gets the key last found for a format in the file's folder (files there usually share it).
+ * Returns the key size (0 if none), flags are format-specific (variant of the key). */
+size_t key_cache_get(STREAMFILE* sf, key_cache_format_t format, uint8_t* key, size_t key_max, uint32_t* flags);
+
+/* remembers a key that worked for a file, for other files in the same folder */
+void key_cache_set(STREAMFILE* sf, key_cache_format_t format, const uint8_t* key, size_t key_size, uint32_t flags);
+
+#endif /* _KEY_CACHE_H_ */
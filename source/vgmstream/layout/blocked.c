@@ -2,6 +2,134 @@
 #include "../vgmstream.h"
 
 
+/* block samples, from the block header if known, otherwise from the block size */
+static int get_block_samples(VGMSTREAM * vgmstream, int frame_size, int samples_per_frame) {
+    if (vgmstream->current_block_samples) {
+        return vgmstream->current_block_samples;
+    } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
+        return vgmstream->current_block_size * 2 * samples_per_frame;
+    } else {
+        return vgmstream->current_block_size / frame_size * samples_per_frame;
+    }
+}
+
+/* Block index: start offset and sample of each block found so far (from the first block on, in
+ * order), filled while rendering or seeking. Since block_update only needs the offset (plus what
+ * the previous block leaves in full_block_size, like THP's next frame size), seeks then jump to a
+ * block directly instead of walking the chain from the start again. */
+typedef struct {
+    off_t offset;
+    int32_t sample;
+    size_t full_block_size; /* before parsing the block */
+} block_index_entry;
+
+typedef struct {
+    int count;
+    int capacity;
+    block_index_entry *entries;
+} block_index_data;
+
+void block_index_init(VGMSTREAM * vgmstream) {
+    block_index_data *data;
+
+    if (vgmstream->block_index)
+        return;
+    if (vgmstream->layout_type < layout_blocked_ast || vgmstream->layout_type >= layout_segmented)
+        return;
+    /* block state depends on previous blocks */
+    if (vgmstream->layout_type == layout_blocked_h4m)
+        return;
+    /* only used when seeking by block headers */
+    if (get_vgmstream_seek_warmup(vgmstream) < 0)
+        return;
+
+    data = calloc(1, sizeof(block_index_data));
+    if (!data) return;
+
+    /* first block, as set up by the meta */
+    data->capacity = 256;
+    data->entries = malloc(data->capacity * sizeof(block_index_entry));
+    if (!data->entries) {
+        free(data);
+        return;
+    }
+    data->entries[0].offset = vgmstream->current_block_offset;
+    data->entries[0].sample = vgmstream->current_sample - vgmstream->samples_into_block;
+    data->entries[0].full_block_size = 0; /* never jumped to, resets go back to the first block */
+    data->count = 1;
+
+    vgmstream->block_index = data;
+}
+
+void block_index_close(VGMSTREAM * vgmstream) {
+    block_index_data *data = vgmstream->block_index;
+    if (!data) return;
+
+    free(data->entries);
+    free(data);
+    vgmstream->block_index = NULL;
+}
+
+/* adds the current block if the previous one (at prev_offset/prev_sample) is the last known,
+ * with the full_block_size the previous block left before the current one was parsed */
+static void block_index_add(VGMSTREAM * vgmstream, off_t prev_offset, int32_t prev_sample, size_t full_block_size) {
+    block_index_data *data = vgmstream->block_index;
+    block_index_entry *last;
+
+    if (!data)
+        return;
+
+    last = &data->entries[data->count - 1];
+    if (last->offset != prev_offset || last->sample != prev_sample)
+        return;
+    if (vgmstream->current_block_offset <= prev_offset)
+        return;
+
+    if (data->count == data->capacity) {
+        int capacity = data->capacity * 2;
+        block_index_entry *entries = realloc(data->entries, capacity * sizeof(block_index_entry));
+        if (!entries) return;
+        data->entries = entries;
+        data->capacity = capacity;
+    }
+
+    data->entries[data->count].offset = vgmstream->current_block_offset;
+    data->entries[data->count].sample = vgmstream->current_sample;
+    data->entries[data->count].full_block_size = full_block_size;
+    data->count++;
+}
+
+/* moves to the last known block starting up to skip_sample, if after the current one */
+static void block_index_jump(VGMSTREAM * vgmstream, int32_t skip_sample) {
+    block_index_data *data = vgmstream->block_index;
+    block_index_entry *entry;
+    int lo, hi;
+
+    if (!data)
+        return;
+
+    lo = 0;
+    hi = data->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (data->entries[mid].sample <= skip_sample)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return;
+
+    entry = &data->entries[lo - 1];
+    if (entry->sample <= vgmstream->current_sample - vgmstream->samples_into_block)
+        return;
+
+    vgmstream->full_block_size = entry->full_block_size;
+    block_update(entry->offset, vgmstream);
+    vgmstream->current_sample = entry->sample;
+    vgmstream->samples_into_block = 0;
+}
+
 /* Decodes samples for blocked streams.
  * Data is divided into headered blocks with a bunch of data. The layout calls external helper functions
  * when a block is decoded, and those must parse the new block and move offsets accordingly. */
@@ -11,15 +139,7 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
 
     frame_size = get_vgmstream_frame_size(vgmstream);
     samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
-    samples_this_block = 0;
-
-    if (vgmstream->current_block_samples) {
-        samples_this_block = vgmstream->current_block_samples;
-    } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
-        samples_this_block = vgmstream->current_block_size * 2 * samples_per_frame;
-    } else {
-        samples_this_block = vgmstream->current_block_size / frame_size * samples_per_frame;
-    }
+    samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
 
 
     while (samples_written < sample_count) {
@@ -28,13 +148,7 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
 
         if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream)) {
             /* handle looping, readjust back to loop start values */
-            if (vgmstream->current_block_samples) {
-                samples_this_block = vgmstream->current_block_samples;
-            } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
-                samples_this_block = vgmstream->current_block_size * 2 * samples_per_frame;
-            } else {
-                samples_this_block = vgmstream->current_block_size / frame_size * samples_per_frame;
-            }
+            samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
             continue;
         }
 
@@ -69,18 +183,16 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
         /* move to next block when all samples are consumed */
         if (vgmstream->samples_into_block == samples_this_block
                 /*&& vgmstream->current_sample < vgmstream->num_samples*/) { /* don't go past last block */ //todo
+            off_t block_offset = vgmstream->current_block_offset;
+            size_t full_block_size = vgmstream->full_block_size;
+
             block_update(vgmstream->next_block_offset,vgmstream);
+            block_index_add(vgmstream, block_offset, vgmstream->current_sample - samples_this_block, full_block_size);
 
             /* update since these may change each block */
             frame_size = get_vgmstream_frame_size(vgmstream);
             samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
-            if (vgmstream->current_block_samples) {
-                samples_this_block = vgmstream->current_block_samples;
-            } else if (frame_size == 0) { /* assume 4 bit */ //TODO: get_vgmstream_frame_size() really should return bits... */
-                samples_this_block = vgmstream->current_block_size * 2 * samples_per_frame;
-            } else {
-                samples_this_block = vgmstream->current_block_size / frame_size * samples_per_frame;
-            }
+            samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
 
             vgmstream->samples_into_block = 0;
         }
@@ -88,6 +200,45 @@ void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM
     }
 }
 
+/* Moves a blocked stream forward to the block holding the codec warm-up before seek_sample,
+ * parsing block headers without decoding. The caller decodes from there. */
+void seek_layout_blocked(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int warmup = get_vgmstream_seek_warmup(vgmstream);
+    int32_t skip_sample;
+    size_t file_size;
+
+    if (warmup < 0)
+        return;
+
+    skip_sample = seek_sample - warmup;
+    file_size = get_streamfile_size(vgmstream->ch[0].streamfile);
+
+    /* known blocks first, then walk (and learn) the rest */
+    block_index_jump(vgmstream, skip_sample);
+
+    while (1) {
+        int frame_size = get_vgmstream_frame_size(vgmstream);
+        int samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+        int samples_this_block = get_block_samples(vgmstream, frame_size, samples_per_frame);
+        int32_t block_end = vgmstream->current_sample - vgmstream->samples_into_block + samples_this_block;
+        off_t block_offset = vgmstream->current_block_offset;
+        size_t full_block_size = vgmstream->full_block_size;
+
+        if (block_end > skip_sample || samples_this_block < 0)
+            break;
+        /* same checks as the renderer, plus not getting stuck in empty blocks at EOF */
+        if (vgmstream->current_block_offset < 0 || vgmstream->current_block_offset == 0xFFFFFFFF)
+            break;
+        if (vgmstream->next_block_offset <= vgmstream->current_block_offset || vgmstream->next_block_offset >= file_size)
+            break;
+
+        block_update(vgmstream->next_block_offset, vgmstream);
+        vgmstream->current_sample = block_end;
+        vgmstream->samples_into_block = 0;
+        block_index_add(vgmstream, block_offset, block_end - samples_this_block, full_block_size);
+    }
+}
+
 /* helper functions to parse new block */
 void block_update(off_t block_offset, VGMSTREAM * vgmstream) {
     switch (vgmstream->layout_type) {
@@ -38,3 +38,21 @@ void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM *
         vgmstream->samples_into_block += samples_to_do;
     }
 }
+
+/* Moves a flat stream forward to a frame near seek_sample, leaving codec warm-up samples to be
+ * decoded by the caller. Decoders find frames from samples_into_block so no offsets change. */
+void seek_layout_flat(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+    int warmup = get_vgmstream_seek_warmup(vgmstream);
+    int32_t skip_sample;
+
+    if (warmup < 0 || samples_per_frame <= 0)
+        return;
+
+    skip_sample = (seek_sample - warmup) / samples_per_frame * samples_per_frame;
+    if (skip_sample <= vgmstream->current_sample)
+        return;
+
+    vgmstream->samples_into_block += skip_sample - vgmstream->current_sample;
+    vgmstream->current_sample = skip_sample;
+}
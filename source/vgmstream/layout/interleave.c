@@ -147,3 +147,40 @@ fail:
     VGM_LOG("layout_interleave: wrong values found\n");
     memset(buffer + samples_written*vgmstream->channels, 0, (sample_count - samples_written) * vgmstream->channels * sizeof(sample_t));
 }
+
+/* Moves an interleaved stream forward to a frame near seek_sample, leaving codec warm-up samples to
+ * be decoded by the caller. Whole interleave blocks are skipped by moving channel offsets. */
+void seek_layout_interleave(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int frame_size = get_vgmstream_frame_size(vgmstream);
+    int samples_per_frame = get_vgmstream_samples_per_frame(vgmstream);
+    int warmup = get_vgmstream_seek_warmup(vgmstream);
+    int samples_this_block;
+    int32_t skip_sample, block_start, skip_block_start;
+    int ch;
+
+    /* first/last blocks have their own sizes, let the caller decode through them */
+    if (vgmstream->interleave_first_block_size || vgmstream->interleave_last_block_size)
+        return;
+    if (warmup < 0 || frame_size == 0 || samples_per_frame <= 0)
+        return;
+
+    samples_this_block = vgmstream->interleave_block_size / frame_size * samples_per_frame;
+    if (samples_this_block == 0 && vgmstream->channels == 1)
+        samples_this_block = vgmstream->num_samples;
+    if (samples_this_block <= 0)
+        return;
+
+    skip_sample = (seek_sample - warmup) / samples_per_frame * samples_per_frame;
+    if (skip_sample <= vgmstream->current_sample)
+        return;
+
+    block_start = vgmstream->current_sample - vgmstream->samples_into_block;
+    skip_block_start = skip_sample / samples_this_block * samples_this_block;
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        vgmstream->ch[ch].offset += (off_t)(skip_block_start - block_start) / samples_this_block
+                * vgmstream->interleave_block_size * vgmstream->channels;
+    }
+
+    vgmstream->current_sample = skip_sample;
+    vgmstream->samples_into_block = skip_sample - skip_block_start;
+}
@@ -1,6 +1,10 @@
 #include "layout.h"
 #include "../vgmstream.h"
 #include "../mixing.h"
+#include "../util.h"
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
 
 
 /* NOTE: if loop settings change the layered vgmstreams must be notified (preferably using vgmstream_force_loop) */
@@ -8,6 +12,152 @@
 #define VGMSTREAM_LAYER_SAMPLE_BUFFER 8192
 
 
+#ifdef VGM_USE_THREADS
+/* Layers are independent so they can decode at the same time: render calls are split into jobs
+ * (one per layer, each into its own part of the buffer) picked by a small pool of workers plus
+ * the rendering thread. The pool is shared by all layered streams but runs one render at a time,
+ * other callers (or nested layered streams) just decode their layers serially. */
+#define LAYER_WORKERS 2                 /* max, plus the rendering thread */
+#define LAYER_PARALLEL_MIN_SAMPLES 256  /* smaller renders aren't worth waking workers */
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;            /* a render has layers left */
+    pthread_cond_t done;            /* a layer finished */
+    int started;
+    layered_layout_data *data;      /* current render, NULL if idle */
+    int32_t samples_to_do;
+    int next_layer;                 /* first layer not picked yet */
+    int pending;                    /* layers not finished yet */
+} layer_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, NULL, 0, 0, 0 };
+#endif
+
+static sample_t * get_layer_buffer(layered_layout_data *data, int layer) {
+    int i, offset = 0;
+
+    for (i = 0; i < layer; i++) {
+        int layer_input_channels;
+        mixing_info(data->layers[i], &layer_input_channels, NULL);
+        offset += layer_input_channels;
+    }
+
+    return data->buffer + offset * VGMSTREAM_LAYER_SAMPLE_BUFFER;
+}
+
+static void render_layer(layered_layout_data *data, int layer, int32_t samples_to_do) {
+    /* each layer will handle its own looping/mixing internally */
+    render_vgmstream(get_layer_buffer(data, layer), samples_to_do, data->layers[layer]);
+}
+
+#ifdef VGM_USE_THREADS
+/* picks and renders layers until none are left (lock must be held) */
+static void layer_pool_run(void) {
+    while (layer_pool.data && layer_pool.next_layer < layer_pool.data->layer_count) {
+        layered_layout_data *data = layer_pool.data;
+        int32_t samples_to_do = layer_pool.samples_to_do;
+        int layer = layer_pool.next_layer++;
+
+        pthread_mutex_unlock(&layer_pool.lock);
+        render_layer(data, layer, samples_to_do);
+        pthread_mutex_lock(&layer_pool.lock);
+
+        layer_pool.pending--;
+        if (layer_pool.pending == 0)
+            pthread_cond_broadcast(&layer_pool.done);
+    }
+}
+
+static void * layer_pool_thread(void * arg) {
+    set_worker_thread_core((int)(intptr_t)arg);
+
+    pthread_mutex_lock(&layer_pool.lock);
+    while (1) {
+        layer_pool_run();
+        pthread_cond_wait(&layer_pool.work, &layer_pool.lock);
+    }
+    return NULL;
+}
+
+/* renders all layers with the pool, returns 0 if it's busy (or can't start) */
+static int render_layers_parallel(layered_layout_data *data, int32_t samples_to_do) {
+    int i, workers;
+
+    pthread_mutex_lock(&layer_pool.lock);
+
+    /* start workers on first use (they live for the whole process) */
+    if (!layer_pool.started) {
+        workers = get_worker_thread_count(LAYER_WORKERS);
+        for (i = 0; i < workers; i++) {
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, layer_pool_thread, (void*)(intptr_t)i) == 0) {
+                pthread_detach(thread);
+                layer_pool.started++;
+            }
+        }
+        if (!layer_pool.started)
+            layer_pool.started = -1; /* don't retry */
+    }
+
+    if (layer_pool.started < 0 || layer_pool.data) {
+        pthread_mutex_unlock(&layer_pool.lock);
+        return 0;
+    }
+
+    layer_pool.data = data;
+    layer_pool.samples_to_do = samples_to_do;
+    layer_pool.next_layer = 0;
+    layer_pool.pending = data->layer_count;
+    pthread_cond_broadcast(&layer_pool.work);
+
+    /* help instead of waiting */
+    layer_pool_run();
+    while (layer_pool.pending > 0) {
+        pthread_cond_wait(&layer_pool.done, &layer_pool.lock);
+    }
+    layer_pool.data = NULL;
+
+    pthread_mutex_unlock(&layer_pool.lock);
+    return 1;
+}
+#endif
+
+/* copies each layer's samples to its channels in the main buffer, in one pass over the output */
+static void interleave_layers(sample_t * outbuf, int32_t samples_to_do, layered_layout_data *data) {
+    const sample_t *layer_buf[VGMSTREAM_MAX_LAYERS];
+    int layer_channels[VGMSTREAM_MAX_LAYERS];
+    int s, layer, ch;
+
+    for (layer = 0; layer < data->layer_count; layer++) {
+        /* layers may have its own number of channels */
+        mixing_info(data->layers[layer], NULL, &layer_channels[layer]);
+        layer_buf[layer] = get_layer_buffer(data, layer);
+    }
+
+    for (s = 0; s < samples_to_do; s++) {
+        sample_t *out = outbuf + s * data->output_channels;
+
+        for (layer = 0; layer < data->layer_count; layer++) {
+            const sample_t *in = layer_buf[layer] + s * layer_channels[layer];
+
+            switch(layer_channels[layer]) {
+                case 2: /* most common */
+                    out[0] = in[0];
+                    out[1] = in[1];
+                    break;
+                case 1:
+                    out[0] = in[0];
+                    break;
+                default:
+                    for (ch = 0; ch < layer_channels[layer]; ch++) {
+                        out[ch] = in[ch];
+                    }
+                    break;
+            }
+            out += layer_channels[layer];
+        }
+    }
+}
+
 /* Decodes samples for layered streams.
  * Similar to interleave layout, but decodec samples are mixed from complete vgmstreams, each
  * with custom codecs and different number of channels, creating a single super-vgmstream.
@@ -19,36 +169,24 @@ void render_vgmstream_layered(sample_t * outbuf, int32_t sample_count, VGMSTREAM
 
     while (samples_written < sample_count) {
         int samples_to_do = VGMSTREAM_LAYER_SAMPLE_BUFFER;
-        int layer, ch = 0;
+        int layer, done = 0;
 
         if (samples_to_do > sample_count - samples_written)
             samples_to_do = sample_count - samples_written;
 
-        for (layer = 0; layer < data->layer_count; layer++) {
-            int s, layer_ch, layer_channels;
-
-            /* each layer will handle its own looping/mixing internally */
-
-            /* layers may have its own number of channels */
-            mixing_info(data->layers[layer], NULL, &layer_channels);
-
-            render_vgmstream(
-                    data->buffer,
-                    samples_to_do,
-                    data->layers[layer]);
-
-            /* mix layer samples to main samples */
-            for (layer_ch = 0; layer_ch < layer_channels; layer_ch++) {
-                for (s = 0; s < samples_to_do; s++) {
-                    size_t layer_sample = s*layer_channels + layer_ch;
-                    size_t buffer_sample = (samples_written+s)*data->output_channels + ch;
-
-                    outbuf[buffer_sample] = data->buffer[layer_sample];
-                }
-                ch++;
+#ifdef VGM_USE_THREADS
+        if (data->layer_count > 1 && samples_to_do >= LAYER_PARALLEL_MIN_SAMPLES)
+            done = render_layers_parallel(data, samples_to_do);
+#endif
+        if (!done) {
+            for (layer = 0; layer < data->layer_count; layer++) {
+                render_layer(data, layer, samples_to_do);
             }
         }
 
+        /* mix layer samples to main samples */
+        interleave_layers(outbuf + samples_written * data->output_channels, samples_to_do, data);
+
         samples_written += samples_to_do;
         /* needed for info (ex. for mixing) */
         vgmstream->current_sample = data->layers[0]->current_sample;
@@ -79,7 +217,7 @@ fail:
 }
 
 int setup_layout_layered(layered_layout_data* data) {
-    int i, max_input_channels = 0, max_output_channels = 0;
+    int i, max_input_channels = 0, max_output_channels = 0, total_input_channels = 0;
     sample_t *outbuf_re = NULL;
 
 
@@ -101,6 +239,7 @@ int setup_layout_layered(layered_layout_data* data) {
         mixing_info(data->layers[i], &layer_input_channels, &layer_output_channels);
 
         max_output_channels += layer_output_channels;
+        total_input_channels += layer_input_channels;
         if (max_input_channels < layer_input_channels)
             max_input_channels = layer_input_channels;
 
@@ -127,12 +266,12 @@ int setup_layout_layered(layered_layout_data* data) {
     if (max_output_channels > VGMSTREAM_MAX_CHANNELS || max_input_channels > VGMSTREAM_MAX_CHANNELS)
         goto fail;
 
-    /* create internal buffer big enough for mixing */
-    outbuf_re = realloc(data->buffer, VGMSTREAM_LAYER_SAMPLE_BUFFER*max_input_channels*sizeof(sample_t));
+    /* create internal buffer big enough for mixing, with a part per layer so they can decode at once */
+    outbuf_re = realloc(data->buffer, VGMSTREAM_LAYER_SAMPLE_BUFFER*total_input_channels*sizeof(sample_t));
     if (!outbuf_re) goto fail;
     data->buffer = outbuf_re;
 
-    data->input_channels = max_input_channels;
+    data->input_channels = total_input_channels;
     data->output_channels = max_output_channels;
 
     return 1;
@@ -152,6 +291,7 @@ void free_layout_layered(layered_layout_data *data) {
         }
         free(data->layers);
     }
+    free(data->buffer);
     free(data);
 }
 
@@ -166,6 +306,19 @@ void reset_layout_layered(layered_layout_data *data) {
     }
 }
 
+/* Seeks every layer to the same play position (each layer handles its own looping). */
+void seek_layout_layered(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    layered_layout_data *data = vgmstream->layout_data;
+    int i;
+
+    for (i = 0; i < data->layer_count; i++) {
+        seek_vgmstream(data->layers[i], seek_sample);
+    }
+
+    vgmstream->current_sample = data->layers[0]->current_sample;
+    vgmstream->loop_count = data->layers[0]->loop_count;
+}
+
 /* helper for easier creation of layers */
 VGMSTREAM *allocate_layered_vgmstream(layered_layout_data* data) {
     VGMSTREAM *vgmstream = NULL;
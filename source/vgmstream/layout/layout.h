@@ -7,6 +7,9 @@
 /* blocked layouts */
 void render_vgmstream_blocked(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 void block_update(off_t block_offset, VGMSTREAM * vgmstream);
+void seek_layout_blocked(VGMSTREAM * vgmstream, int32_t seek_sample);
+void block_index_init(VGMSTREAM * vgmstream);
+void block_index_close(VGMSTREAM * vgmstream);
 
 void block_update_ast(off_t block_ofset, VGMSTREAM * vgmstream);
 void block_update_mxch(off_t block_ofset, VGMSTREAM * vgmstream);
@@ -49,14 +52,17 @@ void block_update_vs_square(off_t block_offset, VGMSTREAM * vgmstream);
 
 /* other layouts */
 void render_vgmstream_interleave(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+void seek_layout_interleave(VGMSTREAM * vgmstream, int32_t seek_sample);
 
 void render_vgmstream_flat(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+void seek_layout_flat(VGMSTREAM * vgmstream, int32_t seek_sample);
 
 void render_vgmstream_segmented(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 segmented_layout_data* init_layout_segmented(int segment_count);
 int setup_layout_segmented(segmented_layout_data* data);
 void free_layout_segmented(segmented_layout_data *data);
 void reset_layout_segmented(segmented_layout_data *data);
+void seek_layout_segmented(VGMSTREAM * vgmstream, int32_t seek_sample);
 VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_flag, int loop_start_segment, int loop_end_segment);
 
 void render_vgmstream_layered(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
@@ -64,6 +70,7 @@ layered_layout_data* init_layout_layered(int layer_count);
 int setup_layout_layered(layered_layout_data* data);
 void free_layout_layered(layered_layout_data *data);
 void reset_layout_layered(layered_layout_data *data);
+void seek_layout_layered(VGMSTREAM * vgmstream, int32_t seek_sample);
 VGMSTREAM *allocate_layered_vgmstream(layered_layout_data* data);
 
 #endif
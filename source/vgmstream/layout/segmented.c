@@ -1,9 +1,191 @@
 #include "layout.h"
 #include "../vgmstream.h"
 #include "../mixing.h"
+#include "../util.h"
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
 
 #define VGMSTREAM_MAX_SEGMENTS 512
 #define VGMSTREAM_SEGMENT_SAMPLE_BUFFER 8192
+#define VGMSTREAM_SEGMENT_PREFETCH_SAMPLES 4096
+
+enum { PREFETCH_NONE, PREFETCH_QUEUED, PREFETCH_RUNNING, PREFETCH_READY };
+
+#ifdef VGM_USE_THREADS
+/* Changing segments resets the next one right when its samples are due (reopening codecs, first
+ * reads from slow storage), so a worker does it ahead: while a segment plays, the next one is reset
+ * and its first samples decoded into a small buffer, which is used when the change happens.
+ * The worker is shared by all segmented streams (one prefetch at a time, in request order) and
+ * lives for the whole process. Only the rendering thread requests, claims or drops a prefetch, and
+ * must settle it before touching that segment. */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;            /* queue has requests */
+    pthread_cond_t done;            /* a prefetch finished */
+    int started;
+    segmented_layout_data *head;
+    segmented_layout_data *tail;
+} segment_prefetch = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, NULL, NULL };
+
+static void * segment_prefetch_thread(void * arg) {
+    set_worker_thread_core(1);
+
+    pthread_mutex_lock(&segment_prefetch.lock);
+    while (1) {
+        segmented_layout_data *data;
+        VGMSTREAM *segment;
+
+        while (!segment_prefetch.head) {
+            pthread_cond_wait(&segment_prefetch.work, &segment_prefetch.lock);
+        }
+
+        data = segment_prefetch.head;
+        segment_prefetch.head = data->prefetch_next;
+        if (!segment_prefetch.head)
+            segment_prefetch.tail = NULL;
+        data->prefetch_next = NULL;
+        data->prefetch_state = PREFETCH_RUNNING;
+        segment = data->segments[data->prefetch_segment];
+        pthread_mutex_unlock(&segment_prefetch.lock);
+
+        reset_vgmstream(segment);
+        render_vgmstream(data->prefetch_buffer, data->prefetch_samples, segment);
+
+        pthread_mutex_lock(&segment_prefetch.lock);
+        data->prefetch_state = PREFETCH_READY;
+        pthread_cond_broadcast(&segment_prefetch.done);
+    }
+    return NULL;
+}
+
+/* takes a queued prefetch back or waits for a running one */
+static void prefetch_settle(segmented_layout_data *data) {
+    pthread_mutex_lock(&segment_prefetch.lock);
+    if (data->prefetch_state == PREFETCH_QUEUED) {
+        segmented_layout_data *prev = NULL, *cur = segment_prefetch.head;
+
+        while (cur != data) {
+            prev = cur;
+            cur = cur->prefetch_next;
+        }
+        if (prev)
+            prev->prefetch_next = data->prefetch_next;
+        else
+            segment_prefetch.head = data->prefetch_next;
+        if (segment_prefetch.tail == data)
+            segment_prefetch.tail = prev;
+        data->prefetch_next = NULL;
+        data->prefetch_state = PREFETCH_NONE;
+    }
+    while (data->prefetch_state == PREFETCH_RUNNING) {
+        pthread_cond_wait(&segment_prefetch.done, &segment_prefetch.lock);
+    }
+    pthread_mutex_unlock(&segment_prefetch.lock);
+}
+
+/* queues the segment after the current one, if there is none pending */
+static void prefetch_request(segmented_layout_data *data) {
+    int next = data->current_segment + 1;
+
+    if (data->prefetch_buffer || next >= data->segment_count)
+        return;
+    /* repeated segments are the same VGMSTREAM, still playing */
+    if (data->segments[next] == data->segments[data->current_segment])
+        return;
+
+    pthread_mutex_lock(&segment_prefetch.lock);
+
+    /* start the worker on first use */
+    if (!segment_prefetch.started) {
+        pthread_t thread;
+        segment_prefetch.started = -1; /* don't retry */
+        if (get_worker_thread_count(1) > 0 && pthread_create(&thread, NULL, segment_prefetch_thread, NULL) == 0) {
+            pthread_detach(thread);
+            segment_prefetch.started = 1;
+        }
+    }
+    if (segment_prefetch.started < 0) {
+        pthread_mutex_unlock(&segment_prefetch.lock);
+        return;
+    }
+
+    data->prefetch_buffer = malloc(VGMSTREAM_SEGMENT_PREFETCH_SAMPLES * data->input_channels * sizeof(sample_t));
+    if (!data->prefetch_buffer) {
+        pthread_mutex_unlock(&segment_prefetch.lock);
+        return;
+    }
+    data->prefetch_segment = next;
+    data->prefetch_samples = data->segments[next]->num_samples;
+    if (data->prefetch_samples > VGMSTREAM_SEGMENT_PREFETCH_SAMPLES)
+        data->prefetch_samples = VGMSTREAM_SEGMENT_PREFETCH_SAMPLES;
+    data->prefetch_used = 0;
+    data->prefetch_state = PREFETCH_QUEUED;
+
+    if (segment_prefetch.tail)
+        segment_prefetch.tail->prefetch_next = data;
+    else
+        segment_prefetch.head = data;
+    segment_prefetch.tail = data;
+    pthread_cond_signal(&segment_prefetch.work);
+
+    pthread_mutex_unlock(&segment_prefetch.lock);
+}
+#else
+static void prefetch_settle(segmented_layout_data *data) { }
+static void prefetch_request(segmented_layout_data *data) { }
+#endif
+
+/* discards any prefetch (the segment is left wherever it was decoded up to) */
+static void prefetch_drop(segmented_layout_data *data) {
+    prefetch_settle(data);
+
+    free(data->prefetch_buffer);
+    data->prefetch_buffer = NULL;
+    data->prefetch_state = PREFETCH_NONE;
+}
+
+/* on segment change: keeps the prefetch if it's for the new segment, otherwise the caller resets it */
+static int prefetch_claim(segmented_layout_data *data) {
+    if (!data->prefetch_buffer)
+        return 0;
+
+    prefetch_settle(data);
+    if (data->prefetch_state == PREFETCH_READY && data->prefetch_segment == data->current_segment)
+        return 1;
+
+    prefetch_drop(data);
+    return 0;
+}
+
+/* copies claimed samples of the current segment, returns how many */
+static int32_t prefetch_copy(segmented_layout_data *data, sample_t * outbuf, int32_t samples_to_do) {
+    int32_t samples_left = data->prefetch_samples - data->prefetch_used;
+
+    if (samples_to_do > samples_left)
+        samples_to_do = samples_left;
+
+    memcpy(outbuf, data->prefetch_buffer + data->prefetch_used * data->output_channels,
+            samples_to_do * data->output_channels * sizeof(sample_t));
+    data->prefetch_used += samples_to_do;
+
+    if (data->prefetch_used == data->prefetch_samples)
+        prefetch_drop(data);
+    return samples_to_do;
+}
+
+/* frees the mixing buffer of a segment that is done playing (segments may repeat, so
+ * one that is still current or being prefetched keeps it) */
+static void segment_release(segmented_layout_data *data, int segment) {
+    VGMSTREAM *vgmstream = data->segments[segment];
+
+    if (vgmstream == data->segments[data->current_segment])
+        return;
+    if (data->prefetch_buffer && vgmstream == data->segments[data->prefetch_segment])
+        return;
+
+    mixing_release(vgmstream);
+}
 
 
 /* Decodes samples for segmented streams.
@@ -24,6 +206,7 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
     while (samples_written < sample_count) {
         int samples_to_do;
         int samples_this_segment = data->segments[data->current_segment]->num_samples;
+        sample_t * buf;
 
         if (vgmstream->loop_flag && vgmstream_do_loop(vgmstream)) {
             int segment, loop_segment, total_samples;
@@ -47,7 +230,10 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
                 loop_segment = 0;
             }
 
+            prefetch_drop(data);
+            segment = data->current_segment;
             data->current_segment = loop_segment;
+            segment_release(data, segment);
 
             /* loops can span multiple segments */
             for (segment = loop_segment; segment < data->segment_count; segment++) {
@@ -70,20 +256,27 @@ void render_vgmstream_segmented(sample_t * outbuf, int32_t sample_count, VGMSTRE
                 samples_to_do = loop_samples_skip;
         }
 
-        /* detect segment change and restart */
+        /* detect segment change and restart (unless the worker already did) */
         if (samples_to_do == 0) {
             data->current_segment++;
-            reset_vgmstream(data->segments[data->current_segment]);
+            if (!prefetch_claim(data))
+                reset_vgmstream(data->segments[data->current_segment]);
+            segment_release(data, data->current_segment - 1);
             vgmstream->samples_into_block = 0;
             continue;
         }
 
-        render_vgmstream(
-                use_internal_buffer ?
-                        data->buffer :
-                        &outbuf[samples_written * data->output_channels],
-                samples_to_do,
-                data->segments[data->current_segment]);
+        buf = use_internal_buffer ?
+                data->buffer :
+                &outbuf[samples_written * data->output_channels];
+
+        if (data->prefetch_buffer && data->prefetch_segment == data->current_segment) {
+            samples_to_do = prefetch_copy(data, buf, samples_to_do);
+        }
+        else {
+            render_vgmstream(buf, samples_to_do, data->segments[data->current_segment]);
+            prefetch_request(data);
+        }
 
         if (loop_samples_skip > 0) {
             loop_samples_skip -= samples_to_do;
@@ -186,6 +379,11 @@ int setup_layout_segmented(segmented_layout_data* data) {
         mixing_setup(data->segments[i], VGMSTREAM_SEGMENT_SAMPLE_BUFFER); /* init mixing */
     }
 
+    /* only the playing segment needs a mixing buffer, others remake theirs when reached */
+    for (i = 1; i < data->segment_count; i++) {
+        segment_release(data, i);
+    }
+
     if (max_output_channels > VGMSTREAM_MAX_CHANNELS || max_input_channels > VGMSTREAM_MAX_CHANNELS)
         goto fail;
 
@@ -208,6 +406,8 @@ void free_layout_segmented(segmented_layout_data *data) {
     if (!data)
         return;
 
+    prefetch_drop(data);
+
     if (data->segments) {
         for (i = 0; i < data->segment_count; i++) {
             int is_repeat = 0;
@@ -233,12 +433,38 @@ void reset_layout_segmented(segmented_layout_data *data) {
     if (!data)
         return;
 
+    prefetch_drop(data);
+
     data->current_segment = 0;
     for (i = 0; i < data->segment_count; i++) {
         reset_vgmstream(data->segments[i]);
     }
 }
 
+/* Moves a segmented stream forward to seek_sample, skipping whole segments and seeking inside
+ * the one that holds it (earlier segments don't need to be decoded). */
+void seek_layout_segmented(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    segmented_layout_data *data = vgmstream->layout_data;
+    int32_t segment_start = vgmstream->current_sample - vgmstream->samples_into_block;
+
+    /* the worker may be using a segment that's about to be seeked */
+    prefetch_drop(data);
+
+    if (seek_sample <= vgmstream->current_sample)
+        return;
+
+    while (data->current_segment + 1 < data->segment_count &&
+            seek_sample >= segment_start + data->segments[data->current_segment]->num_samples) {
+        segment_start += data->segments[data->current_segment]->num_samples;
+        data->current_segment++;
+        segment_release(data, data->current_segment - 1);
+    }
+
+    seek_vgmstream(data->segments[data->current_segment], seek_sample - segment_start);
+    vgmstream->current_sample = seek_sample;
+    vgmstream->samples_into_block = seek_sample - segment_start;
+}
+
 /* helper for easier creation of segments */
 VGMSTREAM *allocate_segmented_vgmstream(segmented_layout_data* data, int loop_flag, int loop_start_segment, int loop_end_segment) {
     VGMSTREAM *vgmstream = NULL;
@@ -1,7 +1,10 @@
 #include "meta.h"
 #include "fsb_keys.h"
+#include "../key_cache.h"
 
 #define FSB_KEY_MAX 128 /* probably 32 */
+#define FSB_CACHE_ALT   0x01
+#define FSB_CACHE_FSB5  0x02
 
 static STREAMFILE* setup_fsb_streamfile(STREAMFILE *streamFile, const uint8_t * key, size_t key_size, int is_alt);
 
@@ -51,6 +54,29 @@ VGMSTREAM * init_vgmstream_fsb_encrypted(STREAMFILE * streamFile) {
     }
 
 
+    /* try the key that worked for other files in this folder */
+    if (!vgmstream) {
+        STREAMFILE *temp_streamFile = NULL;
+        uint8_t key[FSB_KEY_MAX];
+        uint32_t flags = 0;
+        size_t key_size = key_cache_get(streamFile, KEY_CACHE_FSB, key, FSB_KEY_MAX, &flags);
+
+        if (key_size) {
+            temp_streamFile = setup_fsb_streamfile(streamFile, key,key_size, (flags & FSB_CACHE_ALT) != 0);
+        }
+
+        /* if it can't be used the key list below is still tried */
+        if (temp_streamFile) {
+            if (flags & FSB_CACHE_FSB5) {
+                vgmstream = init_vgmstream_fsb5(temp_streamFile);
+            } else {
+                vgmstream = init_vgmstream_fsb(temp_streamFile);
+            }
+
+            close_streamfile(temp_streamFile);
+        }
+    }
+
     /* try all keys until one works */
     if (!vgmstream) {
         int i;
@@ -70,7 +96,11 @@ VGMSTREAM * init_vgmstream_fsb_encrypted(STREAMFILE * streamFile) {
             }
 
             close_streamfile(temp_streamFile);
-            if (vgmstream) break;
+            if (vgmstream) {
+                uint32_t flags = (entry.is_alt ? FSB_CACHE_ALT : 0) | (entry.is_fsb5 ? FSB_CACHE_FSB5 : 0);
+                key_cache_set(streamFile, KEY_CACHE_FSB, entry.fsbkey, entry.fsbkey_size, flags);
+                break;
+            }
         }
     }
 
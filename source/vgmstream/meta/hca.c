@@ -1,8 +1,9 @@
 #include "meta.h"
 #include "hca_keys.h"
 #include "../coding/coding.h"
+#include "../key_cache.h"
 
-static void find_hca_key(hca_codec_data * hca_data, unsigned long long * out_keycode, uint16_t subkey);
+static void find_hca_key(STREAMFILE *streamFile, hca_codec_data * hca_data, unsigned long long * out_keycode, uint16_t subkey);
 
 VGMSTREAM * init_vgmstream_hca(STREAMFILE *streamFile) {
     return init_vgmstream_hca_subkey(streamFile, 0x0000);
@@ -42,7 +43,7 @@ VGMSTREAM * init_vgmstream_hca_subkey(STREAMFILE *streamFile, uint16_t subkey) {
             keycode = file_key * ( ((uint64_t)file_sub << 16u) | ((uint16_t)~file_sub + 2u) );
         }
         else {
-            find_hca_key(hca_data, &keycode, subkey);
+            find_hca_key(streamFile, hca_data, &keycode, subkey);
         }
 
         clHCA_SetKey(hca_data->handle, keycode); //maybe should be done through hca_decoder.c?
@@ -104,59 +105,113 @@ fail:
 }
 
 
-static inline void test_key(hca_codec_data * hca_data, uint64_t key, uint16_t subkey, int *best_score, uint64_t *best_keycode) {
-    int score;
-
+static uint64_t get_subkey_keycode(uint64_t key, uint16_t subkey) {
     if (subkey) {
         key = key * ( ((uint64_t)subkey << 16u) | ((uint16_t)~subkey + 2u) );
     }
-
-    score = test_hca_key(hca_data, (unsigned long long)key);
-
-    //;VGM_LOG("HCA: test key=%08x%08x, subkey=%04x, score=%i\n",
-    //        (uint32_t)((key >> 32) & 0xFFFFFFFF), (uint32_t)(key & 0xFFFFFFFF), subkey, score);
-
-    /* wrong key */
-    if (score < 0)
-        return;
-
-    /* update if something better is found */
-    if (*best_score <= 0 || (score < *best_score && score > 0)) {
-        *best_score = score;
-        *best_keycode = key;
-    }
+    return key;
 }
 
 /* Try to find the decryption key from a list. */
-static void find_hca_key(hca_codec_data * hca_data, unsigned long long * out_keycode, uint16_t subkey) {
+static void find_hca_key(STREAMFILE *streamFile, hca_codec_data * hca_data, unsigned long long * out_keycode, uint16_t subkey) {
     const size_t keys_length = sizeof(hcakey_list) / sizeof(hcakey_info);
-    int best_score = -1;
-    int i,j;
+    unsigned long long *keycodes = NULL;
+    uint64_t *basekeys = NULL;
+    int *scores = NULL;
+    int best_score = -1, best_index = -1;
+    int i, j, pass, count = 0, tested;
+    uint8_t cachebuf[0x10];
+    uint64_t cached_basekey = 0;
+    int has_cached = 0;
 
     *out_keycode = 0xCC55463930DBE1AB; /* defaults to PSO2 key, most common */
 
-    /* find a candidate key */
+    /* other files in the folder likely use the same key (cached as final key + list key) */
+    if (key_cache_get(streamFile, KEY_CACHE_HCA, cachebuf, sizeof(cachebuf), NULL) == sizeof(cachebuf)) {
+        unsigned long long cached_keycode = (uint64_t)get_64bitBE(cachebuf+0x00);
+        int score;
+
+        if (test_hca_keys(hca_data, &cached_keycode, 1, &score) == 1 && score == 1) {
+            *out_keycode = cached_keycode;
+            return;
+        }
+
+        /* subkey may vary per file, but try that key's subkeys first */
+        cached_basekey = (uint64_t)get_64bitBE(cachebuf+0x08);
+        has_cached = 1;
+    }
+
+    /* list candidate keys in test order: each key with external subkey (if any), then its subkey list */
     for (i = 0; i < keys_length; i++) {
-        uint64_t key = hcakey_list[i].key;
-        size_t subkeys_size = hcakey_list[i].subkeys_size;
-        const uint16_t *subkeys = hcakey_list[i].subkeys;
-
-        /* try once with external subkey, if any */
-        test_key(hca_data, key, subkey, &best_score, out_keycode);
-        if (best_score == 1) /* best possible score */
-            goto done;
-
-        /* try subkey list */
-        if (subkeys_size > 0 && subkey == 0) {
-            for (j = 0; j < subkeys_size; j++) {
-                test_key(hca_data, key, subkeys[j], &best_score, out_keycode);
-                if (best_score == 1) /* best possible score */
-                    goto done;
+        count += 1;
+        if (hcakey_list[i].subkeys_size > 0 && subkey == 0)
+            count += hcakey_list[i].subkeys_size;
+    }
+
+    keycodes = malloc(count * sizeof(unsigned long long));
+    basekeys = malloc(count * sizeof(uint64_t));
+    scores = malloc(count * sizeof(int));
+    if (!keycodes || !basekeys || !scores) goto done;
+
+    count = 0;
+    for (pass = 0; pass < 2; pass++) {
+        for (i = 0; i < keys_length; i++) {
+            uint64_t key = hcakey_list[i].key;
+            size_t subkeys_size = hcakey_list[i].subkeys_size;
+            const uint16_t *subkeys = hcakey_list[i].subkeys;
+            int is_cached = has_cached && key == cached_basekey;
+
+            /* first pass only adds the cached key */
+            if ((pass == 0) != is_cached)
+                continue;
+
+            basekeys[count] = key;
+            keycodes[count++] = get_subkey_keycode(key, subkey);
+
+            if (subkeys_size > 0 && subkey == 0) {
+                for (j = 0; j < subkeys_size; j++) {
+                    basekeys[count] = key;
+                    keycodes[count++] = get_subkey_keycode(key, subkeys[j]);
+                }
             }
         }
     }
 
+    /* scores are only set up to the first best possible key (if any) */
+    tested = test_hca_keys(hca_data, keycodes, count, scores);
+
+    for (i = 0; i < tested; i++) {
+        int score = scores[i];
+
+        //;VGM_LOG("HCA: test key=%08x%08x, score=%i\n",
+        //        (uint32_t)((keycodes[i] >> 32) & 0xFFFFFFFF), (uint32_t)(keycodes[i] & 0xFFFFFFFF), score);
+
+        /* wrong key */
+        if (score < 0)
+            continue;
+
+        /* update if something better is found */
+        if (best_score <= 0 || (score < best_score && score > 0)) {
+            best_score = score;
+            best_index = i;
+            *out_keycode = keycodes[i];
+        }
+    }
+
+    /* only keys that decode perfectly are remembered */
+    if (best_score == 1) {
+        put_32bitBE(cachebuf+0x00, (uint32_t)(keycodes[best_index] >> 32));
+        put_32bitBE(cachebuf+0x04, (uint32_t)(keycodes[best_index] >> 0));
+        put_32bitBE(cachebuf+0x08, (uint32_t)(basekeys[best_index] >> 32));
+        put_32bitBE(cachebuf+0x0c, (uint32_t)(basekeys[best_index] >> 0));
+        key_cache_set(streamFile, KEY_CACHE_HCA, cachebuf, sizeof(cachebuf), 0);
+    }
+
 done:
+    free(keycodes);
+    free(basekeys);
+    free(scores);
+
     //;VGM_LOG("HCA: best key=%08x%08x (score=%i)\n",
     //        (uint32_t)((*out_keycode >> 32) & 0xFFFFFFFF), (uint32_t)(*out_keycode & 0xFFFFFFFF), best_score);
 
@@ -7,6 +7,14 @@
 #include <math.h>
 #include <limits.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIXING_NEON
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIXING_SSE
+#endif
+
 
 /**
  * Mixing lets vgmstream modify the resulting sample buffer before final output.
@@ -49,9 +57,16 @@
  * mixbuf if it goes first) or add function pointer indexes but isn't too important.
  * Operations are applied once per "step" with 1 sample from all channels to simplify code
  * (and maybe improve memory cache?), though maybe it should call one function per operation.
+ *
+ * To avoid that per-step cost, on setup the chain is also compiled into a plan: runs of linear ops
+ * (swap/add/volume/up/down/killmix) become a single gain matrix, while fades and limits stay as
+ * separate stages. The plan is applied over small blocks of planar floats (so each stage is a
+ * simple vector op over the whole block), with fades turned into per-block gain ramps. Results
+ * may differ from the step path by float rounding only. The step path stays as fallback.
  */
 
 #define VGMSTREAM_MAX_MIXING 128
+#define MIXING_PLAN_BLOCK 256 /* samples per plan pass, small enough to stay in cache */
 
 
 /* mixing info */
@@ -83,6 +98,21 @@ typedef struct {
     int32_t time_post;  /* position after time_end where vol_end applies (-1 = end) */
 } mix_command_data;
 
+/* compiled mixing chain */
+typedef enum {
+    STAGE_MATRIX,
+    STAGE_FADE,
+    STAGE_LIMIT
+} mix_stage_t;
+
+typedef struct {
+    mix_stage_t type;
+    int in_channels;
+    int out_channels;
+    float* matrix;          /* matrix: out_channels rows of in_channels gains */
+    int mix;                /* fade/limit: index in the mixing chain */
+} mix_stage;
+
 typedef struct {
     int mixing_channels;    /* max channels needed to mix */
     int output_channels;    /* resulting channels after mixing */
@@ -90,7 +120,13 @@ typedef struct {
     int mixing_count;       /* mixing number */
     size_t mixing_size;     /* mixing max */
     mix_command_data mixing_chain[VGMSTREAM_MAX_MIXING]; /* effects to apply (could be alloc'ed but to simplify...) */
-    float* mixbuf;          /* internal mixing buffer */
+    float* mixbuf;          /* internal mixing buffer (NULL if released, then alloc'd on next use) */
+    int32_t mixbuf_samples; /* max samples per call, as set on setup */
+
+    mix_stage* plan;        /* compiled chain (NULL if not compiled, then uses the per-step path) */
+    int plan_count;
+    float* planes;          /* 2 sets of mixing_channels planes of MIXING_PLAN_BLOCK samples */
+    float* ramp;            /* fade gains for a block */
 } mixing_data;
 
 
@@ -228,6 +264,325 @@ fail:
     return 0;
 }
 
+/* ******************************************************************* */
+
+/* vector kernels for planar blocks (n is usually a multiple of 4) */
+
+static void mix_scale(float *dst, const float *src, float gain, int n) {
+    int i = 0;
+#if defined(MIXING_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(src + i), g));
+#elif defined(MIXING_SSE)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(src + i), g));
+#endif
+    for (; i < n; i++)
+        dst[i] = src[i] * gain;
+}
+
+static void mix_add(float *dst, const float *src, float gain, int n) {
+    int i = 0;
+#if defined(MIXING_NEON)
+    float32x4_t g = vdupq_n_f32(gain);
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vmlaq_f32(vld1q_f32(dst + i), vld1q_f32(src + i), g));
+#elif defined(MIXING_SSE)
+    __m128 g = _mm_set1_ps(gain);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+#endif
+    for (; i < n; i++)
+        dst[i] = dst[i] + src[i] * gain;
+}
+
+static void mix_ramp(float *dst, const float *ramp, int n) {
+    int i = 0;
+#if defined(MIXING_NEON)
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vmulq_f32(vld1q_f32(dst + i), vld1q_f32(ramp + i)));
+#elif defined(MIXING_SSE)
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_loadu_ps(dst + i), _mm_loadu_ps(ramp + i)));
+#endif
+    for (; i < n; i++)
+        dst[i] = dst[i] * ramp[i];
+}
+
+static void mix_clamp(float *dst, float min, float max, int n) {
+    int i = 0;
+#if defined(MIXING_NEON)
+    float32x4_t vmin = vdupq_n_f32(min), vmax = vdupq_n_f32(max);
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(dst + i, vmaxq_f32(vminq_f32(vld1q_f32(dst + i), vmax), vmin));
+#elif defined(MIXING_SSE)
+    __m128 vmin = _mm_set1_ps(min), vmax = _mm_set1_ps(max);
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(dst + i, _mm_max_ps(_mm_min_ps(_mm_loadu_ps(dst + i), vmax), vmin));
+#endif
+    for (; i < n; i++) {
+        if (dst[i] > max)
+            dst[i] = max;
+        else if (dst[i] < min)
+            dst[i] = min;
+    }
+}
+
+static void free_plan(mixing_data *data) {
+    int i;
+
+    for (i = 0; i < data->plan_count; i++) {
+        free(data->plan[i].matrix);
+    }
+    free(data->plan);
+    free(data->planes);
+    free(data->ramp);
+    data->plan = NULL;
+    data->plan_count = 0;
+    data->planes = NULL;
+    data->ramp = NULL;
+}
+
+static int is_identity(mix_stage *stage) {
+    int row, col;
+
+    if (stage->in_channels != stage->out_channels)
+        return 0;
+    for (row = 0; row < stage->out_channels; row++) {
+        for (col = 0; col < stage->in_channels; col++) {
+            if (stage->matrix[row * stage->in_channels + col] != (row == col ? 1.0f : 0.0f))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* Compiles the chain into stages, simulating channel changes like the step path does. Matrix rows
+ * are kept with mixing_channels stride while building (channels move around) and packed at the end. */
+static int build_plan(mixing_data *data, int input_channels) {
+    int m, ch, channels = input_channels;
+    int stride = data->mixing_channels;
+    mix_stage *stage = NULL; /* current matrix stage */
+    float temp_row[VGMSTREAM_MAX_CHANNELS];
+
+    free_plan(data);
+
+    data->plan = calloc(data->mixing_count + 1, sizeof(mix_stage));
+    data->planes = malloc(2 * data->mixing_channels * MIXING_PLAN_BLOCK * sizeof(float));
+    data->ramp = malloc(MIXING_PLAN_BLOCK * sizeof(float));
+    if (!data->plan || !data->planes || !data->ramp) goto fail;
+
+    for (m = 0; m < data->mixing_count; m++) {
+        mix_command_data *mix = &data->mixing_chain[m];
+        float *rows;
+
+        if (mix->command == MIX_FADE || mix->command == MIX_LIMIT) {
+            stage = &data->plan[data->plan_count++];
+            stage->type = mix->command == MIX_FADE ? STAGE_FADE : STAGE_LIMIT;
+            stage->in_channels = channels;
+            stage->out_channels = channels;
+            stage->mix = m;
+            stage = NULL;
+            continue;
+        }
+
+        if (!stage) {
+            stage = &data->plan[data->plan_count++];
+            stage->type = STAGE_MATRIX;
+            stage->in_channels = channels;
+            stage->matrix = calloc(stride * stride, sizeof(float));
+            if (!stage->matrix) goto fail;
+            for (ch = 0; ch < channels; ch++) {
+                stage->matrix[ch * stride + ch] = 1.0f;
+            }
+        }
+        rows = stage->matrix;
+
+        /* same ops as the step path, but on each output's gains rather than its sample */
+        switch(mix->command) {
+            case MIX_SWAP:
+                memcpy(temp_row, &rows[mix->ch_dst * stride], stride * sizeof(float));
+                memcpy(&rows[mix->ch_dst * stride], &rows[mix->ch_src * stride], stride * sizeof(float));
+                memcpy(&rows[mix->ch_src * stride], temp_row, stride * sizeof(float));
+                break;
+
+            case MIX_ADD:
+                for (ch = 0; ch < stride; ch++) {
+                    rows[mix->ch_dst * stride + ch] += rows[mix->ch_src * stride + ch] * mix->vol;
+                }
+                break;
+
+            case MIX_VOLUME:
+                for (ch = 0; ch < stride * stride; ch++) {
+                    if (mix->ch_dst < 0 || ch / stride == mix->ch_dst)
+                        rows[ch] *= mix->vol;
+                }
+                break;
+
+            case MIX_UPMIX:
+                channels += 1;
+                memmove(&rows[(mix->ch_dst + 1) * stride], &rows[mix->ch_dst * stride], (channels - 1 - mix->ch_dst) * stride * sizeof(float));
+                memset(&rows[mix->ch_dst * stride], 0, stride * sizeof(float));
+                break;
+
+            case MIX_DOWNMIX:
+                channels -= 1;
+                memmove(&rows[mix->ch_dst * stride], &rows[(mix->ch_dst + 1) * stride], (channels - mix->ch_dst) * stride * sizeof(float));
+                break;
+
+            case MIX_KILLMIX:
+                channels = mix->ch_dst;
+                break;
+
+            default:
+                break;
+        }
+
+        stage->out_channels = channels;
+    }
+
+    if (channels != data->output_channels) goto fail;
+
+    /* pack matrices and drop the ones that do nothing */
+    for (m = 0; m < data->plan_count; m++) {
+        mix_stage *st = &data->plan[m];
+        int row;
+
+        if (st->type != STAGE_MATRIX)
+            continue;
+
+        for (row = 0; row < st->out_channels; row++) {
+            memmove(&st->matrix[row * st->in_channels], &st->matrix[row * stride], st->in_channels * sizeof(float));
+        }
+
+        if (is_identity(st)) {
+            free(st->matrix);
+            memmove(st, st + 1, (data->plan_count - m - 1) * sizeof(mix_stage));
+            data->plan_count--;
+            m--;
+        }
+    }
+
+    return 1;
+fail:
+    free_plan(data);
+    return 0;
+}
+
+/* applies the plan to one block of planes, returns the planes with the result */
+static float* apply_plan_block(mixing_data *data, float *cur, int32_t current_subpos, int n) {
+    float *alt = data->planes + (cur == data->planes ? data->mixing_channels * MIXING_PLAN_BLOCK : 0);
+    const float limiter_max = 32767.0f;
+    const float limiter_min = -32768.0f;
+    int i, ch;
+
+    for (i = 0; i < data->plan_count; i++) {
+        mix_stage *stage = &data->plan[i];
+        mix_command_data *mix = &data->mixing_chain[stage->mix];
+        float *temp;
+
+        switch(stage->type) {
+            case STAGE_MATRIX:
+                for (ch = 0; ch < stage->out_channels; ch++) {
+                    const float *row = &stage->matrix[ch * stage->in_channels];
+                    float *dst = alt + ch * MIXING_PLAN_BLOCK;
+                    int src, used = 0;
+
+                    for (src = 0; src < stage->in_channels; src++) {
+                        if (row[src] == 0.0f)
+                            continue;
+                        if (!used)
+                            mix_scale(dst, cur + src * MIXING_PLAN_BLOCK, row[src], n);
+                        else
+                            mix_add(dst, cur + src * MIXING_PLAN_BLOCK, row[src], n);
+                        used = 1;
+                    }
+                    if (!used)
+                        memset(dst, 0, n * sizeof(float));
+                }
+                temp = cur;
+                cur = alt;
+                alt = temp;
+                break;
+
+            case STAGE_FADE: {
+                int s, active = 0;
+
+                for (s = 0; s < n; s++) {
+                    if (get_fade_gain(mix, &data->ramp[s], current_subpos + s))
+                        active = 1;
+                    else
+                        data->ramp[s] = 1.0f;
+                }
+                if (!active)
+                    break;
+
+                for (ch = 0; ch < stage->out_channels; ch++) {
+                    if (mix->ch_dst < 0 || ch == mix->ch_dst)
+                        mix_ramp(cur + ch * MIXING_PLAN_BLOCK, data->ramp, n);
+                }
+                break;
+            }
+
+            case STAGE_LIMIT:
+                for (ch = 0; ch < stage->out_channels; ch++) {
+                    if (mix->ch_dst < 0 || ch == mix->ch_dst)
+                        mix_clamp(cur + ch * MIXING_PLAN_BLOCK, limiter_min * mix->vol, limiter_max * mix->vol, n);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return cur;
+}
+
+static void apply_plan(mixing_data *data, sample_t *outbuf, int32_t sample_count, int input_channels, int32_t current_pos) {
+    int output_channels = data->output_channels;
+    int blocks = (sample_count + MIXING_PLAN_BLOCK - 1) / MIXING_PLAN_BLOCK;
+    int b;
+
+    /* outbuf is read with input_channels and written with output_channels in place, so when
+     * upmixing go backwards to avoid overwriting samples of blocks not read yet */
+    for (b = 0; b < blocks; b++) {
+        int block = output_channels > input_channels ? blocks - 1 - b : b;
+        int32_t start = block * MIXING_PLAN_BLOCK;
+        int n = sample_count - start < MIXING_PLAN_BLOCK ? sample_count - start : MIXING_PLAN_BLOCK;
+        sample_t *buf = outbuf + start * input_channels;
+        float *planes = data->planes;
+        int s, ch;
+
+        for (ch = 0; ch < input_channels; ch++) {
+            float *plane = planes + ch * MIXING_PLAN_BLOCK;
+            for (s = 0; s < n; s++) {
+                plane[s] = buf[s * input_channels + ch];
+            }
+        }
+
+        planes = apply_plan_block(data, planes, current_pos + start, n);
+
+        buf = outbuf + start * output_channels;
+        for (ch = 0; ch < output_channels; ch++) {
+            float *plane = planes + ch * MIXING_PLAN_BLOCK;
+#ifdef VGM_SAMPLE_INT16
+            /* float to int truncates like the step path, clamping before avoids overflowing the cast */
+            mix_clamp(plane, -32768.0f, 32767.0f, n);
+            for (s = 0; s < n; s++) {
+                buf[s * output_channels + ch] = (int32_t)plane[s];
+            }
+#else
+            for (s = 0; s < n; s++) {
+                buf[s * output_channels + ch] = float_to_sample(plane[s]);
+            }
+#endif
+        }
+    }
+}
+
 void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream) {
     mixing_data *data = vgmstream->mixing_data;
     int ch, s, m, ok;
@@ -250,6 +605,17 @@ void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream)
     if (!is_active(data, current_pos, current_pos + sample_count))
         return;
 
+    if (data->plan) {
+        apply_plan(data, outbuf, sample_count, vgmstream->channels, current_pos);
+        return;
+    }
+
+
+    /* buffer may have been released while idle */
+    if (!data->mixbuf) {
+        data->mixbuf = malloc(data->mixbuf_samples*data->mixing_channels*sizeof(float));
+        if (!data->mixbuf) return;
+    }
 
     /* use advancing buffer pointers to simplify logic */
     temp_mixbuf = data->mixbuf;
@@ -376,8 +742,9 @@ void mix_vgmstream(sample_t *outbuf, int32_t sample_count, VGMSTREAM* vgmstream)
          * - (((int) (f1 + 32768.5)) - 32768)
          * - etc
          * but since +-1 isn't really audible we'll just cast as it's the fastest
+         * (wider sample formats keep the float as-is until the final conversion)
          */
-        outbuf[s] = clamp16( (int32_t)data->mixbuf[s] );
+        outbuf[s] = float_to_sample(data->mixbuf[s]);
     }
 }
 
@@ -406,6 +773,7 @@ void mixing_close(VGMSTREAM* vgmstream) {
     data = vgmstream->mixing_data;
     if (!data) return;
 
+    free_plan(data);
     free(data->mixbuf);
     free(data);
 }
@@ -1065,8 +1433,12 @@ void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count) {
     if (!mixbuf_re) goto fail;
 
     data->mixbuf = mixbuf_re;
+    data->mixbuf_samples = max_sample_count;
     data->mixing_on = 1;
 
+    /* chain can't change from now on (if compiling fails mixing uses the step path) */
+    build_plan(data, vgmstream->channels);
+
     /* since data exists on its own memory and pointer is already set
      * there is no need to propagate to start_vgmstream */
 
@@ -1077,6 +1449,15 @@ fail:
     return;
 }
 
+void mixing_release(VGMSTREAM * vgmstream) {
+    mixing_data *data = vgmstream->mixing_data;
+
+    if (!data) return;
+
+    free(data->mixbuf);
+    data->mixbuf = NULL;
+}
+
 void mixing_info(VGMSTREAM * vgmstream, int *out_input_channels, int *out_output_channels) {
     mixing_data *data = vgmstream->mixing_data;
     int input_channels, output_channels;
@@ -18,6 +18,9 @@ void mixing_update_channel(VGMSTREAM* vgmstream);
  * of down/upmixing without querying input/output_channels). */
 void mixing_setup(VGMSTREAM * vgmstream, int32_t max_sample_count);
 
+/* frees the internal buffer of an idle vgmstream (remade on next mix) */
+void mixing_release(VGMSTREAM * vgmstream);
+
 /* gets current mixing info */
 void mixing_info(VGMSTREAM * vgmstream, int *input_channels, int *output_channels);
 
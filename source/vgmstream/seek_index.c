@@ -0,0 +1,284 @@
+#include "vgmstream.h"
+#include "seek_index.h"
+#include "util.h"
+
+
+/**
+ * Seek index: while a stream renders its first pass, a snapshot of the decode state (channel
+ * offsets and history, block fields) is saved every SEEK_INDEX_INTERVAL samples, so later seeks
+ * start from the closest point instead of decoding from the beginning. Only snapshots of exact
+ * states are kept: recording stops after warm-up jumps (approximate history) until the next reset.
+ *
+ * Points can be exported to be persisted by the player and imported when the file is opened
+ * again. Block offsets are stored as 64-bit (off_t may be). The channels are a raw dump of their
+ * structs, only valid for the same build/platform (checked roughly by struct size).
+ */
+
+#define SEEK_INDEX_INTERVAL 0x40000 /* ~5.5s at 48000 Hz */
+#define SEEK_INDEX_VERSION 2
+#define SEEK_INDEX_HEADER_SIZE 0x20
+#define SEEK_INDEX_POINT_SIZE 0x2c
+
+typedef struct {
+    int32_t sample;
+    int32_t samples_into_block;
+    off_t current_block_offset;
+    size_t current_block_size;
+    size_t current_block_samples;
+    off_t next_block_offset;
+    size_t full_block_size;
+    int codec_config;
+    int32_t ws_output_size;
+} seek_point;
+
+typedef struct {
+    int recording;
+    int count;
+    int capacity;
+    seek_point *points;
+    VGMSTREAMCHANNEL *channels; /* count * vgmstream->channels */
+} seek_index_data;
+
+
+void seek_index_init(VGMSTREAM* vgmstream) {
+    seek_index_data *data;
+
+    if (vgmstream->seek_index)
+        return;
+
+    /* layouts that keep state elsewhere or jump on their own */
+    if (vgmstream->layout_type == layout_segmented || vgmstream->layout_type == layout_layered)
+        return;
+    /* codecs with internal state can't be snapshotted (some like HCA/NWA jump on their own) */
+    if (vgmstream->codec_data)
+        return;
+    /* flat/interleave streams with seekable codecs jump to any frame already */
+    if ((vgmstream->layout_type == layout_none || vgmstream->layout_type == layout_interleave)
+            && get_vgmstream_seek_warmup(vgmstream) >= 0)
+        return;
+
+    data = calloc(1, sizeof(seek_index_data));
+    if (!data) return;
+
+    data->recording = 1;
+    vgmstream->seek_index = data;
+}
+
+void seek_index_close(VGMSTREAM* vgmstream) {
+    seek_index_data *data = vgmstream->seek_index;
+    if (!data) return;
+
+    free(data->points);
+    free(data->channels);
+    free(data);
+    vgmstream->seek_index = NULL;
+}
+
+void seek_index_reset(VGMSTREAM* vgmstream) {
+    seek_index_data *data = vgmstream->seek_index;
+    if (!data) return;
+
+    data->recording = 1;
+}
+
+void seek_index_pause(VGMSTREAM* vgmstream) {
+    seek_index_data *data = vgmstream->seek_index;
+    if (!data) return;
+
+    data->recording = 0;
+}
+
+static int grow_points(seek_index_data *data, int channels) {
+    int capacity = data->capacity ? data->capacity * 2 : 64;
+    seek_point *points;
+    VGMSTREAMCHANNEL *chs;
+
+    points = realloc(data->points, capacity * sizeof(seek_point));
+    if (!points) return 0;
+    data->points = points;
+
+    chs = realloc(data->channels, capacity * channels * sizeof(VGMSTREAMCHANNEL));
+    if (!chs) return 0;
+    data->channels = chs;
+
+    data->capacity = capacity;
+    return 1;
+}
+
+void seek_index_record(VGMSTREAM* vgmstream) {
+    seek_index_data *data = vgmstream->seek_index;
+    int32_t last_sample;
+    seek_point *point;
+
+    if (!data || !data->recording || vgmstream->loop_count > 0)
+        return;
+    if (vgmstream->current_sample >= vgmstream->num_samples)
+        return;
+
+    last_sample = data->count ? data->points[data->count - 1].sample : 0;
+    if (vgmstream->current_sample < last_sample + SEEK_INDEX_INTERVAL)
+        return;
+
+    if (data->count == data->capacity && !grow_points(data, vgmstream->channels))
+        return;
+
+    point = &data->points[data->count];
+    point->sample = vgmstream->current_sample;
+    point->samples_into_block = vgmstream->samples_into_block;
+    point->current_block_offset = vgmstream->current_block_offset;
+    point->current_block_size = vgmstream->current_block_size;
+    point->current_block_samples = vgmstream->current_block_samples;
+    point->next_block_offset = vgmstream->next_block_offset;
+    point->full_block_size = vgmstream->full_block_size;
+    point->codec_config = vgmstream->codec_config;
+    point->ws_output_size = vgmstream->ws_output_size;
+    memcpy(&data->channels[data->count * vgmstream->channels], vgmstream->ch, vgmstream->channels * sizeof(VGMSTREAMCHANNEL));
+
+    data->count++;
+}
+
+void seek_index_restore(VGMSTREAM* vgmstream, int32_t seek_sample) {
+    seek_index_data *data = vgmstream->seek_index;
+    seek_point *point;
+    int lo, hi, ch;
+
+    if (!data || data->count == 0)
+        return;
+
+    /* last point <= seek_sample */
+    lo = 0;
+    hi = data->count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (data->points[mid].sample <= seek_sample)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return;
+
+    point = &data->points[lo - 1];
+    if (point->sample <= vgmstream->current_sample)
+        return;
+
+    vgmstream->current_sample = point->sample;
+    vgmstream->samples_into_block = point->samples_into_block;
+    vgmstream->current_block_offset = point->current_block_offset;
+    vgmstream->current_block_size = point->current_block_size;
+    vgmstream->current_block_samples = point->current_block_samples;
+    vgmstream->next_block_offset = point->next_block_offset;
+    vgmstream->full_block_size = point->full_block_size;
+    vgmstream->codec_config = point->codec_config;
+    vgmstream->ws_output_size = point->ws_output_size;
+    for (ch = 0; ch < vgmstream->channels; ch++) {
+        STREAMFILE *streamfile = vgmstream->ch[ch].streamfile;
+
+        vgmstream->ch[ch] = data->channels[(lo - 1) * vgmstream->channels + ch];
+        vgmstream->ch[ch].streamfile = streamfile; /* may come from an import */
+    }
+}
+
+
+size_t vgmstream_seek_index_export(VGMSTREAM* vgmstream, uint8_t* buf, size_t buf_size) {
+    seek_index_data *data = vgmstream->seek_index;
+    size_t channels_size, point_size, size;
+    int i;
+
+    if (!data || data->count == 0)
+        return 0;
+
+    channels_size = vgmstream->channels * sizeof(VGMSTREAMCHANNEL);
+    point_size = SEEK_INDEX_POINT_SIZE + channels_size;
+    size = SEEK_INDEX_HEADER_SIZE + data->count * point_size;
+    if (!buf)
+        return size;
+    if (buf_size < size)
+        return 0;
+
+    memset(buf, 0, SEEK_INDEX_HEADER_SIZE);
+    memcpy(buf + 0x00, "VSIX", 4);
+    put_32bitLE(buf + 0x04, SEEK_INDEX_VERSION);
+    put_32bitLE(buf + 0x08, sizeof(VGMSTREAMCHANNEL));
+    put_32bitLE(buf + 0x0c, vgmstream->channels);
+    put_32bitLE(buf + 0x10, vgmstream->num_samples);
+    put_32bitLE(buf + 0x14, vgmstream->coding_type);
+    put_32bitLE(buf + 0x18, vgmstream->layout_type);
+    put_32bitLE(buf + 0x1c, data->count);
+
+    for (i = 0; i < data->count; i++) {
+        uint8_t *p = buf + SEEK_INDEX_HEADER_SIZE + i * point_size;
+        seek_point *point = &data->points[i];
+
+        put_32bitLE(p + 0x00, point->sample);
+        put_32bitLE(p + 0x04, point->samples_into_block);
+        put_64bitLE(p + 0x08, point->current_block_offset);
+        put_32bitLE(p + 0x10, point->current_block_size);
+        put_32bitLE(p + 0x14, point->current_block_samples);
+        put_64bitLE(p + 0x18, point->next_block_offset);
+        put_32bitLE(p + 0x20, point->full_block_size);
+        put_32bitLE(p + 0x24, point->codec_config);
+        put_32bitLE(p + 0x28, point->ws_output_size);
+        memcpy(p + SEEK_INDEX_POINT_SIZE, &data->channels[i * vgmstream->channels], channels_size);
+    }
+
+    return size;
+}
+
+int vgmstream_seek_index_import(VGMSTREAM* vgmstream, const uint8_t* buf, size_t buf_size) {
+    seek_index_data *data = vgmstream->seek_index;
+    size_t channels_size, point_size;
+    int i, count;
+    int32_t last_sample = 0;
+
+    if (!data || data->count != 0)
+        goto fail;
+
+    if (buf_size < SEEK_INDEX_HEADER_SIZE || memcmp(buf + 0x00, "VSIX", 4) != 0)
+        goto fail;
+    if (get_32bitLE(buf + 0x04) != SEEK_INDEX_VERSION ||
+            get_32bitLE(buf + 0x08) != sizeof(VGMSTREAMCHANNEL) ||
+            get_32bitLE(buf + 0x0c) != vgmstream->channels ||
+            get_32bitLE(buf + 0x10) != vgmstream->num_samples ||
+            get_32bitLE(buf + 0x14) != vgmstream->coding_type ||
+            get_32bitLE(buf + 0x18) != vgmstream->layout_type)
+        goto fail;
+
+    channels_size = vgmstream->channels * sizeof(VGMSTREAMCHANNEL);
+    point_size = SEEK_INDEX_POINT_SIZE + channels_size;
+    count = get_32bitLE(buf + 0x1c);
+    if (count <= 0 || buf_size < SEEK_INDEX_HEADER_SIZE + count * point_size)
+        goto fail;
+
+    while (data->capacity < count) {
+        if (!grow_points(data, vgmstream->channels))
+            goto fail;
+    }
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *p = buf + SEEK_INDEX_HEADER_SIZE + i * point_size;
+        seek_point *point = &data->points[i];
+
+        point->sample = get_32bitLE(p + 0x00);
+        point->samples_into_block = get_32bitLE(p + 0x04);
+        point->current_block_offset = get_64bitLE(p + 0x08);
+        point->current_block_size = get_32bitLE(p + 0x10);
+        point->current_block_samples = get_32bitLE(p + 0x14);
+        point->next_block_offset = get_64bitLE(p + 0x18);
+        point->full_block_size = get_32bitLE(p + 0x20);
+        point->codec_config = get_32bitLE(p + 0x24);
+        point->ws_output_size = get_32bitLE(p + 0x28);
+        memcpy(&data->channels[i * vgmstream->channels], p + SEEK_INDEX_POINT_SIZE, channels_size);
+
+        /* points must be sorted, as when recorded */
+        if (point->sample <= last_sample || point->sample >= vgmstream->num_samples)
+            goto fail;
+        last_sample = point->sample;
+    }
+
+    data->count = count;
+    return 1;
+
+fail:
+    return 0;
+}
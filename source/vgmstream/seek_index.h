@@ -0,0 +1,22 @@
+#ifndef _SEEK_INDEX_H_
+#define _SEEK_INDEX_H_
+
+#include "vgmstream.h"
+
+/* Seek points recorded while rendering, for streams that can't jump by offset math (blocked layouts,
+ * codecs with unrecoverable state). Only streams whose whole decode state lives in ch[] and the
+ * block fields get an index. */
+void seek_index_init(VGMSTREAM* vgmstream);
+void seek_index_close(VGMSTREAM* vgmstream);
+
+/* state is exact from here (after resets), or approximate until the next reset (after warm-up jumps) */
+void seek_index_reset(VGMSTREAM* vgmstream);
+void seek_index_pause(VGMSTREAM* vgmstream);
+
+/* called after rendering, saves a point every few seconds of the first pass */
+void seek_index_record(VGMSTREAM* vgmstream);
+
+/* moves to the last point after current_sample and up to seek_sample, if any */
+void seek_index_restore(VGMSTREAM* vgmstream, int32_t seek_sample);
+
+#endif /* _SEEK_INDEX_H_ */
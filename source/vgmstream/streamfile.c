@@ -2,94 +2,297 @@
 #include <unistd.h>
 #endif
 #include "streamfile.h"
+#ifdef VGM_USE_MMAP
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#endif
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
 #include "util.h"
 #include "vgmstream.h"
 
 
-/* a STREAMFILE that operates via standard IO using a buffer */
-typedef struct {
-    STREAMFILE sf;          /* callbacks */
+/* Page cache for stdio files: fixed size pages in LRU order, keyed by file and offset, shared by
+ * every STDIOSTREAMFILE (each channel reopens the file, but they all read the same pages).
+ * Pages are allocated on demand up to a global limit and freed when their file is closed. */
 
+#ifndef PAGECACHE_PAGE_SIZE
+#define PAGECACHE_PAGE_SIZE 0x4000
+#endif
+#ifndef PAGECACHE_PAGES
+#define PAGECACHE_PAGES 16
+#endif
+#define PAGECACHE_BUCKETS 64
+
+/* an open file, shared by all STDIOSTREAMFILEs reopening the same name */
+typedef struct {
     FILE * infile;          /* actual FILE */
     char name[PATH_LIMIT];  /* FILE filename */
+    size_t filesize;        /* cached file size */
+    int refs;               /* streamfiles using it */
+#ifdef VGM_USE_THREADS
+    pthread_mutex_t io_lock; /* FILE position is shared by its streamfiles */
+#endif
+} STDIOFILE;
+
+typedef struct cache_page {
+    STDIOFILE * file;
+    off_t offset;           /* page start */
+    size_t size;            /* valid bytes (smaller at EOF) */
+    int pins;               /* peeked pointers or a read in progress, can't be evicted */
+    int loading;            /* being read with the cache unlocked, data not valid yet */
+    struct cache_page *lru_prev, *lru_next; /* head is the most recent */
+    struct cache_page *hash_next;
+    uint8_t data[PAGECACHE_PAGE_SIZE];
+} cache_page;
+
+/* all pages and files' refs are guarded by lock, which is released during FILE ops (guarded per file) */
+static struct {
+#ifdef VGM_USE_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t loaded;  /* a loading page was finished */
+#endif
+    cache_page * hash[PAGECACHE_BUCKETS];
+    cache_page * lru_head;
+    cache_page * lru_tail;
+    int pages;
+} pagecache
+#ifdef VGM_USE_THREADS
+    = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER }
+#endif
+;
+
+#ifdef VGM_USE_THREADS
+#define PAGECACHE_LOCK()    pthread_mutex_lock(&pagecache.lock)
+#define PAGECACHE_UNLOCK()  pthread_mutex_unlock(&pagecache.lock)
+#define PAGECACHE_WAIT()    pthread_cond_wait(&pagecache.loaded, &pagecache.lock)
+#define PAGECACHE_SIGNAL()  pthread_cond_broadcast(&pagecache.loaded)
+#define FILE_LOCK(file)     pthread_mutex_lock(&(file)->io_lock)
+#define FILE_UNLOCK(file)   pthread_mutex_unlock(&(file)->io_lock)
+#else
+#define PAGECACHE_LOCK()
+#define PAGECACHE_UNLOCK()
+#define PAGECACHE_WAIT()
+#define PAGECACHE_SIGNAL()
+#define FILE_LOCK(file)
+#define FILE_UNLOCK(file)
+#endif
+
+static cache_page ** pagecache_bucket(STDIOFILE * file, off_t offset) {
+    size_t key = ((size_t)file >> 4) ^ (size_t)(offset / PAGECACHE_PAGE_SIZE);
+    return &pagecache.hash[key % PAGECACHE_BUCKETS];
+}
+
+static void pagecache_remove_lru(cache_page * page) {
+    if (page->lru_prev) page->lru_prev->lru_next = page->lru_next;
+    else pagecache.lru_head = page->lru_next;
+    if (page->lru_next) page->lru_next->lru_prev = page->lru_prev;
+    else pagecache.lru_tail = page->lru_prev;
+    page->lru_prev = page->lru_next = NULL;
+}
+
+static void pagecache_unlink(cache_page * page) {
+    cache_page ** link;
+
+    for (link = pagecache_bucket(page->file, page->offset); *link != page; link = &(*link)->hash_next) {
+        ;
+    }
+    *link = page->hash_next;
+    page->file = NULL;
+
+    pagecache_remove_lru(page);
+}
+
+static void pagecache_push(cache_page * page) {
+    page->lru_prev = NULL;
+    page->lru_next = pagecache.lru_head;
+    if (pagecache.lru_head) pagecache.lru_head->lru_prev = page;
+    else pagecache.lru_tail = page;
+    pagecache.lru_head = page;
+}
+
+static size_t read_stdiofile(STDIOFILE * file, uint8_t * dest, off_t offset, size_t length) {
+    if (fseeko(file->infile,offset,SEEK_SET))
+        return 0; /* this shouldn't happen in our code */
+
+#ifdef _MSC_VER
+    /* Workaround a bug that appears when compiling with MSVC (later versions).
+     * This bug is deterministic and seemingly appears randomly after seeking.
+     * It results in fread returning data from the wrong area of the file.
+     * HPS is one format that is almost always affected by this. */
+    fseek(file->infile, ftell(file->infile), SEEK_SET);
+#endif
+
+    return fread(dest,sizeof(uint8_t),length,file->infile);
+}
+
+/* reads with the cache unlocked (must be locked on entry), so a slow read doesn't stall other streams */
+static size_t pagecache_read_file(STDIOFILE * file, uint8_t * dest, off_t offset, size_t length) {
+    size_t length_read;
+
+    PAGECACHE_UNLOCK();
+    FILE_LOCK(file);
+    length_read = read_stdiofile(file, dest, offset, length);
+    FILE_UNLOCK(file);
+    PAGECACHE_LOCK();
+
+    return length_read;
+}
+
+static cache_page * pagecache_find(STDIOFILE * file, off_t offset) {
+    cache_page * page;
+
+retry:
+    for (page = *pagecache_bucket(file, offset); page != NULL; page = page->hash_next) {
+        if (page->file == file && page->offset == offset) {
+            if (page->loading) { /* another stream is reading it, the page may be gone after waking */
+                PAGECACHE_WAIT();
+                goto retry;
+            }
+            if (page != pagecache.lru_head) { /* move to front */
+                pagecache_remove_lru(page);
+                pagecache_push(page);
+            }
+            return page;
+        }
+    }
+    return NULL;
+}
+
+/* gets a page from the cache, reading it into a new or the least recently used page if missing */
+static cache_page * pagecache_load(STDIOFILE * file, off_t offset) {
+    cache_page * page = pagecache_find(file, offset);
+    cache_page ** bucket;
+
+    if (page)
+        return page;
+
+    if (pagecache.pages < PAGECACHE_PAGES) {
+        page = calloc(1,sizeof(cache_page));
+        if (page) pagecache.pages++;
+    }
+    if (!page) {
+        for (page = pagecache.lru_tail; page != NULL && page->pins > 0; page = page->lru_prev) {
+            ;
+        }
+        if (!page) return NULL; /* everything pinned */
+        pagecache_unlink(page);
+    }
+
+    /* publish the page as loading first, so others wait for it rather than reading it again */
+    bucket = pagecache_bucket(file, offset);
+    page->file = file;
+    page->offset = offset;
+    page->hash_next = *bucket;
+    *bucket = page;
+    pagecache_push(page);
+    page->loading = 1;
+    page->pins++;
+
+    page->size = pagecache_read_file(file, page->data, offset, PAGECACHE_PAGE_SIZE);
+
+    page->loading = 0;
+    page->pins--;
+    PAGECACHE_SIGNAL();
+
+    if (page->size == 0) {
+        pagecache_unlink(page);
+        pagecache.pages--;
+        free(page);
+        return NULL;
+    }
+    return page;
+}
+
+/* frees the pages of a closed file */
+static void pagecache_drop(STDIOFILE * file) {
+    cache_page *page, *next;
+
+    for (page = pagecache.lru_head; page != NULL; page = next) {
+        next = page->lru_next;
+        if (page->file != file)
+            continue;
+        pagecache_unlink(page);
+        pagecache.pages--;
+        free(page);
+    }
+}
+
+
+/* a STREAMFILE that operates via standard IO using the shared page cache */
+typedef struct {
+    STREAMFILE sf;          /* callbacks */
+
+    STDIOFILE * file;       /* shared FILE */
     off_t offset;           /* last read offset (info) */
-    off_t buffer_offset;    /* current buffer data start */
-    uint8_t * buffer;       /* data buffer */
-    size_t buffersize;      /* max buffer size */
-    size_t validsize;       /* current buffer size */
-    size_t filesize;        /* buffered file size */
+    cache_page * pinned;    /* page of the last peek */
 } STDIOSTREAMFILE;
 
-static STREAMFILE * open_stdio_streamfile_buffer(const char * const filename, size_t buffersize);
-static STREAMFILE * open_stdio_streamfile_buffer_by_file(FILE *infile,const char * const filename, size_t buffersize);
+static STREAMFILE * open_stdio_streamfile_by_stdiofile(STDIOFILE * file);
+
+static void unpin_stdio(STDIOSTREAMFILE *streamfile) {
+    if (streamfile->pinned) {
+        streamfile->pinned->pins--;
+        streamfile->pinned = NULL;
+    }
+}
 
 static size_t read_stdio(STDIOSTREAMFILE *streamfile,uint8_t * dest, off_t offset, size_t length) {
+    STDIOFILE * file;
     size_t length_read_total = 0;
 
     if (!streamfile || !dest || length <= 0 || offset < 0)
         return 0;
+    file = streamfile->file;
 
-    /* is the part of the requested length in the buffer? */
-    if (offset >= streamfile->buffer_offset && offset < streamfile->buffer_offset + streamfile->validsize) {
-        size_t length_to_read;
-        off_t offset_into_buffer = offset - streamfile->buffer_offset;
-
-        length_to_read = streamfile->validsize - offset_into_buffer;
-        if (length_to_read > length)
-            length_to_read = length;
-
-        memcpy(dest,streamfile->buffer + offset_into_buffer,length_to_read);
-        length_read_total += length_to_read;
-        length -= length_to_read;
-        offset += length_to_read;
-        dest += length_to_read;
-    }
-
+    PAGECACHE_LOCK();
+    unpin_stdio(streamfile);
 
-    /* read the rest of the requested length */
     while (length > 0) {
+        off_t page_offset = offset - offset % PAGECACHE_PAGE_SIZE;
+        size_t page_pos = offset - page_offset;
         size_t length_to_read;
+        cache_page * page;
 
         /* ignore requests at EOF */
-        if (offset >= streamfile->filesize) {
-            //offset = streamfile->filesize; /* seems fseek doesn't clamp offset */
-            VGM_ASSERT_ONCE(offset > streamfile->filesize, "STDIO: reading over filesize 0x%x @ 0x%x + 0x%x\n", streamfile->filesize, (uint32_t)offset, length);
+        if (offset >= file->filesize) {
+            VGM_ASSERT_ONCE(offset > file->filesize, "STDIO: reading over filesize 0x%x @ 0x%x + 0x%x\n", file->filesize, (uint32_t)offset, length);
             break;
         }
 
-        /* position to new offset */
-        if (fseeko(streamfile->infile,offset,SEEK_SET)) {
-            break; /* this shouldn't happen in our code */
-        }
-
-#ifdef _MSC_VER
-        /* Workaround a bug that appears when compiling with MSVC (later versions).
-         * This bug is deterministic and seemingly appears randomly after seeking.
-         * It results in fread returning data from the wrong area of the file.
-         * HPS is one format that is almost always affected by this. */
-        fseek(streamfile->infile, ftell(streamfile->infile), SEEK_SET);
-#endif
-
-        /* fill the buffer (offset now is beyond buffer_offset) */
-        streamfile->buffer_offset = offset;
-        streamfile->validsize = fread(streamfile->buffer,sizeof(uint8_t),streamfile->buffersize,streamfile->infile);
-
-        /* decide how much must be read this time */
-        if (length > streamfile->buffersize)
-            length_to_read = streamfile->buffersize;
-        else
-            length_to_read = length;
+        page = pagecache_find(file, page_offset);
 
-        /* give up on partial reads (EOF) */
-        if (streamfile->validsize < length_to_read) {
-            memcpy(dest,streamfile->buffer,streamfile->validsize);
-            offset += streamfile->validsize;
-            length_read_total += streamfile->validsize;
-            break;
+        /* whole uncached pages go straight to dest, so big reads (read-ahead) don't flush the cache */
+        if (!page && page_pos == 0 && length >= PAGECACHE_PAGE_SIZE) {
+            length_to_read = length - length % PAGECACHE_PAGE_SIZE;
+            length_to_read = pagecache_read_file(file, dest, offset, length_to_read);
+        }
+        else {
+            if (!page)
+                page = pagecache_load(file, page_offset);
+            if (!page) /* all pages pinned by peeks, or EOF */
+                length_to_read = pagecache_read_file(file, dest, offset, length);
+            else {
+                if (page_pos >= page->size)
+                    break; /* EOF */
+                length_to_read = page->size - page_pos;
+                if (length_to_read > length)
+                    length_to_read = length;
+                memcpy(dest, page->data + page_pos, length_to_read);
+            }
         }
 
-        /* use the new buffer */
-        memcpy(dest,streamfile->buffer,length_to_read);
+        if (length_to_read == 0)
+            break;
         offset += length_to_read;
         length_read_total += length_to_read;
         length -= length_to_read;
@@ -97,59 +300,97 @@ static size_t read_stdio(STDIOSTREAMFILE *streamfile,uint8_t * dest, off_t offse
     }
 
     streamfile->offset = offset; /* last fread offset */
+    PAGECACHE_UNLOCK();
     return length_read_total;
 }
+static const uint8_t * peek_stdio(STDIOSTREAMFILE *streamfile, off_t offset, size_t length) {
+    const uint8_t * data = NULL;
+    off_t page_offset;
+    cache_page * page;
+
+    if (!streamfile || length <= 0 || offset < 0)
+        return NULL;
+
+    /* windows crossing pages are left to read */
+    page_offset = offset - offset % PAGECACHE_PAGE_SIZE;
+    if (offset - page_offset + length > PAGECACHE_PAGE_SIZE)
+        return NULL;
+
+    PAGECACHE_LOCK();
+    unpin_stdio(streamfile);
+
+    /* pinned until the next call on this streamfile, as other streamfiles share the cache */
+    page = pagecache_load(streamfile->file, page_offset);
+    if (page && offset - page_offset + length <= page->size) {
+        page->pins++;
+        streamfile->pinned = page;
+        streamfile->offset = offset + length;
+        data = page->data + (offset - page_offset);
+    }
+
+    PAGECACHE_UNLOCK();
+    return data;
+}
 static size_t get_size_stdio(STDIOSTREAMFILE * streamfile) {
-    return streamfile->filesize;
+    return streamfile->file->filesize;
 }
 static off_t get_offset_stdio(STDIOSTREAMFILE *streamfile) {
     return streamfile->offset;
 }
 static void get_name_stdio(STDIOSTREAMFILE *streamfile,char *buffer,size_t length) {
-    strncpy(buffer,streamfile->name,length);
+    strncpy(buffer,streamfile->file->name,length);
     buffer[length-1]='\0';
 }
 static void close_stdio(STDIOSTREAMFILE * streamfile) {
-    fclose(streamfile->infile);
-    free(streamfile->buffer);
+    STDIOFILE * file = streamfile->file;
+    int refs;
+
+    PAGECACHE_LOCK();
+    unpin_stdio(streamfile);
+    refs = --file->refs;
+    if (refs == 0)
+        pagecache_drop(file);
+    PAGECACHE_UNLOCK();
+
+    if (refs == 0) {
+        fclose(file->infile);
+#ifdef VGM_USE_THREADS
+        pthread_mutex_destroy(&file->io_lock);
+#endif
+        free(file);
+    }
     free(streamfile);
 }
 
 static STREAMFILE *open_stdio(STDIOSTREAMFILE *streamFile,const char * const filename,size_t buffersize) {
-    int newfd;
-    FILE *newfile;
     STREAMFILE *newstreamFile;
 
     if (!filename)
         return NULL;
-#if !defined (__ANDROID__)
-    // if same name, duplicate the file pointer we already have open
-    if (!strcmp(streamFile->name,filename)) {
-        if (((newfd = dup(fileno(streamFile->infile))) >= 0) &&
-            (newfile = fdopen( newfd, "rb" ))) 
-        {
-            newstreamFile = open_stdio_streamfile_buffer_by_file(newfile,filename,buffersize);
-            if (newstreamFile) { 
-                return newstreamFile;
-            }
-            // failure, close it and try the default path (which will probably fail a second time)
-            fclose(newfile);
-        }
+
+    /* if same name, share the FILE and its cached pages (buffersize isn't needed with the cache) */
+    if (!strcmp(streamFile->file->name,filename)) {
+        PAGECACHE_LOCK();
+        streamFile->file->refs++;
+        PAGECACHE_UNLOCK();
+
+        newstreamFile = open_stdio_streamfile_by_stdiofile(streamFile->file);
+        if (newstreamFile)
+            return newstreamFile;
+
+        PAGECACHE_LOCK();
+        streamFile->file->refs--; /* can't be the last one */
+        PAGECACHE_UNLOCK();
+        return NULL;
     }
-#endif    
+
     // a normal open, open a new file
-    return open_stdio_streamfile_buffer(filename,buffersize);
+    return open_stdio_streamfile(filename);
 }
 
-static STREAMFILE * open_stdio_streamfile_buffer_by_file(FILE *infile,const char * const filename, size_t buffersize) {
-    uint8_t * buffer = NULL;
-    STDIOSTREAMFILE * streamfile = NULL;
-
-    buffer = calloc(buffersize,1);
-    if (!buffer) goto fail;
-
-    streamfile = calloc(1,sizeof(STDIOSTREAMFILE));
-    if (!streamfile) goto fail;
+static STREAMFILE * open_stdio_streamfile_by_stdiofile(STDIOFILE * file) {
+    STDIOSTREAMFILE * streamfile = calloc(1,sizeof(STDIOSTREAMFILE));
+    if (!streamfile) return NULL;
 
     streamfile->sf.read = (void*)read_stdio;
     streamfile->sf.get_size = (void*)get_size_stdio;
@@ -157,42 +398,62 @@ static STREAMFILE * open_stdio_streamfile_buffer_by_file(FILE *infile,const char
     streamfile->sf.get_name = (void*)get_name_stdio;
     streamfile->sf.open = (void*)open_stdio;
     streamfile->sf.close = (void*)close_stdio;
+    streamfile->sf.peek = (void*)peek_stdio;
 
-    streamfile->infile = infile;
-    streamfile->buffersize = buffersize;
-    streamfile->buffer = buffer;
+    streamfile->file = file;
 
-    strncpy(streamfile->name,filename,sizeof(streamfile->name));
-    streamfile->name[sizeof(streamfile->name)-1] = '\0';
+    return &streamfile->sf;
+}
+
+STREAMFILE * open_stdio_streamfile_by_file(FILE * infile, const char * filename) {
+    STDIOFILE * file = NULL;
+    STREAMFILE * streamFile = NULL;
+
+    file = calloc(1,sizeof(STDIOFILE));
+    if (!file) goto fail;
+
+    file->infile = infile;
+    file->refs = 1;
+#ifdef VGM_USE_THREADS
+    pthread_mutex_init(&file->io_lock, NULL);
+#endif
+
+    strncpy(file->name,filename,sizeof(file->name));
+    file->name[sizeof(file->name)-1] = '\0';
 
     /* cache filesize */
-    fseeko(streamfile->infile,0,SEEK_END);
-    streamfile->filesize = ftello(streamfile->infile);
+    fseeko(file->infile,0,SEEK_END);
+    file->filesize = ftello(file->infile);
 
     /* Typically fseek(o)/ftell(o) may only handle up to ~2.14GB, signed 32b = 0x7FFFFFFF
      * (happens in banks like FSB, though rarely). Can be remedied with the
      * preprocessor (-D_FILE_OFFSET_BITS=64 in GCC) but it's not well tested. */
-    if (streamfile->filesize == 0xFFFFFFFF) { /* -1 on error */
+    if (file->filesize == 0xFFFFFFFF) { /* -1 on error */
         VGM_LOG("STREAMFILE: ftell error\n");
         goto fail; /* can be ignored but may result in strange/unexpected behaviors */
     }
 
-    return &streamfile->sf;
+    streamFile = open_stdio_streamfile_by_stdiofile(file);
+    if (!streamFile) goto fail;
+
+    return streamFile;
 
 fail:
-    free(buffer);
-    free(streamfile);
+#ifdef VGM_USE_THREADS
+    if (file) pthread_mutex_destroy(&file->io_lock);
+#endif
+    free(file);
     return NULL;
 }
 
-static STREAMFILE * open_stdio_streamfile_buffer(const char * const filename, size_t buffersize) {
+STREAMFILE * open_stdio_streamfile(const char * filename) {
     FILE * infile;
     STREAMFILE *streamFile;
 
     infile = fopen(filename,"rb");
     if (!infile) return NULL;
 
-    streamFile = open_stdio_streamfile_buffer_by_file(infile,filename,buffersize);
+    streamFile = open_stdio_streamfile_by_file(infile,filename);
     if (!streamFile) {
         fclose(infile);
     }
@@ -200,15 +461,164 @@ static STREAMFILE * open_stdio_streamfile_buffer(const char * const filename, si
     return streamFile;
 }
 
+/* **************************************************** */
 
-STREAMFILE * open_stdio_streamfile(const char * filename) {
-    return open_stdio_streamfile_buffer(filename,STREAMFILE_DEFAULT_BUFFER_SIZE);
+#ifdef VGM_USE_MMAP
+/* a STREAMFILE that reads straight from a read-only mapping of the whole file */
+typedef struct {
+    STREAMFILE sf;          /* callbacks */
+
+    const uint8_t * data;   /* mapped file */
+    size_t filesize;        /* mapped size */
+    off_t offset;           /* last read offset (info) */
+    char name[PATH_LIMIT];  /* mapped filename */
+} MMAPSTREAMFILE;
+
+static size_t read_mmap(MMAPSTREAMFILE *streamfile, uint8_t * dest, off_t offset, size_t length) {
+    if (!streamfile || !dest || length <= 0 || offset < 0)
+        return 0;
+
+    /* ignore requests at EOF, clamp partial reads */
+    if (offset >= streamfile->filesize) {
+        VGM_ASSERT_ONCE(offset > streamfile->filesize, "MMAP: reading over filesize 0x%x @ 0x%x + 0x%x\n", streamfile->filesize, (uint32_t)offset, length);
+        return 0;
+    }
+    if (length > streamfile->filesize - offset)
+        length = streamfile->filesize - offset;
+
+    memcpy(dest, streamfile->data + offset, length);
+
+    streamfile->offset = offset + length;
+    return length;
+}
+static const uint8_t * peek_mmap(MMAPSTREAMFILE *streamfile, off_t offset, size_t length) {
+    if (!streamfile || length <= 0 || offset < 0 || offset + length > streamfile->filesize)
+        return NULL;
+
+    streamfile->offset = offset + length;
+    return streamfile->data + offset;
+}
+static size_t get_size_mmap(MMAPSTREAMFILE * streamfile) {
+    return streamfile->filesize;
+}
+static off_t get_offset_mmap(MMAPSTREAMFILE *streamfile) {
+    return streamfile->offset;
+}
+static void get_name_mmap(MMAPSTREAMFILE *streamfile, char *buffer, size_t length) {
+    strncpy(buffer,streamfile->name,length);
+    buffer[length-1]='\0';
+}
+/* maps a whole regular file read-only, returns NULL if it can't (or is empty) */
+static const uint8_t * map_file(const char * filename, size_t * out_size) {
+#ifdef _WIN32
+    HANDLE file, mapping;
+    LARGE_INTEGER size;
+    void * data = NULL;
+
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+
+    if (GetFileType(file) == FILE_TYPE_DISK && GetFileSizeEx(file, &size)
+            && size.QuadPart > 0 && (uint64_t)size.QuadPart <= (size_t)-1) {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping) {
+            data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping); /* the view keeps it alive */
+        }
+    }
+
+    CloseHandle(file);
+    if (!data) return NULL;
+
+    *out_size = (size_t)size.QuadPart;
+    return data;
+#else
+    struct stat st;
+    void * data;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || (uint64_t)st.st_size > (size_t)-1) {
+        close(fd);
+        return NULL;
+    }
+
+    data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); /* the mapping stays valid */
+    if (data == MAP_FAILED) return NULL;
+
+    *out_size = (size_t)st.st_size;
+    return data;
+#endif
+}
+
+static void unmap_file(const uint8_t * data, size_t size) {
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+static void close_mmap(MMAPSTREAMFILE * streamfile) {
+    unmap_file(streamfile->data, streamfile->filesize);
+    free(streamfile);
 }
 
-STREAMFILE * open_stdio_streamfile_by_file(FILE * file, const char * filename) {
-    return open_stdio_streamfile_buffer_by_file(file,filename,STREAMFILE_DEFAULT_BUFFER_SIZE);
+static STREAMFILE *open_mmap(MMAPSTREAMFILE *streamFile, const char * const filename, size_t buffersize) {
+    STREAMFILE *newstreamFile;
+
+    if (!filename)
+        return NULL;
+
+    /* same file is mapped again, the OS shares the pages between mappings */
+    newstreamFile = open_mmap_streamfile(filename);
+    if (newstreamFile)
+        return newstreamFile;
+
+    /* files that can't be mapped may still be readable */
+    return open_stdio_streamfile(filename);
 }
 
+STREAMFILE * open_mmap_streamfile(const char * filename) {
+    MMAPSTREAMFILE * streamfile = NULL;
+    const uint8_t * data;
+    size_t filesize = 0;
+
+    data = map_file(filename, &filesize);
+    if (!data) return NULL;
+
+    streamfile = calloc(1,sizeof(MMAPSTREAMFILE));
+    if (!streamfile) goto fail;
+
+    streamfile->sf.read = (void*)read_mmap;
+    streamfile->sf.get_size = (void*)get_size_mmap;
+    streamfile->sf.get_offset = (void*)get_offset_mmap;
+    streamfile->sf.get_name = (void*)get_name_mmap;
+    streamfile->sf.open = (void*)open_mmap;
+    streamfile->sf.close = (void*)close_mmap;
+    streamfile->sf.peek = (void*)peek_mmap;
+
+    streamfile->data = data;
+    streamfile->filesize = filesize;
+
+    strncpy(streamfile->name,filename,sizeof(streamfile->name));
+    streamfile->name[sizeof(streamfile->name)-1] = '\0';
+
+    return &streamfile->sf;
+
+fail:
+    unmap_file(data, filesize);
+    return NULL;
+}
+#else
+STREAMFILE * open_mmap_streamfile(const char * filename) {
+    return NULL;
+}
+#endif
+
 /* **************************************************** */
 
 typedef struct {
@@ -287,6 +697,24 @@ static size_t buffer_read(BUFFER_STREAMFILE *streamfile, uint8_t * dest, off_t o
     streamfile->offset = offset; /* last fread offset */
     return length_read_total;
 }
+static const uint8_t * buffer_peek(BUFFER_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (!streamfile || length <= 0 || offset < 0 || length > streamfile->buffersize)
+        return NULL;
+
+    /* refill at offset if the window isn't fully buffered (as a read would) */
+    if (offset < streamfile->buffer_offset || offset + length > streamfile->buffer_offset + streamfile->validsize) {
+        if (offset + length > streamfile->filesize)
+            return NULL; /* partial windows at EOF are left to read */
+
+        streamfile->buffer_offset = offset;
+        streamfile->validsize = streamfile->inner_sf->read(streamfile->inner_sf, streamfile->buffer, streamfile->buffer_offset, streamfile->buffersize);
+        if (streamfile->validsize < length)
+            return NULL;
+    }
+
+    streamfile->offset = offset + length;
+    return streamfile->buffer + (offset - streamfile->buffer_offset);
+}
 static size_t buffer_get_size(BUFFER_STREAMFILE * streamfile) {
     return streamfile->filesize; /* cache */
 }
@@ -328,6 +756,7 @@ STREAMFILE *open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size) {
     this_sf->sf.get_name = (void*)buffer_get_name;
     this_sf->sf.open = (void*)buffer_open;
     this_sf->sf.close = (void*)buffer_close;
+    this_sf->sf.peek = (void*)buffer_peek;
     this_sf->sf.stream_index = streamfile->stream_index;
 
     this_sf->inner_sf = streamfile;
@@ -344,6 +773,349 @@ fail:
 
 /* **************************************************** */
 
+#ifdef VGM_USE_THREADS
+/* Read-ahead: once reads move sequentially from a block to the next, the following blocks are
+ * queued for a shared IO thread, that fills the streamfile's slots while the decoder works on
+ * the current one. Slot memory of all read-ahead streamfiles comes from a global budget. */
+
+#ifndef READAHEAD_BLOCK_SIZE
+#define READAHEAD_BLOCK_SIZE 0x8000
+#endif
+#ifndef READAHEAD_BLOCKS
+#define READAHEAD_BLOCKS 4          /* current block + 3 ahead */
+#endif
+#ifndef READAHEAD_BUDGET
+#define READAHEAD_BUDGET 0x200000
+#endif
+
+typedef enum { READAHEAD_EMPTY, READAHEAD_PENDING, READAHEAD_READY } readahead_state;
+
+typedef struct readahead_slot {
+    struct _READAHEAD_STREAMFILE *owner;
+    struct readahead_slot *next;    /* IO queue */
+    readahead_state state;          /* only the IO thread touches PENDING slots */
+    off_t offset;                   /* block start */
+    size_t size;                    /* valid bytes (smaller at EOF) */
+    uint8_t * data;
+} readahead_slot;
+
+typedef struct _READAHEAD_STREAMFILE {
+    STREAMFILE sf;
+
+    STREAMFILE *inner_sf;
+    pthread_mutex_t io_lock;        /* inner_sf is used by the IO thread and direct reads */
+    size_t block_size;
+    int blocks;
+    readahead_slot * slots;
+    uint8_t * buffer;               /* slot data */
+    off_t last_block;               /* block of the last read, for sequential detection */
+    int in_flight;                  /* slots being read by the IO thread */
+    off_t offset;                   /* last read offset (info) */
+    size_t filesize;                /* cached */
+} READAHEAD_STREAMFILE;
+
+/* shared IO thread state, all slot states and the queue are guarded by lock */
+static struct {
+    pthread_mutex_t lock;
+    pthread_cond_t work;            /* queue has requests */
+    pthread_cond_t done;            /* a request finished */
+    int started;
+    size_t budget_used;
+    readahead_slot *queue_head;
+    readahead_slot *queue_tail;
+} readahead = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, NULL, NULL };
+
+static void * readahead_thread(void * arg) {
+    pthread_mutex_lock(&readahead.lock);
+    while (1) {
+        readahead_slot * slot = readahead.queue_head;
+        READAHEAD_STREAMFILE * owner;
+        size_t bytes;
+
+        if (!slot) {
+            pthread_cond_wait(&readahead.work, &readahead.lock);
+            continue;
+        }
+        readahead.queue_head = slot->next;
+        if (!readahead.queue_head)
+            readahead.queue_tail = NULL;
+
+        owner = slot->owner;
+        owner->in_flight++;
+        pthread_mutex_unlock(&readahead.lock);
+
+        pthread_mutex_lock(&owner->io_lock);
+        bytes = owner->inner_sf->read(owner->inner_sf, slot->data, slot->offset, owner->block_size);
+        pthread_mutex_unlock(&owner->io_lock);
+
+        pthread_mutex_lock(&readahead.lock);
+        slot->size = bytes;
+        slot->state = bytes > 0 ? READAHEAD_READY : READAHEAD_EMPTY;
+        owner->in_flight--;
+        pthread_cond_broadcast(&readahead.done);
+    }
+    return NULL;
+}
+
+/* find a non-empty slot for a block, waiting if it's being read (lock must be held) */
+static readahead_slot * readahead_find(READAHEAD_STREAMFILE *streamfile, off_t block) {
+    int i;
+
+    for (i = 0; i < streamfile->blocks; i++) {
+        readahead_slot * slot = &streamfile->slots[i];
+        if (slot->state == READAHEAD_EMPTY || slot->offset != block)
+            continue;
+
+        while (slot->state == READAHEAD_PENDING) {
+            pthread_cond_wait(&readahead.done, &readahead.lock);
+        }
+        return slot->state == READAHEAD_READY && slot->offset == block ? slot : NULL;
+    }
+    return NULL;
+}
+
+/* queue the blocks after the current one, reusing slots outside the window (lock must be held) */
+static void readahead_schedule(READAHEAD_STREAMFILE *streamfile, off_t block) {
+    off_t window_end = block + streamfile->blocks * streamfile->block_size;
+    off_t next;
+    int i, queued = 0;
+
+    for (next = block + streamfile->block_size; next < window_end && next < streamfile->filesize; next += streamfile->block_size) {
+        readahead_slot * slot = NULL;
+
+        for (i = 0; i < streamfile->blocks; i++) {
+            readahead_slot * cur = &streamfile->slots[i];
+            if (cur->state != READAHEAD_EMPTY && cur->offset == next) {
+                slot = NULL;
+                break; /* already there */
+            }
+            if (!slot && (cur->state == READAHEAD_EMPTY ||
+                    (cur->state == READAHEAD_READY && (cur->offset < block || cur->offset >= window_end))))
+                slot = cur;
+        }
+        if (i < streamfile->blocks)
+            continue;
+        if (!slot)
+            break;
+
+        slot->state = READAHEAD_PENDING;
+        slot->offset = next;
+        slot->size = 0;
+        slot->next = NULL;
+        if (readahead.queue_tail)
+            readahead.queue_tail->next = slot;
+        else
+            readahead.queue_head = slot;
+        readahead.queue_tail = slot;
+        queued = 1;
+    }
+
+    if (queued)
+        pthread_cond_signal(&readahead.work);
+}
+
+/* moving to the next block means sequential access, so prefetch what follows (lock must be held) */
+static void readahead_update(READAHEAD_STREAMFILE *streamfile, off_t offset) {
+    off_t block = offset - offset % streamfile->block_size;
+
+    if (block == streamfile->last_block)
+        return;
+    if (block == streamfile->last_block + streamfile->block_size)
+        readahead_schedule(streamfile, block);
+    streamfile->last_block = block;
+}
+
+static size_t readahead_read(READAHEAD_STREAMFILE *streamfile, uint8_t * dest, off_t offset, size_t length) {
+    size_t length_read_total = 0;
+
+    if (!streamfile || !dest || length <= 0 || offset < 0)
+        return 0;
+
+    pthread_mutex_lock(&readahead.lock);
+    readahead_update(streamfile, offset);
+
+    while (length > 0) {
+        off_t block = offset - offset % streamfile->block_size;
+        readahead_slot * slot = readahead_find(streamfile, block);
+        size_t length_to_read;
+
+        /* not fetched (random access, or before read-ahead kicks in): read the rest directly */
+        if (!slot) {
+            pthread_mutex_unlock(&readahead.lock);
+            pthread_mutex_lock(&streamfile->io_lock);
+            length_to_read = streamfile->inner_sf->read(streamfile->inner_sf, dest, offset, length);
+            pthread_mutex_unlock(&streamfile->io_lock);
+
+            offset += length_to_read;
+            length_read_total += length_to_read;
+            streamfile->offset = offset;
+            return length_read_total;
+        }
+
+        if (offset - block >= slot->size)
+            break; /* EOF */
+
+        length_to_read = slot->size - (offset - block);
+        if (length_to_read > length)
+            length_to_read = length;
+
+        memcpy(dest, slot->data + (offset - block), length_to_read);
+        offset += length_to_read;
+        length_read_total += length_to_read;
+        length -= length_to_read;
+        dest += length_to_read;
+    }
+
+    pthread_mutex_unlock(&readahead.lock);
+    streamfile->offset = offset;
+    return length_read_total;
+}
+static const uint8_t * readahead_peek(READAHEAD_STREAMFILE *streamfile, off_t offset, size_t length) {
+    const uint8_t * data = NULL;
+    off_t block;
+    readahead_slot * slot;
+
+    if (!streamfile || length <= 0 || offset < 0)
+        return NULL;
+
+    /* slots only change on calls to this streamfile, so the pointer stays valid until the next */
+    block = offset - offset % streamfile->block_size;
+    pthread_mutex_lock(&readahead.lock);
+    readahead_update(streamfile, offset);
+    slot = readahead_find(streamfile, block);
+    if (slot && offset - block + length <= slot->size) {
+        data = slot->data + (offset - block);
+        streamfile->offset = offset + length;
+    }
+    pthread_mutex_unlock(&readahead.lock);
+
+    return data;
+}
+static size_t readahead_get_size(READAHEAD_STREAMFILE * streamfile) {
+    return streamfile->filesize; /* cache */
+}
+static off_t readahead_get_offset(READAHEAD_STREAMFILE * streamfile) {
+    return streamfile->offset; /* cache */
+}
+static void readahead_get_name(READAHEAD_STREAMFILE *streamfile, char *buffer, size_t length) {
+    streamfile->inner_sf->get_name(streamfile->inner_sf, buffer, length); /* default */
+}
+static STREAMFILE *readahead_open(READAHEAD_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    STREAMFILE *new_inner_sf, *new_sf;
+
+    new_inner_sf = streamfile->inner_sf->open(streamfile->inner_sf,filename,buffersize);
+    if (!new_inner_sf) return NULL;
+
+    new_sf = open_readahead_streamfile(new_inner_sf, streamfile->block_size, streamfile->blocks);
+    return new_sf ? new_sf : new_inner_sf; /* over budget */
+}
+static void readahead_close(READAHEAD_STREAMFILE *streamfile) {
+    readahead_slot *slot, *prev = NULL;
+
+    /* drop queued requests and wait for the one being read, if any */
+    pthread_mutex_lock(&readahead.lock);
+    for (slot = readahead.queue_head; slot != NULL; slot = slot->next) {
+        if (slot->owner != streamfile) {
+            prev = slot;
+            continue;
+        }
+        if (prev)
+            prev->next = slot->next;
+        else
+            readahead.queue_head = slot->next;
+        if (readahead.queue_tail == slot)
+            readahead.queue_tail = prev;
+    }
+    while (streamfile->in_flight > 0) {
+        pthread_cond_wait(&readahead.done, &readahead.lock);
+    }
+    readahead.budget_used -= streamfile->blocks * streamfile->block_size;
+    pthread_mutex_unlock(&readahead.lock);
+
+    streamfile->inner_sf->close(streamfile->inner_sf);
+    pthread_mutex_destroy(&streamfile->io_lock);
+    free(streamfile->buffer);
+    free(streamfile->slots);
+    free(streamfile);
+}
+
+STREAMFILE *open_readahead_streamfile(STREAMFILE *streamfile, size_t block_size, int blocks) {
+    READAHEAD_STREAMFILE *this_sf = NULL;
+    size_t budget;
+    int i;
+
+    if (!streamfile) return NULL;
+    if (block_size == 0) block_size = READAHEAD_BLOCK_SIZE;
+    if (blocks <= 1) blocks = READAHEAD_BLOCKS;
+    budget = blocks * block_size;
+
+    /* start the IO thread on first use (it lives for the whole process) and reserve memory */
+    pthread_mutex_lock(&readahead.lock);
+    if (!readahead.started) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, readahead_thread, NULL) == 0) {
+            pthread_detach(thread);
+            readahead.started = 1;
+        }
+    }
+    if (!readahead.started || readahead.budget_used + budget > READAHEAD_BUDGET) {
+        pthread_mutex_unlock(&readahead.lock);
+        return NULL;
+    }
+    readahead.budget_used += budget;
+    pthread_mutex_unlock(&readahead.lock);
+
+    this_sf = calloc(1,sizeof(READAHEAD_STREAMFILE));
+    if (!this_sf) goto fail;
+
+    this_sf->slots = calloc(blocks,sizeof(readahead_slot));
+    if (!this_sf->slots) goto fail;
+    this_sf->buffer = malloc(budget);
+    if (!this_sf->buffer) goto fail;
+    if (pthread_mutex_init(&this_sf->io_lock, NULL) != 0) goto fail;
+
+    for (i = 0; i < blocks; i++) {
+        this_sf->slots[i].owner = this_sf;
+        this_sf->slots[i].data = this_sf->buffer + i*block_size;
+    }
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)readahead_read;
+    this_sf->sf.get_size = (void*)readahead_get_size;
+    this_sf->sf.get_offset = (void*)readahead_get_offset;
+    this_sf->sf.get_name = (void*)readahead_get_name;
+    this_sf->sf.open = (void*)readahead_open;
+    this_sf->sf.close = (void*)readahead_close;
+    this_sf->sf.peek = (void*)readahead_peek;
+    this_sf->sf.stream_index = streamfile->stream_index;
+
+    this_sf->inner_sf = streamfile;
+    this_sf->block_size = block_size;
+    this_sf->blocks = blocks;
+    this_sf->last_block = -1;
+    this_sf->filesize = streamfile->get_size(streamfile);
+
+    return &this_sf->sf;
+
+fail:
+    pthread_mutex_lock(&readahead.lock);
+    readahead.budget_used -= budget;
+    pthread_mutex_unlock(&readahead.lock);
+    if (this_sf) {
+        free(this_sf->buffer);
+        free(this_sf->slots);
+    }
+    free(this_sf);
+    return NULL;
+}
+#else
+STREAMFILE *open_readahead_streamfile(STREAMFILE *streamfile, size_t block_size, int blocks) {
+    return NULL;
+}
+#endif
+
+/* **************************************************** */
+
 //todo stream_index: copy? pass? funtion? external?
 //todo use realnames on reopen? simplify?
 //todo use safe string ops, this ain't easy
@@ -357,6 +1129,10 @@ typedef struct {
 static size_t wrap_read(WRAP_STREAMFILE *streamfile, uint8_t * dest, off_t offset, size_t length) {
     return streamfile->inner_sf->read(streamfile->inner_sf, dest, offset, length); /* default */
 }
+static const uint8_t * wrap_peek(WRAP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (!streamfile->inner_sf->peek) return NULL;
+    return streamfile->inner_sf->peek(streamfile->inner_sf, offset, length); /* default */
+}
 static size_t wrap_get_size(WRAP_STREAMFILE * streamfile) {
     return streamfile->inner_sf->get_size(streamfile->inner_sf); /* default */
 }
@@ -389,6 +1165,7 @@ STREAMFILE *open_wrap_streamfile(STREAMFILE *streamfile) {
     this_sf->sf.get_name = (void*)wrap_get_name;
     this_sf->sf.open = (void*)wrap_open;
     this_sf->sf.close = (void*)wrap_close;
+    this_sf->sf.peek = (void*)wrap_peek;
     this_sf->sf.stream_index = streamfile->stream_index;
 
     this_sf->inner_sf = streamfile;
@@ -411,6 +1188,10 @@ static size_t clamp_read(CLAMP_STREAMFILE *streamfile, uint8_t *dest, off_t offs
     size_t clamp_length = length > (streamfile->size - offset) ? (streamfile->size - offset) : length;
     return streamfile->inner_sf->read(streamfile->inner_sf, dest, inner_offset, clamp_length);
 }
+static const uint8_t * clamp_peek(CLAMP_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (!streamfile->inner_sf->peek || offset < 0 || offset + length > streamfile->size) return NULL;
+    return streamfile->inner_sf->peek(streamfile->inner_sf, streamfile->start + offset, length);
+}
 static size_t clamp_get_size(CLAMP_STREAMFILE *streamfile) {
     return streamfile->size;
 }
@@ -455,6 +1236,7 @@ STREAMFILE *open_clamp_streamfile(STREAMFILE *streamfile, off_t start, size_t si
     this_sf->sf.get_name = (void*)clamp_get_name;
     this_sf->sf.open = (void*)clamp_open;
     this_sf->sf.close = (void*)clamp_close;
+    this_sf->sf.peek = (void*)clamp_peek;
     this_sf->sf.stream_index = streamfile->stream_index;
 
     this_sf->inner_sf = streamfile;
@@ -550,6 +1332,10 @@ typedef struct {
 static size_t fakename_read(FAKENAME_STREAMFILE *streamfile, uint8_t * dest, off_t offset, size_t length) {
     return streamfile->inner_sf->read(streamfile->inner_sf, dest, offset, length); /* default */
 }
+static const uint8_t * fakename_peek(FAKENAME_STREAMFILE *streamfile, off_t offset, size_t length) {
+    if (!streamfile->inner_sf->peek) return NULL;
+    return streamfile->inner_sf->peek(streamfile->inner_sf, offset, length); /* default */
+}
 static size_t fakename_get_size(FAKENAME_STREAMFILE * streamfile) {
     return streamfile->inner_sf->get_size(streamfile->inner_sf); /* default */
 }
@@ -594,6 +1380,7 @@ STREAMFILE *open_fakename_streamfile(STREAMFILE *streamfile, const char * fakena
     this_sf->sf.get_name = (void*)fakename_get_name;
     this_sf->sf.open = (void*)fakename_open;
     this_sf->sf.close = (void*)fakename_close;
+    this_sf->sf.peek = (void*)fakename_peek;
     this_sf->sf.stream_index = streamfile->stream_index;
 
     this_sf->inner_sf = streamfile;
@@ -616,6 +1403,75 @@ STREAMFILE *open_fakename_streamfile(STREAMFILE *streamfile, const char * fakena
 
 /* **************************************************** */
 
+typedef struct {
+    STREAMFILE sf;
+
+    STREAMFILE_PROBE * probe;
+} PROBE_STREAMFILE;
+
+static size_t probe_read(PROBE_STREAMFILE *streamfile, uint8_t * dest, off_t offset, size_t length) {
+    streamfile->probe->used = 1;
+    return 0;
+}
+static size_t probe_get_size(PROBE_STREAMFILE * streamfile) {
+    streamfile->probe->used = 1;
+    return 0;
+}
+static off_t probe_get_offset(PROBE_STREAMFILE * streamfile) {
+    return 0;
+}
+static void probe_get_name(PROBE_STREAMFILE *streamfile, char *buffer, size_t length) {
+    streamfile->probe->used = 1;
+    strncpy(buffer, "vgmstream_probe", length);
+    buffer[length-1] = '\0';
+}
+static STREAMFILE *probe_open(PROBE_STREAMFILE *streamfile, const char * const filename, size_t buffersize) {
+    streamfile->probe->used = 1;
+    return NULL;
+}
+static void probe_close(PROBE_STREAMFILE *streamfile) {
+    free(streamfile);
+}
+
+STREAMFILE *open_probe_streamfile(STREAMFILE_PROBE * probe) {
+    PROBE_STREAMFILE *this_sf;
+
+    if (!probe) return NULL;
+
+    this_sf = calloc(1,sizeof(PROBE_STREAMFILE));
+    if (!this_sf) return NULL;
+
+    /* set callbacks and internals */
+    this_sf->sf.read = (void*)probe_read;
+    this_sf->sf.get_size = (void*)probe_get_size;
+    this_sf->sf.get_offset = (void*)probe_get_offset;
+    this_sf->sf.get_name = (void*)probe_get_name;
+    this_sf->sf.open = (void*)probe_open;
+    this_sf->sf.close = (void*)probe_close;
+
+    this_sf->probe = probe;
+
+    return &this_sf->sf;
+}
+
+/* probe streamfiles record extension lists instead of matching */
+static void probe_check_extensions(PROBE_STREAMFILE *streamfile, const char * cmp_exts) {
+    STREAMFILE_PROBE * probe = streamfile->probe;
+    size_t used = strlen(probe->exts);
+
+    probe->checked = 1;
+    if (used + 1 + strlen(cmp_exts) + 1 > sizeof(probe->exts)) {
+        probe->used = 1; /* can't tell all extensions apart */
+        return;
+    }
+
+    if (used > 0)
+        probe->exts[used++] = ',';
+    strcpy(probe->exts + used, cmp_exts);
+}
+
+/* **************************************************** */
+
 
 typedef struct {
     STREAMFILE sf;
@@ -998,6 +1854,11 @@ int check_extensions(STREAMFILE *streamFile, const char * cmp_exts) {
     const char * ststr_res = NULL;
     size_t ext_len, cmp_len;
 
+    if (streamFile->read == (void*)probe_read) {
+        probe_check_extensions((PROBE_STREAMFILE*)streamFile, cmp_exts);
+        return 0;
+    }
+
     streamFile->get_name(streamFile,filename,sizeof(filename));
     ext = filename_extension(filename);
     ext_len = strlen(ext);
@@ -47,6 +47,16 @@
 
 #define STREAMFILE_DEFAULT_BUFFER_SIZE 0x8000
 
+/* memory-mapped files, with mmap or Windows file mappings (the Switch's newlib has neither) */
+#if !defined(VGM_NO_MMAP) && !defined(__SWITCH__) && (defined(_WIN32) || defined(__unix__) || defined(__APPLE__))
+#define VGM_USE_MMAP
+#endif
+
+/* background threads (pthreads, also provided by the Switch's newlib) */
+#if !defined(VGM_NO_THREADS) && !defined(_WIN32)
+#define VGM_USE_THREADS
+#endif
+
 #ifndef DIR_SEPARATOR
 #if defined (_WIN32) || defined (WIN32)
 #define DIR_SEPARATOR '\\'
@@ -67,6 +77,11 @@ typedef struct _STREAMFILE {
     struct _STREAMFILE * (*open)(struct _STREAMFILE *,const char * const filename,size_t buffersize);
     void (*close)(struct _STREAMFILE *);
 
+    /* Optional zero-copy access: returns a pointer to length bytes at offset if the implementation
+     * already holds them contiguously in memory (mapped file, internal buffer), NULL otherwise
+     * (caller must read instead). Only valid until the next call on the same streamfile. */
+    const uint8_t * (*peek)(struct _STREAMFILE *, off_t offset, size_t length);
+
 
     /* Substream selection for files with subsongs. Manually used in metas if supported.
      * Not ideal here, but it's the simplest way to pass to all init_vgmstream_x functions. */
@@ -75,17 +90,30 @@ typedef struct _STREAMFILE {
 } STREAMFILE;
 
 /* Opens a standard STREAMFILE, opening from path.
- * Uses stdio (FILE) for operations, thus plugins may not want to use it. */
+ * Uses stdio (FILE) for operations, thus plugins may not want to use it.
+ * Reads go through a page cache shared by all stdio streamfiles, and reopening the same
+ * file (one per channel) shares the FILE and its cached pages. */
 STREAMFILE *open_stdio_streamfile(const char * filename);
 
 /* Opens a standard STREAMFILE from a pre-opened FILE. */
 STREAMFILE *open_stdio_streamfile_by_file(FILE * file, const char * filename);
 
+/* Opens a STREAMFILE that maps the whole file read-only, so reads are a bounds-checked memcpy
+ * rather than buffer refills with fseek+fread. Returns NULL if mapping isn't available or fails
+ * (no VGM_USE_MMAP like on Switch, empty files, etc), in which case stdio should be used instead. */
+STREAMFILE *open_mmap_streamfile(const char * filename);
+
 /* Opens a STREAMFILE that does buffered IO.
  * Can be used when the underlying IO may be slow (like when using custom IO).
  * Buffer size is optional. */
 STREAMFILE *open_buffer_streamfile(STREAMFILE *streamfile, size_t buffer_size);
 
+/* Opens a STREAMFILE that prefetches blocks on a shared IO thread once reads become sequential,
+ * so decoding rarely waits on slow storage (SD cards). Block size and count are optional.
+ * Returns NULL if threads aren't available or the global read-ahead memory budget is spent,
+ * in which case the original streamfile should be used as is. Reopens wrap again (per channel). */
+STREAMFILE *open_readahead_streamfile(STREAMFILE *streamfile, size_t block_size, int blocks);
+
 /* Opens a STREAMFILE that doesn't close the underlying streamfile.
  * Calls to open won't wrap the new SF (assumes it needs to be closed).
  * Can be used in metas to test custom IO without closing the external SF. */
@@ -111,6 +139,17 @@ STREAMFILE *open_fakename_streamfile(STREAMFILE *streamfile, const char * fakena
  * The first streamfile is used to get names, stream index and so on. */
 STREAMFILE *open_multifile_streamfile(STREAMFILE **streamfiles, size_t streamfiles_size);
 
+/* What an init function did with a probe STREAMFILE (see below). */
+typedef struct {
+    int used;               /* read/size/name/open called outside check_extensions (or exts overflowed) */
+    int checked;            /* check_extensions was called */
+    char exts[0x400];       /* lists passed to check_extensions, comma-separated */
+} STREAMFILE_PROBE;
+
+/* Opens an empty STREAMFILE that records in probe how it's used, with check_extensions never matching.
+ * Used to learn which extensions each meta accepts, to build the probe index. */
+STREAMFILE *open_probe_streamfile(STREAMFILE_PROBE * probe);
+
 /* Opens a STREAMFILE from a (path)+filename.
  * Just a wrapper, to avoid having to access the STREAMFILE's callbacks directly. */
 STREAMFILE * open_streamfile(STREAMFILE *streamFile, const char * pathname);
@@ -139,6 +178,23 @@ static inline size_t read_streamfile(uint8_t * dest, off_t offset, size_t length
     return streamfile->read(streamfile,dest,offset,length);
 }
 
+/* Gets length bytes at offset, without copying if the streamfile supports peek, or else reading them
+ * into buf (which must hold length bytes). Bytes past EOF are 0xFF, same as a failed read_8bit.
+ * Meant for decoders that want a whole frame at once rather than one read_8bit per nibble. */
+static inline const uint8_t * peek_streamfile(uint8_t * buf, off_t offset, size_t length, STREAMFILE * streamfile) {
+    size_t bytes;
+
+    if (streamfile->peek) {
+        const uint8_t * data = streamfile->peek(streamfile,offset,length);
+        if (data) return data;
+    }
+
+    bytes = read_streamfile(buf,offset,length,streamfile);
+    if (bytes < length)
+        memset(buf + bytes, 0xFF, length - bytes);
+    return buf;
+}
+
 /* return file size */
 static inline size_t get_streamfile_size(STREAMFILE * streamfile) {
     return streamfile->get_size(streamfile);
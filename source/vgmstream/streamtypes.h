@@ -29,7 +29,17 @@
 #include <stdint.h>
 #endif /* _MSC_VER */
 
-typedef int16_t sample; //TODO: deprecated, remove
+/* Internal sample format, int16 by default or wider when built with VGM_SAMPLE_INT32/VGM_SAMPLE_FLOAT.
+ * All use the 16-bit scale (full scale is +-32768), wider ones just keep the headroom and precision
+ * lost between stages (codecs that decode to float, layouts, mixing) until the final conversion. */
+#if defined(VGM_SAMPLE_FLOAT)
+typedef float sample_t;
+#elif defined(VGM_SAMPLE_INT32)
+typedef int32_t sample_t;
+#else
+#define VGM_SAMPLE_INT16
 typedef int16_t sample_t;
+#endif
+typedef sample_t sample; //TODO: deprecated, remove
 
 #endif
@@ -1,6 +1,14 @@
 #include <string.h>
 #include "util.h"
 #include "streamtypes.h"
+#include "streamfile.h"
+#ifdef VGM_USE_THREADS
+#ifdef __SWITCH__
+#include <switch.h>
+#else
+#include <unistd.h>
+#endif
+#endif
 
 const char * filename_extension(const char * pathname) {
     const char * filename;
@@ -88,6 +96,11 @@ void put_32bitLE(uint8_t * buf, int32_t i) {
     buf[3] = (uint8_t)((i >> 24) & 0xFF);
 }
 
+void put_64bitLE(uint8_t * buf, int64_t i) {
+    put_32bitLE(buf + 0x00, (int32_t)(i & 0xFFFFFFFF));
+    put_32bitLE(buf + 0x04, (int32_t)(i >> 32));
+}
+
 void put_16bitBE(uint8_t * buf, int16_t i) {
     buf[0] = i >> 8;
     buf[1] = (i & 0xFF);
@@ -100,7 +113,7 @@ void put_32bitBE(uint8_t * buf, int32_t i) {
     buf[3] = (uint8_t)(i & 0xFF);
 }
 
-void swap_samples_le(sample_t *buf, int count) {
+void swap_samples_le(int16_t *buf, int count) {
     int i;
     for (i = 0; i < count; i++) {
         uint8_t b0 = buf[i] & 0xff;
@@ -121,3 +134,24 @@ void concatn(int length, char * dst, const char * src) {
         dst[i]=src[j];
     dst[i]='\0';
 }
+
+int get_worker_thread_count(int max) {
+#if !defined(VGM_USE_THREADS)
+    return 0;
+#elif defined(__SWITCH__)
+    return max < 2 ? max : 2; /* 3 cores for applications */
+#else
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores <= 1)
+        return 0; /* workers would only take turns with the calling thread */
+    return cores - 1 < max ? cores - 1 : max;
+#endif
+}
+
+void set_worker_thread_core(int index) {
+#if defined(VGM_USE_THREADS) && defined(__SWITCH__)
+    /* threads start on the creator's core, move to another one so they actually run at once */
+    int core = 1 + index % 2;
+    svcSetThreadCoreMask(CUR_THREAD_HANDLE, core, 1 << core);
+#endif
+}
@@ -9,27 +9,27 @@
 
 /* host endian independent multi-byte integer reading */
 
-static inline int16_t get_16bitBE(uint8_t * p) {
+static inline int16_t get_16bitBE(const uint8_t * p) {
     return (p[0]<<8) | (p[1]);
 }
 
-static inline int16_t get_16bitLE(uint8_t * p) {
+static inline int16_t get_16bitLE(const uint8_t * p) {
     return (p[0]) | (p[1]<<8);
 }
 
-static inline int32_t get_32bitBE(uint8_t * p) {
+static inline int32_t get_32bitBE(const uint8_t * p) {
     return (p[0]<<24) | (p[1]<<16) | (p[2]<<8) | (p[3]);
 }
 
-static inline int32_t get_32bitLE(uint8_t * p) {
+static inline int32_t get_32bitLE(const uint8_t * p) {
     return (p[0]) | (p[1]<<8) | (p[2]<<16) | (p[3]<<24);
 }
 
-static inline int64_t get_64bitBE(uint8_t * p) {
+static inline int64_t get_64bitBE(const uint8_t * p) {
     return (uint64_t)(((uint64_t)p[0]<<56) | ((uint64_t)p[1]<<48) | ((uint64_t)p[2]<<40) | ((uint64_t)p[3]<<32) | ((uint64_t)p[4]<<24) | ((uint64_t)p[5]<<16) | ((uint64_t)p[6]<<8) | ((uint64_t)p[7]));
 }
 
-static inline int64_t get_64bitLE(uint8_t * p) {
+static inline int64_t get_64bitLE(const uint8_t * p) {
     return (uint64_t)(((uint64_t)p[0]) | ((uint64_t)p[1]<<8) | ((uint64_t)p[2]<<16) | ((uint64_t)p[3]<<24) | ((uint64_t)p[4]<<32) | ((uint64_t)p[5]<<40) | ((uint64_t)p[6]<<48) | ((uint64_t)p[7]<<56));
 }
 
@@ -39,6 +39,8 @@ void put_16bitLE(uint8_t * buf, int16_t i);
 
 void put_32bitLE(uint8_t * buf, int32_t i);
 
+void put_64bitLE(uint8_t * buf, int64_t i);
+
 void put_16bitBE(uint8_t * buf, int16_t i);
 
 void put_32bitBE(uint8_t * buf, int32_t i);
@@ -67,6 +69,21 @@ static inline int clamp16(int32_t val) {
     return val;
 }
 
+/* converts a float on the 16-bit scale to the internal format (truncated, clamped to its range) */
+static inline sample_t float_to_sample(float f) {
+#if defined(VGM_SAMPLE_FLOAT)
+    return f;
+#elif defined(VGM_SAMPLE_INT32)
+    if (f > 2147483520.0f) return 2147483520;
+    if (f < -2147483648.0f) return (-2147483647 - 1);
+    return (int32_t)f;
+#else
+    if (f > 32767.0f) return 32767;
+    if (f < -32768.0f) return -32768;
+    return (int16_t)f;
+#endif
+}
+
 static inline int round10(int val) {
     int round_val = val % 10;
     if (round_val < 5) /* half-down rounding */
@@ -79,10 +96,15 @@ static inline int round10(int val) {
  * extension in the original filename or the ending null byte if no extension */
 const char * filename_extension(const char * filename);
 
-void swap_samples_le(sample *buf, int count);
+void swap_samples_le(int16_t *buf, int count); /* 16-bit PCM from libs */
 
 void concatn(int length, char * dst, const char * src);
 
+/* helpers for worker threads (see VGM_USE_THREADS): number of extra threads worth starting
+ * (up to max, 0 without threads or spare cores) and moving a worker to its own core if needed */
+int get_worker_thread_count(int max);
+void set_worker_thread_core(int index);
+
 
 /* Simple stdout logging for debugging and regression testing purposes.
  * Needs C99 variadic macros, uses do..while to force ";" as statement */
@@ -5,14 +5,25 @@
 #include <stdio.h>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
+#include <time.h>
 #include "vgmstream.h"
 #include "meta/meta.h"
 #include "layout/layout.h"
 #include "coding/coding.h"
 #include "mixing.h"
+#include "seek_index.h"
+#ifdef VGM_USE_THREADS
+#include <pthread.h>
+#endif
 
 static void try_dual_file_stereo(VGMSTREAM * opened_vgmstream, STREAMFILE *streamFile, VGMSTREAM* (*init_vgmstream_function)(STREAMFILE*));
 
+typedef void (*layout_render_t)(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+typedef void (*frame_decode_t)(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
+static layout_render_t get_vgmstream_layout_render(VGMSTREAM * vgmstream);
+static frame_decode_t get_vgmstream_frame_decode(VGMSTREAM * vgmstream);
+
 
 /* list of metadata parser functions that will recognize files, used on init */
 VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
@@ -491,18 +502,232 @@ VGMSTREAM * (*init_vgmstream_functions[])(STREAMFILE *streamFile) = {
 };
 
 
+/* Probe index: most metas start with check_extensions and fail right away on other files, so on
+ * first use each init function is called once with an empty probe STREAMFILE to learn which
+ * extensions it accepts. Files are then only tried with the metas accepting their extension, plus
+ * those that can't be indexed (they look at data or the name first, or don't check extensions),
+ * in the usual order, so detection results don't change.
+ *
+ * There is no equivalent magic index, as header checks are plain code and can't be learned this
+ * way (and learning from past detections could change which meta wins for ambiguous files). */
+
+#define INIT_VGMSTREAM_FUNCTIONS (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]))
+#define PROBE_EXT_MAX 16
+
+typedef struct {
+    char ext[PROBE_EXT_MAX];    /* lowercase */
+    int function;
+} probe_entry;
+
+static struct {
+    int building;               /* set while init functions are being probed */
+    probe_entry * entries;      /* sorted by ext then function (NULL if not built: try everything) */
+    int entries_count;
+    int unindexed[INIT_VGMSTREAM_FUNCTIONS]; /* always tried */
+    int unindexed_count;
+
+    int stats_enabled;
+    vgmstream_probe_stats stats;
+} probe_index;
+
+static int compare_probe_entry(const void * a, const void * b) {
+    const probe_entry * entry_a = a;
+    const probe_entry * entry_b = b;
+    int res = strcmp(entry_a->ext, entry_b->ext);
+    return res != 0 ? res : entry_a->function - entry_b->function;
+}
+
+static void lowercase_ext(char * dst, const char * src, size_t len) {
+    size_t i;
+    for (i = 0; i < len; i++) {
+        dst[i] = tolower((unsigned char)src[i]);
+    }
+    dst[len] = '\0';
+}
+
+/* adds all extensions in a check_extensions list, or returns 0 if some is too long to index */
+static int add_probe_entries(int function, const char * exts, int * capacity) {
+    const char * ext;
+    const char * next;
+
+    for (ext = exts; ext != NULL; ext = next) {
+        const char * comma = strchr(ext, ',');
+        size_t len = comma ? (size_t)(comma - ext) : strlen(ext);
+        next = comma ? comma + 1 : NULL;
+
+        if (len >= PROBE_EXT_MAX)
+            return 0;
+
+        if (probe_index.entries_count == *capacity) {
+            int new_capacity = *capacity ? *capacity * 2 : 1024;
+            probe_entry * new_entries = realloc(probe_index.entries, new_capacity * sizeof(probe_entry));
+            if (!new_entries) return 0;
+            probe_index.entries = new_entries;
+            *capacity = new_capacity;
+        }
+
+        lowercase_ext(probe_index.entries[probe_index.entries_count].ext, ext, len);
+        probe_index.entries[probe_index.entries_count].function = function;
+        probe_index.entries_count++;
+    }
+
+    return 1;
+}
+
+static void build_probe_index(void) {
+    STREAMFILE_PROBE probe;
+    STREAMFILE * probeFile;
+    int i, count, capacity = 0;
+
+    probeFile = open_probe_streamfile(&probe);
+    if (!probeFile)
+        return;
+
+    probe_index.building = 1;
+    for (i = 0; i < INIT_VGMSTREAM_FUNCTIONS; i++) {
+        int entries_start = probe_index.entries_count;
+        VGMSTREAM * vgmstream;
+
+        memset(&probe, 0, sizeof(probe));
+        vgmstream = (init_vgmstream_functions[i])(probeFile);
+        if (vgmstream) { /* shouldn't happen with no data */
+            close_vgmstream(vgmstream);
+            probe.used = 1;
+        }
+
+        if (!probe.checked || probe.used || !add_probe_entries(i, probe.exts, &capacity)) {
+            probe_index.entries_count = entries_start;
+            probe_index.unindexed[probe_index.unindexed_count++] = i;
+        }
+    }
+    probe_index.building = 0;
+    close_streamfile(probeFile);
+
+    if (!probe_index.entries) /* nothing indexed or no memory */
+        return;
+
+    /* sort and remove repeated extensions per function (like "wav" in lwav checks) */
+    qsort(probe_index.entries, probe_index.entries_count, sizeof(probe_entry), compare_probe_entry);
+    for (i = 1, count = 1; i < probe_index.entries_count; i++) {
+        if (compare_probe_entry(&probe_index.entries[i], &probe_index.entries[count-1]) != 0)
+            probe_index.entries[count++] = probe_index.entries[i];
+    }
+    probe_index.entries_count = count;
+}
+
+#ifdef VGM_USE_THREADS
+static pthread_once_t probe_index_once = PTHREAD_ONCE_INIT;
+#endif
+
+/* gets init functions to try for a file, in priority order */
+static int get_probe_candidates(STREAMFILE * streamFile, int * candidates) {
+    char filename[PATH_LIMIT];
+    char ext[PROBE_EXT_MAX];
+    const char * file_ext;
+    int i, count = 0, unindexed = 0, lo, hi;
+
+    /* metas may init other files while being probed */
+    if (!probe_index.building) {
+#ifdef VGM_USE_THREADS
+        pthread_once(&probe_index_once, build_probe_index);
+#else
+        static int built = 0;
+        if (!built) {
+            built = 1;
+            build_probe_index();
+        }
+#endif
+    }
+
+    if (probe_index.building || !probe_index.entries) {
+        for (i = 0; i < INIT_VGMSTREAM_FUNCTIONS; i++) {
+            candidates[i] = i;
+        }
+        return INIT_VGMSTREAM_FUNCTIONS;
+    }
+
+    /* find the first entry for this extension (too long ones can't be indexed, so only unindexed apply) */
+    get_streamfile_name(streamFile, filename, sizeof(filename));
+    file_ext = filename_extension(filename);
+    lo = hi = probe_index.entries_count;
+    if (strlen(file_ext) < PROBE_EXT_MAX) {
+        lowercase_ext(ext, file_ext, strlen(file_ext));
+        lo = 0;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (strcmp(probe_index.entries[mid].ext, ext) < 0)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        for (hi = lo; hi < probe_index.entries_count && strcmp(probe_index.entries[hi].ext, ext) == 0; hi++) {
+            ;
+        }
+    }
+
+    /* merge both lists, sorted by function */
+    while (lo < hi || unindexed < probe_index.unindexed_count) {
+        if (unindexed == probe_index.unindexed_count ||
+                (lo < hi && probe_index.entries[lo].function < probe_index.unindexed[unindexed]))
+            candidates[count++] = probe_index.entries[lo++].function;
+        else
+            candidates[count++] = probe_index.unindexed[unindexed++];
+    }
+
+    return count;
+}
+
+static double get_probe_time_ms(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+#else
+    return clock() * 1000.0 / CLOCKS_PER_SEC;
+#endif
+}
+
+static void set_probe_stats(vgmstream_probe_stats * stats, double start) {
+    if (probe_index.stats_enabled) {
+        stats->time_ms = get_probe_time_ms() - start;
+        VGM_LOG("VGMSTREAM: probe %.3f ms, tried %i of %i candidates\n", stats->time_ms, stats->tried, stats->candidates);
+    }
+    probe_index.stats = *stats;
+}
+
+void vgmstream_probe_stats_enable(int enable) {
+    probe_index.stats_enabled = enable;
+}
+
+void vgmstream_get_probe_stats(vgmstream_probe_stats * stats) {
+    *stats = probe_index.stats;
+}
+
+
 /* internal version with all parameters */
 static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile) {
-    int i, fcns_size;
-    
+    int candidates[INIT_VGMSTREAM_FUNCTIONS];
+    int c, i, candidates_size;
+    vgmstream_probe_stats stats = {0};
+    double start = 0;
+
     if (!streamFile)
         return NULL;
 
-    fcns_size = (sizeof(init_vgmstream_functions)/sizeof(init_vgmstream_functions[0]));
+    if (probe_index.stats_enabled)
+        start = get_probe_time_ms();
+
+    candidates_size = get_probe_candidates(streamFile, candidates);
+    stats.candidates = candidates_size;
+
     /* try a series of formats, see which works */
-    for (i =0; i < fcns_size; i++) {
+    for (c = 0; c < candidates_size; c++) {
+        VGMSTREAM * vgmstream;
+
         /* call init function and see if valid VGMSTREAM was returned */
-        VGMSTREAM * vgmstream = (init_vgmstream_functions[i])(streamFile);
+        i = candidates[c];
+        stats.tried++;
+        vgmstream = (init_vgmstream_functions[i])(streamFile);
         if (!vgmstream)
             continue;
 
@@ -591,15 +816,23 @@ static VGMSTREAM * init_vgmstream_internal(STREAMFILE *streamFile) {
 
         setup_vgmstream(vgmstream); /* final setup */
 
+        set_probe_stats(&stats, start);
         return vgmstream;
     }
 
     /* not supported */
+    set_probe_stats(&stats, start);
     return NULL;
 }
 
 void setup_vgmstream(VGMSTREAM * vgmstream) {
 
+    seek_index_init(vgmstream);
+    block_index_init(vgmstream);
+
+    vgmstream->layout_render = get_vgmstream_layout_render(vgmstream);
+    vgmstream->frame_decode = get_vgmstream_frame_decode(vgmstream);
+
     /* save start things so we can restart when seeking */
     memcpy(vgmstream->start_ch, vgmstream->ch, sizeof(VGMSTREAMCHANNEL)*vgmstream->channels);
     memcpy(vgmstream->start_vgmstream, vgmstream, sizeof(VGMSTREAM));
@@ -612,7 +845,17 @@ void setup_vgmstream(VGMSTREAM * vgmstream) {
 /* format detection and VGMSTREAM setup, uses default parameters */
 VGMSTREAM * init_vgmstream(const char * const filename) {
     VGMSTREAM *vgmstream = NULL;
-    STREAMFILE *streamFile = open_stdio_streamfile(filename);
+    STREAMFILE *streamFile = open_mmap_streamfile(filename);
+    if (!streamFile) {
+        streamFile = open_stdio_streamfile(filename);
+
+        /* storage may be slow (SD cards), keep decoding off the refill path if possible */
+        if (streamFile) {
+            STREAMFILE *readaheadFile = open_readahead_streamfile(streamFile, 0, 0);
+            if (readaheadFile)
+                streamFile = readaheadFile;
+        }
+    }
     if (streamFile) {
         vgmstream = init_vgmstream_from_STREAMFILE(streamFile);
         close_streamfile(streamFile);
@@ -635,6 +878,8 @@ void reset_vgmstream(VGMSTREAM * vgmstream) {
      * Otherwise hit_loop will be 0 and it will be copied over anyway when we
      * really hit the loop start. */
 
+    seek_index_reset(vgmstream);
+
     /* reset custom codec */
 #ifdef VGM_USE_VORBIS
     if (vgmstream->coding_type == coding_OGG_VORBIS) {
@@ -728,6 +973,136 @@ void reset_vgmstream(VGMSTREAM * vgmstream) {
      * (vgmstream->ch[N].streamfiles' internal state, though shouldn't matter) */
 }
 
+#define SEEK_DISCARD_SAMPLES 1024
+#define SEEK_WARMUP_SAMPLES 4096
+
+/* decodes and throws away samples (the slow path, always correct) */
+static void seek_discard(VGMSTREAM * vgmstream, int32_t sample_count) {
+    sample_t *buffer;
+    int input_channels = vgmstream->channels, output_channels = vgmstream->channels;
+
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    buffer = malloc(SEEK_DISCARD_SAMPLES * input_channels * sizeof(sample_t));
+    if (!buffer) return;
+
+    while (sample_count > 0) {
+        int32_t samples_to_do = sample_count > SEEK_DISCARD_SAMPLES ? SEEK_DISCARD_SAMPLES : sample_count;
+
+        render_vgmstream(buffer, samples_to_do, vgmstream);
+        sample_count -= samples_to_do;
+    }
+
+    free(buffer);
+}
+
+/* jumps codecs that can seek on their own, whose state lives in codec_data */
+static void seek_codec(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    if (seek_sample <= vgmstream->current_sample || seek_sample >= vgmstream->num_samples)
+        return;
+
+    if (vgmstream->coding_type == coding_NWA && vgmstream->layout_type == layout_none) {
+        nwa_codec_data *data = vgmstream->codec_data;
+        if (!data) return;
+
+        if (!seek_nwa(data->nwa, seek_sample))
+            return; /* decoded up to seek_sample instead */
+        vgmstream->samples_into_block += seek_sample - vgmstream->current_sample;
+        vgmstream->current_sample = seek_sample;
+    }
+
+    if (vgmstream->coding_type == coding_CRI_HCA && vgmstream->layout_type == layout_none) {
+        hca_codec_data *data = vgmstream->codec_data;
+        if (!data) return;
+
+        seek_hca(data, seek_sample);
+        vgmstream->samples_into_block += seek_sample - vgmstream->current_sample;
+        vgmstream->current_sample = seek_sample;
+    }
+}
+
+/* moves forward to a stream sample (not crossing loop end), jumping with the layout when possible
+ * and decoding what's left (codec warm-up, partial blocks, unsupported codecs) */
+static void seek_forward(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int32_t layout_sample;
+
+    /* exact points learned while playing first, layouts may then jump further */
+    seek_index_restore(vgmstream, seek_sample);
+
+    seek_codec(vgmstream, seek_sample);
+
+    layout_sample = vgmstream->current_sample;
+    switch (vgmstream->layout_type) {
+        case layout_none:
+            seek_layout_flat(vgmstream, seek_sample);
+            break;
+        case layout_interleave:
+            seek_layout_interleave(vgmstream, seek_sample);
+            break;
+        case layout_segmented:
+            seek_layout_segmented(vgmstream, seek_sample);
+            break;
+        case layout_layered:
+            break;
+        default: /* blocked */
+            seek_layout_blocked(vgmstream, seek_sample);
+            break;
+    }
+
+    /* history after a warm-up is close but not exact, don't learn from it */
+    if (vgmstream->current_sample != layout_sample && get_vgmstream_seek_warmup(vgmstream) > 0)
+        seek_index_pause(vgmstream);
+
+    if (vgmstream->current_sample < seek_sample)
+        seek_discard(vgmstream, seek_sample - vgmstream->current_sample);
+}
+
+void seek_vgmstream(VGMSTREAM * vgmstream, int32_t seek_sample) {
+    int32_t stream_sample;
+    int loop_count = 0;
+
+    if (seek_sample < 0)
+        seek_sample = 0;
+
+    reset_vgmstream(vgmstream);
+
+    /* layers loop on their own */
+    if (vgmstream->layout_type == layout_layered) {
+        seek_layout_layered(vgmstream, seek_sample);
+        return;
+    }
+
+    /* find the stream sample and loop count that rendering seek_sample samples would reach */
+    stream_sample = seek_sample;
+    if (vgmstream->loop_flag && vgmstream->loop_end_sample > vgmstream->loop_start_sample
+            && seek_sample > vgmstream->loop_end_sample) {
+        int32_t loop_samples = vgmstream->loop_end_sample - vgmstream->loop_start_sample;
+        int32_t loops = (seek_sample - vgmstream->loop_start_sample) / loop_samples;
+
+        if (vgmstream->loop_target && loops >= vgmstream->loop_target) {
+            /* past the last loop, continues to the end like vgmstream_do_loop */
+            loop_count = vgmstream->loop_target;
+            stream_sample = seek_sample - (vgmstream->loop_target - 1) * loop_samples;
+            vgmstream->loop_flag = 0; /* restored on reset */
+        }
+        else {
+            loop_count = loops;
+            stream_sample = vgmstream->loop_start_sample + (seek_sample - vgmstream->loop_start_sample) % loop_samples;
+        }
+    }
+    if (stream_sample > vgmstream->num_samples)
+        stream_sample = vgmstream->num_samples;
+
+    /* loop start state must be saved as rendering would */
+    if (vgmstream->loop_flag && stream_sample > vgmstream->loop_start_sample
+            && vgmstream->loop_end_sample > vgmstream->loop_start_sample) {
+        seek_forward(vgmstream, vgmstream->loop_start_sample);
+        vgmstream_do_loop(vgmstream);
+    }
+
+    seek_forward(vgmstream, stream_sample);
+    vgmstream->loop_count = loop_count;
+}
+
 /* Allocate memory and setup a VGMSTREAM */
 VGMSTREAM * allocate_vgmstream(int channel_count, int loop_flag) {
     VGMSTREAM * vgmstream;
@@ -927,6 +1302,8 @@ void close_vgmstream(VGMSTREAM * vgmstream) {
     }
 
     mixing_close(vgmstream);
+    seek_index_close(vgmstream);
+    block_index_close(vgmstream);
     free(vgmstream->ch);
     free(vgmstream->start_ch);
     free(vgmstream->loop_ch);
@@ -1017,15 +1394,13 @@ void vgmstream_set_loop_target(VGMSTREAM* vgmstream, int loop_target) {
 }
 
 
-/* Decode data into sample buffer */
-void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+/* get the render function for the stream's layout */
+static layout_render_t get_vgmstream_layout_render(VGMSTREAM * vgmstream) {
     switch (vgmstream->layout_type) {
         case layout_interleave:
-            render_vgmstream_interleave(buffer,sample_count,vgmstream);
-            break;
+            return render_vgmstream_interleave;
         case layout_none:
-            render_vgmstream_flat(buffer,sample_count,vgmstream);
-            break;
+            return render_vgmstream_flat;
         case layout_blocked_mxch:
         case layout_blocked_ast:
         case layout_blocked_halpst:
@@ -1064,21 +1439,69 @@ void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmst
         case layout_blocked_h4m:
         case layout_blocked_xa_aiff:
         case layout_blocked_vs_square:
-            render_vgmstream_blocked(buffer,sample_count,vgmstream);
-            break;
+            return render_vgmstream_blocked;
         case layout_segmented:
-            render_vgmstream_segmented(buffer,sample_count,vgmstream);
-            break;
+            return render_vgmstream_segmented;
         case layout_layered:
-            render_vgmstream_layered(buffer,sample_count,vgmstream);
-            break;
+            return render_vgmstream_layered;
         default:
-            break;
+            return NULL;
     }
+}
+
+/* Decode data into sample buffer */
+void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+    layout_render_t layout_render = vgmstream->layout_render;
+
+    /* resolved in setup_vgmstream, but not all sub-streams go through it */
+    if (!layout_render)
+        layout_render = get_vgmstream_layout_render(vgmstream);
+    if (layout_render)
+        layout_render(buffer, sample_count, vgmstream);
+
+    seek_index_record(vgmstream);
 
     mix_vgmstream(buffer, sample_count, vgmstream);
 }
 
+#define RENDER_S16_BUFFER_SIZE 0x1000
+
+void render_vgmstream_s16(int16_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream) {
+#ifdef VGM_SAMPLE_INT16
+    render_vgmstream(buffer, sample_count, vgmstream);
+#else
+    /* wider samples are rounded and clamped once, here */
+    sample_t temp[RENDER_S16_BUFFER_SIZE];
+    int input_channels, output_channels, max_channels;
+    int32_t samples_done = 0;
+
+    mixing_info(vgmstream, &input_channels, &output_channels);
+    max_channels = input_channels > output_channels ? input_channels : output_channels;
+
+    while (samples_done < sample_count) {
+        int32_t samples_to_do = RENDER_S16_BUFFER_SIZE / max_channels;
+        int s;
+
+        if (samples_to_do > sample_count - samples_done)
+            samples_to_do = sample_count - samples_done;
+
+        render_vgmstream(temp, samples_to_do, vgmstream);
+
+        for (s = 0; s < samples_to_do * output_channels; s++) {
+#ifdef VGM_SAMPLE_FLOAT
+            float f = temp[s] < 0 ? temp[s] - 0.5f : temp[s] + 0.5f;
+            buffer[s] = f > 32767.0f ? 32767 : (f < -32768.0f ? -32768 : (int16_t)f);
+#else
+            buffer[s] = clamp16(temp[s]);
+#endif
+        }
+
+        buffer += samples_to_do * output_channels;
+        samples_done += samples_to_do;
+    }
+#endif
+}
+
 /* Get the number of samples of a single frame (smallest self-contained sample group, 1/N channels) */
 int get_vgmstream_samples_per_frame(VGMSTREAM * vgmstream) {
     switch (vgmstream->coding_type) {
@@ -1468,11 +1891,148 @@ int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream) {
     }
 }
 
+/* Get the number of samples to decode before a seek point so codec state settles, for codecs that
+ * only keep state between frames in ch[] and find their frame from samples_into_block. */
+int get_vgmstream_seek_warmup(VGMSTREAM * vgmstream) {
+    switch (vgmstream->coding_type) {
+        /* no state, or state fully restored by each frame's header */
+        case coding_PCM16LE:
+        case coding_PCM16BE:
+        case coding_PCM16_int:
+        case coding_PCM8:
+        case coding_PCM8_int:
+        case coding_PCM8_U:
+        case coding_PCM8_U_int:
+        case coding_PCM8_SB:
+        case coding_XBOX_IMA:
+        case coding_APPLE_IMA4:
+            return 0;
+
+        /* history decays through the filters, so a few frames from silence converge (close to,
+         * but not always exactly, the decoded-from-start output) */
+        case coding_PSX:
+        case coding_PSX_badflags:
+        case coding_NGC_DSP:
+        case coding_XA:
+            return SEEK_WARMUP_SAMPLES;
+
+        /* IMA without frame headers (plain and DVI IMA) never forgets a wrong step index
+         * (no decay), so those must be decoded from the start or from seek index points */
+        default:
+            return -1;
+    }
+}
+
+/* Frame decoders: common codecs that only need the channel state and find their frame from
+ * first_sample (no moving offsets), so layouts may pass any number of whole frames at once. */
+#define FRAME_DECODE(name, call) \
+    static void frame_decode_##name(VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel) { \
+        call; \
+    }
+
+FRAME_DECODE(pcm16le,       decode_pcm16le(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(pcm16be,       decode_pcm16be(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(pcm16_int,     decode_pcm16_int(stream, outbuf, channelspacing, first_sample, samples_to_do, vgmstream->codec_endian))
+FRAME_DECODE(pcm8,          decode_pcm8(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(pcm8_int,      decode_pcm8_int(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(pcm8_u,        decode_pcm8_unsigned(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(pcm8_u_int,    decode_pcm8_unsigned_int(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(pcm8_sb,       decode_pcm8_sb(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(ulaw,          decode_ulaw(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(ulaw_int,      decode_ulaw_int(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(alaw,          decode_alaw(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(ngc_dsp,       decode_ngc_dsp(stream, outbuf, channelspacing, first_sample, samples_to_do))
+FRAME_DECODE(psx,           decode_psx(stream, outbuf, channelspacing, first_sample, samples_to_do, 0))
+FRAME_DECODE(psx_badflags,  decode_psx(stream, outbuf, channelspacing, first_sample, samples_to_do, 1))
+FRAME_DECODE(psx_cfg,       decode_psx_configurable(stream, outbuf, channelspacing, first_sample, samples_to_do, vgmstream->interleave_block_size))
+FRAME_DECODE(ima,           decode_standard_ima(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, channelspacing > 1, 0))
+FRAME_DECODE(ima_int,       decode_standard_ima(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, 0, 0))
+FRAME_DECODE(dvi_ima,       decode_standard_ima(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, channelspacing > 1, 1))
+FRAME_DECODE(dvi_ima_int,   decode_standard_ima(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, 0, 1))
+FRAME_DECODE(xbox_ima,      decode_xbox_ima(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, channelspacing > 1))
+FRAME_DECODE(xbox_ima_int,  decode_xbox_ima(stream, outbuf, channelspacing, first_sample, samples_to_do, channel, 0))
+FRAME_DECODE(apple_ima4,    decode_apple_ima4(stream, outbuf, channelspacing, first_sample, samples_to_do))
+
+/* get the frame decoder for the stream's codec (NULL if decode_vgmstream must handle it) */
+static frame_decode_t get_vgmstream_frame_decode(VGMSTREAM * vgmstream) {
+    /* sub-streams handle their own decoding */
+    if (vgmstream->layout_type == layout_segmented || vgmstream->layout_type == layout_layered)
+        return NULL;
+
+    switch (vgmstream->coding_type) {
+        case coding_PCM16LE:        return frame_decode_pcm16le;
+        case coding_PCM16BE:        return frame_decode_pcm16be;
+        case coding_PCM16_int:      return frame_decode_pcm16_int;
+        case coding_PCM8:           return frame_decode_pcm8;
+        case coding_PCM8_int:       return frame_decode_pcm8_int;
+        case coding_PCM8_U:         return frame_decode_pcm8_u;
+        case coding_PCM8_U_int:     return frame_decode_pcm8_u_int;
+        case coding_PCM8_SB:        return frame_decode_pcm8_sb;
+        case coding_PCM4:           return decode_pcm4;
+        case coding_PCM4_U:         return decode_pcm4_unsigned;
+        case coding_ULAW:           return frame_decode_ulaw;
+        case coding_ULAW_int:       return frame_decode_ulaw_int;
+        case coding_ALAW:           return frame_decode_alaw;
+        case coding_NGC_DSP:        return frame_decode_ngc_dsp;
+        case coding_PSX:            return frame_decode_psx;
+        case coding_PSX_badflags:   return frame_decode_psx_badflags;
+        case coding_PSX_cfg:        return frame_decode_psx_cfg;
+        case coding_IMA:            return frame_decode_ima;
+        case coding_IMA_int:        return frame_decode_ima_int;
+        case coding_DVI_IMA:        return frame_decode_dvi_ima;
+        case coding_DVI_IMA_int:    return frame_decode_dvi_ima_int;
+        case coding_XBOX_IMA:       return frame_decode_xbox_ima;
+        case coding_XBOX_IMA_int:   return frame_decode_xbox_ima_int;
+        case coding_APPLE_IMA4:     return frame_decode_apple_ima4;
+        default:                    return NULL;
+    }
+}
+
+/* frame decoders that walk any number of frames on their own */
+static int is_frame_decode_multi(frame_decode_t frame_decode) {
+    return frame_decode == frame_decode_psx || frame_decode == frame_decode_psx_badflags || frame_decode == frame_decode_psx_cfg;
+}
+
+/* decodes a run of samples that may span many frames, one frame per channel at a time
+ * (or the whole run per channel for decoders that can) */
+static void decode_frames(VGMSTREAM * vgmstream, frame_decode_t frame_decode, int samples_written, int samples_to_do, sample_t * buffer) {
+    int samples_per_frame = is_frame_decode_multi(frame_decode) ? 1 : get_vgmstream_samples_per_frame(vgmstream);
+    int32_t first_sample = vgmstream->samples_into_block;
+    int ch;
+
+    while (samples_to_do > 0) {
+        int samples_this_frame = samples_to_do;
+
+        if (samples_per_frame > 1 && first_sample % samples_per_frame + samples_this_frame > samples_per_frame)
+            samples_this_frame = samples_per_frame - first_sample % samples_per_frame;
+
+        for (ch = 0; ch < vgmstream->channels; ch++) {
+            frame_decode(vgmstream, &vgmstream->ch[ch], buffer+samples_written*vgmstream->channels+ch,
+                    vgmstream->channels, first_sample, samples_this_frame, ch);
+        }
+
+        first_sample += samples_this_frame;
+        samples_written += samples_this_frame;
+        samples_to_do -= samples_this_frame;
+    }
+}
+
 /* Decode samples into the buffer. Assume that we have written samples_written into the
  * buffer already, and we have samples_to_do consecutive samples ahead of us. */
 void decode_vgmstream(VGMSTREAM * vgmstream, int samples_written, int samples_to_do, sample_t * buffer) {
     int ch;
 
+    /* DSP decodes all channels at once, writing samples in order */
+    if (vgmstream->frame_decode == frame_decode_ngc_dsp && vgmstream->channels > 1) {
+        decode_ngc_dsp_mch(vgmstream, buffer+samples_written*vgmstream->channels, vgmstream->samples_into_block, samples_to_do);
+        return;
+    }
+
+    if (vgmstream->frame_decode) {
+        decode_frames(vgmstream, vgmstream->frame_decode, samples_written, samples_to_do, buffer);
+        return;
+    }
+
     switch (vgmstream->coding_type) {
         case coding_CRI_ADX:
             for (ch = 0; ch < vgmstream->channels; ch++) {
@@ -2138,8 +2698,8 @@ int vgmstream_samples_to_do(int samples_this_block, int samples_per_frame, VGMST
 
     }
 
-    /* if it's a framed encoding don't do more than one frame */
-    if (samples_per_frame > 1 && (vgmstream->samples_into_block % samples_per_frame) + samples_to_do > samples_per_frame)
+    /* if it's a framed encoding don't do more than one frame (frame decoders split them on their own) */
+    if (samples_per_frame > 1 && !vgmstream->frame_decode && (vgmstream->samples_into_block % samples_per_frame) + samples_to_do > samples_per_frame)
         samples_to_do = samples_per_frame - (vgmstream->samples_into_block % samples_per_frame);
 
     return samples_to_do;
@@ -28,6 +28,13 @@ enum { VGMSTREAM_MAX_SUBSONGS = 65535 };
 //#define VGM_USE_ATRAC9
 //#define VGM_USE_CELT
 
+/* external libs are set up to output 16-bit PCM */
+#if !defined(VGM_SAMPLE_INT16) && (defined(VGM_USE_VORBIS) || defined(VGM_USE_MPEG) || defined(VGM_USE_G7221) \
+        || defined(VGM_USE_G719) || defined(VGM_USE_MP4V2) || defined(VGM_USE_FDKAAC) || defined(VGM_USE_MAIATRAC3PLUS) \
+        || defined(VGM_USE_FFMPEG) || defined(VGM_USE_ATRAC9) || defined(VGM_USE_CELT))
+#error "external codec libs need the default (int16) sample format"
+#endif
+
 
 #ifdef VGM_USE_VORBIS
 #include <vorbis/vorbisfile.h>
@@ -809,7 +816,7 @@ typedef struct {
 } VGMSTREAMCHANNEL;
 
 /* main vgmstream info */
-typedef struct {
+typedef struct _VGMSTREAM {
     /* basic config */
     int32_t num_samples;            /* the actual max number of samples */
     int32_t sample_rate;            /* sample rate in Hz */
@@ -885,6 +892,8 @@ typedef struct {
     void* start_vgmstream;          /* shallow copy of the VGMSTREAM as it was at the beginning of the stream (for resets) */
 
     void * mixing_data;             /* state for mixing effects */
+    void * seek_index;              /* seek points recorded while rendering */
+    void * block_index;             /* block offsets and start samples found so far (blocked layouts) */
 
     /* Optional data the codec needs for the whole stream. This is for codecs too
      * different from vgmstream's structure to be reasonably shoehorned.
@@ -894,6 +903,10 @@ typedef struct {
     /* Same, for special layouts. layout_data + codec_data may exist at the same time. */
     void * layout_data;
 
+    /* decode functions resolved once from layout/coding types in setup_vgmstream (or NULL) */
+    void (*layout_render)(sample_t * buffer, int32_t sample_count, struct _VGMSTREAM * vgmstream);
+    void (*frame_decode)(struct _VGMSTREAM * vgmstream, VGMSTREAMCHANNEL * stream, sample_t * outbuf, int channelspacing, int32_t first_sample, int32_t samples_to_do, int channel);
+
 } VGMSTREAM;
 
 #ifdef VGM_USE_VORBIS
@@ -1131,14 +1144,22 @@ typedef struct {
     sample_t *buffer;
     int input_channels;     /* internal buffer channels */
     int output_channels;    /* resulting channels (after mixing, if applied) */
+
+    /* next segment reset and partly decoded ahead by a worker (see VGM_USE_THREADS) */
+    int prefetch_state;
+    int prefetch_segment;
+    sample_t *prefetch_buffer;
+    int32_t prefetch_samples;   /* decoded ahead */
+    int32_t prefetch_used;      /* already copied out */
+    void *prefetch_next;        /* worker queue */
 } segmented_layout_data;
 
 /* for files made of "parallel" layers, one per group of channels (using a complete sub-VGMSTREAM) */
 typedef struct {
     int layer_count;
     VGMSTREAM **layers;
-    sample_t *buffer;
-    int input_channels;     /* internal buffer channels */
+    sample_t *buffer;       /* one part per layer */
+    int input_channels;     /* internal buffer channels (all layers) */
     int output_channels;    /* resulting channels (after mixing, if applied) */
 } layered_layout_data;
 
@@ -1152,7 +1173,7 @@ typedef struct {
     STREAMFILE *streamfile;
     clHCA_stInfo info;
 
-    signed short *sample_buffer;
+    sample_t *sample_buffer;
     size_t samples_filled;
     size_t samples_consumed;
     size_t samples_to_discard;
@@ -1304,9 +1325,43 @@ VGMSTREAM * init_vgmstream(const char * const filename);
 /* init with custom IO via streamfile */
 VGMSTREAM * init_vgmstream_from_STREAMFILE(STREAMFILE *streamFile);
 
+/* stats of the last format detection (init_vgmstream) */
+typedef struct {
+    int candidates;         /* init functions left after the extension index */
+    int tried;              /* init functions called until one worked (or all failed) */
+    double time_ms;         /* total time, only measured when enabled */
+} vgmstream_probe_stats;
+
+/* enable measuring detection time (also logged per file in debug builds), off by default */
+void vgmstream_probe_stats_enable(int enable);
+
+/* get stats of the last detection (not synchronized if detecting from several threads) */
+void vgmstream_get_probe_stats(vgmstream_probe_stats * stats);
+
 /* reset a VGMSTREAM to start of stream */
 void reset_vgmstream(VGMSTREAM * vgmstream);
 
+/* Move a VGMSTREAM to a play position, as if seek_sample samples had been rendered after a reset
+ * (positions past loop end count loops). Common codecs/layouts jump close to the target and only
+ * decode a few frames to restore codec state, otherwise decodes and discards from the start.
+ * Jumps are exact except for filter ADPCM (PSX, DSP, XA), where history after the warm-up is very
+ * close but not bit-identical to a full decode. */
+void seek_vgmstream(VGMSTREAM * vgmstream, int32_t seek_sample);
+
+/* Streams that must decode to seek (blocked layouts, IMA, etc) learn seek points while playing.
+ * Export writes them to buf (returns the size, or just the needed size if buf is NULL, or 0 if
+ * there is nothing to save) so players may persist them, and import loads them back into a
+ * freshly opened stream (returns 0 if the data doesn't match this stream or build). */
+size_t vgmstream_seek_index_export(VGMSTREAM * vgmstream, uint8_t * buf, size_t buf_size);
+int vgmstream_seek_index_import(VGMSTREAM * vgmstream, const uint8_t * buf, size_t buf_size);
+
+/* Keys found by testing lists (HCA, FSB) are remembered per folder and tried first for other files
+ * there. Export/import work like the seek index but for all files (import before opening any, keeps
+ * keys found this session). Version changes whenever a key is learned, to know when to save again. */
+size_t vgmstream_key_cache_export(uint8_t * buf, size_t buf_size);
+int vgmstream_key_cache_import(const uint8_t * buf, size_t buf_size);
+uint32_t vgmstream_key_cache_version(void);
+
 /* close an open vgmstream */
 void close_vgmstream(VGMSTREAM * vgmstream);
 
@@ -1316,6 +1371,9 @@ int32_t get_vgmstream_play_samples(double looptimes, double fadeseconds, double
 /* Decode data into sample buffer */
 void render_vgmstream(sample_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
 
+/* Same, converted to 16-bit PCM for players (direct with the default int16 sample_t) */
+void render_vgmstream_s16(int16_t * buffer, int32_t sample_count, VGMSTREAM * vgmstream);
+
 /* Write a description of the stream into array pointed by desc, which must be length bytes long.
  * Will always be null-terminated if length > 0 */
 void describe_vgmstream(VGMSTREAM * vgmstream, char * desc, int length);
@@ -1351,6 +1409,11 @@ int get_vgmstream_frame_size(VGMSTREAM * vgmstream);
 /* In NDS IMA the frame size is the block size, so the last one is short */
 int get_vgmstream_samples_per_shortframe(VGMSTREAM * vgmstream);
 int get_vgmstream_shortframe_size(VGMSTREAM * vgmstream);
+/* Get the number of samples to decode before a seek point so codec state (ADPCM history) settles,
+ * for codecs that layouts may position at any frame by offset math. Returns -1 if the codec can't
+ * (like headerless IMA, whose step index never recovers), 0 if the jump is exact and >0 if the
+ * state is only approximated. */
+int get_vgmstream_seek_warmup(VGMSTREAM * vgmstream);
 
 /* Decode samples into the buffer. Assume that we have written samples_written into the
  * buffer already, and we have samples_to_do consecutive samples ahead of us. */
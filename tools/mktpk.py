@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""Builds a VGMPlayerNX theme pak (.tpk).
+
+Usage: mktpk.py [--format rgb24|rgba|rgb565] [--keep-bmp] output.tpk file...
+
+Pak layout (all little-endian, every compressed section is raw deflate):
+    u16 compressed length, u16 decompressed length of the name table
+    name table: null-terminated file names
+    per file, in name table order:
+        u32 compressed length, u32 decompressed length, data
+
+BMP and PNG inputs are converted to .tex images named after the input
+(e.g. background.png -> background.tex), which the player wraps in a
+surface without decoding. --keep-bmp stores BMPs unchanged instead.
+Other files (e.g. font.ttf) are stored as-is.
+"""
+
+import argparse
+import os
+import struct
+import sys
+import zlib
+
+# SDL_PIXELFORMAT_* values, see ThemeTexture.hpp.
+FORMATS = {
+    'rgb24':  (0x17101803, 3),
+    'rgba':   (0x16762004, 4),  # SDL_PIXELFORMAT_ABGR8888, R G B A in memory.
+    'rgb565': (0x15151002, 2),
+}
+
+
+def read_bmp(data):
+    """Returns (width, height, rows of RGBA tuples) for an uncompressed 24/32-bit BMP."""
+    if data[:2] != b'BM':
+        raise ValueError('not a BMP')
+    offset, = struct.unpack_from('<I', data, 10)
+    width, height, _, bits, compression = struct.unpack_from('<iiHHI', data, 18)
+    if bits not in (24, 32) or compression not in (0, 3):
+        raise ValueError('only uncompressed 24/32-bit BMPs are supported')
+    bpp = bits // 8
+    pitch = (width * bpp + 3) & ~3
+    rows = []
+    for y in range(abs(height)):
+        row = data[offset + y * pitch:offset + y * pitch + width * bpp]
+        pixels = []
+        for x in range(width):
+            b, g, r = row[x * bpp:x * bpp + 3]
+            a = row[x * bpp + 3] if bpp == 4 else 255
+            pixels.append((r, g, b, a))
+        rows.append(pixels)
+    if height > 0:
+        rows.reverse()  # Stored bottom-up.
+    return width, abs(height), rows
+
+
+def read_png(data):
+    """Returns (width, height, rows of RGBA tuples) for a non-interlaced 8-bit PNG."""
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('not a PNG')
+    pos = 8
+    idat = b''
+    palette = []
+    transparency = b''
+    while pos < len(data):
+        length, kind = struct.unpack_from('>I4s', data, pos)
+        chunk = data[pos + 8:pos + 8 + length]
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', chunk)
+        elif kind == b'PLTE':
+            palette = [tuple(chunk[i:i + 3]) for i in range(0, len(chunk), 3)]
+        elif kind == b'tRNS':
+            transparency = chunk
+        elif kind == b'IDAT':
+            idat += chunk
+        pos += 12 + length
+    if depth != 8 or interlace:
+        raise ValueError('only non-interlaced 8-bit PNGs are supported')
+    channels = {0: 1, 2: 3, 3: 1, 4: 2, 6: 4}[colour]
+    stride = width * channels
+    raw = zlib.decompress(idat)
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        filter_type = raw[y * (stride + 1)]
+        line = bytearray(raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)])
+        for i in range(stride):
+            left = line[i - channels] if i >= channels else 0
+            up = prev[i]
+            up_left = prev[i - channels] if i >= channels else 0
+            if filter_type == 1:
+                line[i] = (line[i] + left) & 0xFF
+            elif filter_type == 2:
+                line[i] = (line[i] + up) & 0xFF
+            elif filter_type == 3:
+                line[i] = (line[i] + ((left + up) >> 1)) & 0xFF
+            elif filter_type == 4:
+                p = left + up - up_left
+                pa, pb, pc = abs(p - left), abs(p - up), abs(p - up_left)
+                pred = left if pa <= pb and pa <= pc else up if pb <= pc else up_left
+                line[i] = (line[i] + pred) & 0xFF
+        prev = line
+        pixels = []
+        for x in range(width):
+            px = line[x * channels:(x + 1) * channels]
+            if colour == 0:
+                pixels.append((px[0], px[0], px[0], 255))
+            elif colour == 2:
+                pixels.append((px[0], px[1], px[2], 255))
+            elif colour == 3:
+                a = transparency[px[0]] if px[0] < len(transparency) else 255
+                pixels.append(palette[px[0]] + (a,))
+            elif colour == 4:
+                pixels.append((px[0], px[0], px[0], px[1]))
+            else:
+                pixels.append(tuple(px))
+        rows.append(pixels)
+    return width, height, rows
+
+
+def make_tex(width, height, rows, fmt):
+    """Encodes pixels as a .tex image (ThemeTextureHeader followed by pixel rows)."""
+    sdl_format, bpp = FORMATS[fmt]
+    out = bytearray(struct.pack('<4sHHII', b'VTEX', width, height, sdl_format, width * bpp))
+    for row in rows:
+        for r, g, b, a in row:
+            if fmt == 'rgb24':
+                out += bytes((r, g, b))
+            elif fmt == 'rgba':
+                out += bytes((r, g, b, a))
+            else:
+                out += struct.pack('<H', ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3))
+    return bytes(out)
+
+
+def deflate(data):
+    compressor = zlib.compressobj(9, zlib.DEFLATED, -15)
+    return compressor.compress(data) + compressor.flush()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Build a VGMPlayerNX theme pak.')
+    parser.add_argument('--format', choices=sorted(FORMATS), default='rgb24',
+                        help='pixel format of converted images (default: rgb24)')
+    parser.add_argument('--keep-bmp', action='store_true',
+                        help='store BMP inputs unchanged instead of converting them')
+    parser.add_argument('output')
+    parser.add_argument('inputs', nargs='+')
+    args = parser.parse_args()
+
+    files = []
+    for path in args.inputs:
+        with open(path, 'rb') as f:
+            data = f.read()
+        name = os.path.basename(path)
+        stem, ext = os.path.splitext(name)
+        ext = ext.lower()
+        if ext == '.png' or (ext == '.bmp' and not args.keep_bmp):
+            width, height, rows = (read_png if ext == '.png' else read_bmp)(data)
+            data = make_tex(width, height, rows, args.format)
+            name = stem + '.tex'
+        files.append((name, data))
+
+    names = b''.join(name.encode() + b'\0' for name, _ in files)
+    packed_names = deflate(names)
+    if len(names) > 0xFFFF or len(packed_names) > 0xFFFF:
+        sys.exit('too many files for the name table')
+
+    with open(args.output, 'wb') as out:
+        out.write(struct.pack('<HH', len(packed_names), len(names)))
+        out.write(packed_names)
+        for name, data in files:
+            packed = deflate(data)
+            out.write(struct.pack('<II', len(packed), len(data)))
+            out.write(packed)
+            print('%-16s %9d -> %9d bytes' % (name, len(data), len(packed)))
+
+
+if __name__ == '__main__':
+    main()